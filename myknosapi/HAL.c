@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/select.h>
 #define __USE_MISC
 #include <sys/time.h>
 
@@ -10,101 +17,680 @@
 
 
 static 	FILE *pLogFile = NULL;
-static struct timeval  _tv;
+
+/* Asynchronous log: callers claim a slot with an atomic increment of _logHead, the writer
+   thread consumes slots in order. A slot is ready to read when seq == index + 1 and free
+   to write when seq == index (bounded MPSC queue). */
+typedef struct
+{
+	unsigned long long seq;
+	halLogRecord_t rec;
+} halLogSlot_t;
+
+static halLogSlot_t       _logRing[HAL_LOG_RING_SIZE];
+static unsigned long long _logHead = 0;
+static unsigned long long _logTail = 0;
+static unsigned long long _logDropped = 0;
+static volatile int       _logAsync = 0;
+static volatile int       _logRun = 0;
+static int                _logResume = 0;	/* 1 = HAL_closeLogFile() stopped the asynchronous log, HAL_openLogFile() restarts it */
+static pthread_t          _logThread;
+
+/* SPI engine, timeout and log state of the device the calling thread works on, see HAL_setContext().
+   In the context, txCredits is the number of words that can still be pushed before the FIFO is
+   believed full; it is refilled only when TX_READY is seen. */
+static halContext_t _halDefaultContext = { .irqFd = -1 };
+static __thread halContext_t *_halCtx = &_halDefaultContext;
+
+#define HAL_logSink()	((_halCtx->logFile != NULL) ? _halCtx->logFile : pLogFile)
+
+#if defined(__arm__) || defined(__aarch64__)
+#define HAL_cpuRelax()	__asm__ __volatile__("yield" ::: "memory")
+#elif defined(__i386__) || defined(__x86_64__)
+#define HAL_cpuRelax()	__asm__ __volatile__("pause" ::: "memory")
+#else
+#define HAL_cpuRelax()	__asm__ __volatile__("" ::: "memory")
+#endif
+
+/* CLOCK_MONOTONIC time, not affected by changes of the wall clock */
+unsigned long long HAL_getTime_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Spin on SPI_STATUS until one of the bits in mask is set. Returns 0 on success. */
+static int HAL_spiWaitStatus(unsigned int mask)
+{
+	unsigned int status = 0;
+	unsigned int spins = 0;
+
+	for (;;)
+	{
+		fpga_read(_halCtx->spiBase + SPI_STATUS, &status);
+		_halCtx->spiStats.statusPolls++;
+		if (status & mask)
+		{
+			return 0;
+		}
+
+		_halCtx->spiStats.stalls++;
+		if (++spins >= HAL_SPI_SPIN_LIMIT)
+		{
+			_halCtx->spiStats.spinTimeouts++;
+			return 1;
+		}
+		HAL_cpuRelax();
+	}
+}
 
 
 /************************************************  SPI ***************************************************/
-int HAL_initSpi(int chipSelectIndex, unsigned char CPOL_CPHA, int spiClkFreq_Hz)
+/* Clears ctx: no SPI core offset, no device set up, no interrupt fd */
+void HAL_initContext(halContext_t *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->irqFd = -1;
+}
+
+/* Binds the calling thread to ctx, NULL = the shared default context */
+void HAL_setContext(halContext_t *ctx)
+{
+	_halCtx = (ctx != NULL) ? ctx : &_halDefaultContext;
+}
+
+halContext_t *HAL_getContext()
+{
+	return _halCtx;
+}
+
+/* SPI_TX_DATA word of a single register write */
+#define HAL_SPI_WORD(addr, data)	((((unsigned int)(addr) & 0xFFFF) << 8) | ((data) & 0xFF))
+
+/* The SPI calls of a context hold its bus while they run, threads sharing the context take
+   turns. Writes of HAL_spiWritePriority() do not wait for the turn of a long transfer: they
+   wait in the context's priority lane and the thread holding the bus sends them at the next
+   chunk boundary (HAL_spiPreempt()) or when it gives the bus up. */
+static void HAL_busBackoff(unsigned int *spins)
+{
+	if (++(*spins) < HAL_BUS_SPIN_LIMIT)
+	{
+		HAL_cpuRelax();
+	}
+	else
+	{
+		/* the holder may be waiting for this CPU */
+		sched_yield();
+	}
+}
+
+static void HAL_busAcquire()
+{
+	unsigned int spins = 0;
+
+	while (__atomic_exchange_n(&_halCtx->busBusy, 1, __ATOMIC_ACQUIRE))
+	{
+		HAL_busBackoff(&spins);
+	}
+}
+
+static int HAL_busTryAcquire()
+{
+	return (__atomic_exchange_n(&_halCtx->busBusy, 1, __ATOMIC_ACQUIRE) == 0);
+}
+
+static int HAL_spiFlush();
+static int HAL_spiSelect(int chipSelectIndex);
+static int HAL_spiReserve();
+static int HAL_spiPushBatch(const fpgaRegAccess_t *ops, unsigned int n);
+
+static int HAL_spiPrioPending()
 {
+	halSpiPrioSlot_t *slot = &_halCtx->prio[_halCtx->prioTail & (HAL_SPI_PRIO_DEPTH - 1)];
+
+	return (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == ((_halCtx->prioTail & ~(HAL_SPI_PRIO_DEPTH - 1)) + 1));
+}
+
+/* Sends the writes waiting in the priority lane, at most one lap of it. Called with the bus
+   held and no read in flight; the interrupted transfer gets its chip select back. */
+static void HAL_spiPreempt()
+{
+	fpgaRegAccess_t op;
+	volatile int *status[HAL_SPI_PRIO_DEPTH];
+	unsigned long long queued_ns[HAL_SPI_PRIO_DEPTH];
+	unsigned long long latency_ns = 0;
+	unsigned int channel = _halCtx->spiChannel;
+	unsigned int lap = 0;
+	unsigned int n = 0;
+	unsigned int i = 0;
+	int failed = 0;
+	halSpiPrioSlot_t *slot = NULL;
+
+	if (!HAL_spiPrioPending())
+	{
+		return;
+	}
+
+	if (channel == 0)
+	{
+		fpga_read(_halCtx->spiBase + SPI_CHIP_SELECT, &channel);
+		_halCtx->spiChannel = channel;
+	}
+
+	for (n = 0; (n < HAL_SPI_PRIO_DEPTH) && HAL_spiPrioPending(); n++)
+	{
+		lap = _halCtx->prioTail & ~(HAL_SPI_PRIO_DEPTH - 1);
+		slot = &_halCtx->prio[_halCtx->prioTail & (HAL_SPI_PRIO_DEPTH - 1)];
+
+		op.offset = _halCtx->spiBase + SPI_TX_DATA;
+		op.value = slot->word;
+		failed |= HAL_spiSelect(slot->chipSelect) || HAL_spiReserve() || HAL_spiPushBatch(&op, 1);
+		status[n] = slot->status;
+		queued_ns[n] = slot->queued_ns;
+
+		/* hand the slot back to the producers one lap later */
+		__atomic_store_n(&slot->seq, lap + HAL_SPI_PRIO_DEPTH, __ATOMIC_RELEASE);
+		_halCtx->prioTail++;
+	}
+
+	/* a write is done once it has left the FIFO */
+	failed |= HAL_spiFlush() || HAL_spiSelect(channel);
+
+	for (i = 0; i < n; i++)
+	{
+		latency_ns = HAL_getTime_ns() - queued_ns[i];
+		_halCtx->spiStats.prioWrites++;
+		_halCtx->spiStats.prioLatency_ns += latency_ns;
+		if (latency_ns > _halCtx->spiStats.prioMaxLatency_ns)
+		{
+			_halCtx->spiStats.prioMaxLatency_ns = latency_ns;
+		}
+		__atomic_store_n(status[i], failed ? 2 : 1, __ATOMIC_RELEASE);
+	}
+}
+
+/* Writes still in the priority lane go out before the bus is handed on */
+static void HAL_busRelease()
+{
+	HAL_spiPreempt();
+	__atomic_store_n(&_halCtx->busBusy, 0, __ATOMIC_RELEASE);
+}
+
+/* Sends one register write (a 24-bit SPI_TX_DATA word, see HAL_SPI_WORD) to chipSelectIndex
+   ahead of the SPI calls other threads are making on this context. When a transfer holds the
+   bus the write goes out at its next chunk boundary: after at most one TX FIFO batch
+   (HAL_SPI_TX_FIFO_DEPTH words), HAL_SPI_RX_FIFO_DEPTH reads in flight, or the rest of a
+   streamed transaction, which is never split. Returns once the word has left the FIFO,
+   prioMaxLatency_ns of the SPI stats is the worst time that took. The device must have been
+   set up by HAL_initSpi(); must not be called while the calling thread holds the bus. */
+int HAL_spiWritePriority(int chipSelectIndex, unsigned int word)
+{
+	halSpiPrioSlot_t *slot = NULL;
+	volatile int status = 0;
+	unsigned long long queued_ns = HAL_getTime_ns();
+	unsigned int spins = 0;
+	unsigned int pos = 0;
+
+	if ((chipSelectIndex == 0) || ((__atomic_load_n(&_halCtx->spiConfigured, __ATOMIC_RELAXED) & chipSelectIndex) != (unsigned int)chipSelectIndex))
+	{
+		return 1;
+	}
+
+	for (;;)
+	{
+		pos = __atomic_load_n(&_halCtx->prioHead, __ATOMIC_RELAXED);
+		slot = &_halCtx->prio[pos & (HAL_SPI_PRIO_DEPTH - 1)];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == (pos & ~(HAL_SPI_PRIO_DEPTH - 1)))
+		{
+			if (__atomic_compare_exchange_n(&_halCtx->prioHead, &pos, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+			continue;
+		}
+
+		/* lane full, empty it ourselves if the bus is free */
+		if (HAL_busTryAcquire())
+		{
+			HAL_busRelease();
+		}
+		else
+		{
+			HAL_busBackoff(&spins);
+		}
+	}
+
+	slot->chipSelect = chipSelectIndex;
+	slot->word = word;
+	slot->queued_ns = queued_ns;
+	slot->status = &status;
+	__atomic_store_n(&slot->seq, (pos & ~(HAL_SPI_PRIO_DEPTH - 1)) + 1, __ATOMIC_RELEASE);
+
+	/* the holder of the bus sends it, or nobody holds it and we do */
+	while (__atomic_load_n(&status, __ATOMIC_ACQUIRE) == 0)
+	{
+		if (HAL_busTryAcquire())
+		{
+			HAL_busRelease();
+		}
+		else
+		{
+			HAL_busBackoff(&spins);
+		}
+	}
+
+	return (status == 1) ? 0 : 1;
+}
+
+/* Sets up the SPI mode of the devices on chipSelectIndex. A device already set up in this
+   context is skipped, see HAL_forgetSpi(). A device whose setup failed is not marked set up,
+   the next call sends it again. */
+static int HAL_spiSetup(int chipSelectIndex)
+{
+	fpgaRegAccess_t ops[8];
+	unsigned int tx = _halCtx->spiBase + SPI_TX_DATA;
+	unsigned int cs = _halCtx->spiBase + SPI_CHIP_SELECT;
+	unsigned int reg_54_state = 0;
+	unsigned int n = 0;
+	int failed = 0;
+
 	if ((chipSelectIndex == 0) || (chipSelectIndex > 3))
 	{
 		return 1;
 	}
 
-	unsigned int reg_54_state;
-	fpga_read(SPI_CHIP_SELECT, &reg_54_state);
-	char buf[3];
-	if (chipSelectIndex & SPI_CLOCKS)
+	chipSelectIndex &= ~_halCtx->spiConfigured;
+	if (chipSelectIndex == 0)
 	{
-		fpga_write(SPI_CHIP_SELECT, 2);
+		return 0;
+	}
 
-		//fpga_write(0x44, 0x99);		// Assert Soft Reset, Set 4wire SPI Mode
-		spi_write(0, 0x99);
-		
-		//fpga_write(0x44, 0xF01);	// Commit Write
-		spi_write(0x44, 1);
-		
-		//fpga_write(0x44, 0x18);		// Deassert soft Reset, Set 4wire SPI Mode
-		spi_write(0x00, 0x18);
+	/* words still queued for the current chip select must go out before it changes, and so
+	   must the words of each device below before the next chip select */
+	if (HAL_spiFlush() || (fpga_read(cs, &reg_54_state) != FPGA_OK))
+	{
+		return 1;
+	}
 
-		//fpga_write(0x44, 0xF01);	// Commit Write
-		spi_write(0x0F, 0x1);
+	if (chipSelectIndex & SPI_CLOCKS)
+	{
+		n = 0;
+		ops[n].offset = cs; ops[n++].value = 2;
+		ops[n].offset = tx; ops[n++].value = HAL_SPI_WORD(0x00, 0x99);	// Assert Soft Reset, Set 4wire SPI Mode
+		ops[n].offset = tx; ops[n++].value = HAL_SPI_WORD(0x44, 0x01);	// Commit Write
+		ops[n].offset = tx; ops[n++].value = HAL_SPI_WORD(0x00, 0x18);	// Deassert soft Reset, Set 4wire SPI Mode
+		ops[n].offset = tx; ops[n++].value = HAL_SPI_WORD(0x0F, 0x01);	// Commit Write
+		failed |= (fpga_writev(ops, n) != FPGA_OK);
+		_halCtx->txCredits -= n - 1;
+		_halCtx->spiStats.words += n - 1;
+		failed |= HAL_spiFlush();
+		if (!failed)
+		{
+			_halCtx->spiConfigured |= SPI_CLOCKS;
+		}
 	}
 
-	if (chipSelectIndex & SPI_TRAMSIVER)
+	if ((chipSelectIndex & SPI_TRAMSIVER) && !failed)
 	{
-		fpga_write(SPI_CHIP_SELECT, 1);
+		n = 0;
+		ops[n].offset = cs; ops[n++].value = 1;
+		ops[n].offset = tx; ops[n++].value = HAL_SPI_WORD(0x00, 0x18);	// Set 4wire SPI Mode
+		/* streaming or single instruction mode (0x001) is left to MYKONOS_setSpiSettings() */
+		failed |= (fpga_writev(ops, n) != FPGA_OK);
+		_halCtx->txCredits -= n - 1;
+		_halCtx->spiStats.words += n - 1;
+		failed |= HAL_spiFlush();
+		if (!failed)
+		{
+			_halCtx->spiConfigured |= SPI_TRAMSIVER;
+		}
+	}
 
-		//fpga_write(0x44, 0x18);		// Set 4wire SPI Mode
-		spi_write(0x00, 0x18);
+	/* back to the chip select of the caller, also after a failure */
+	failed |= (fpga_write(cs, reg_54_state) != FPGA_OK);
 
-		//fpga_write(0x44, 0x180);	// Set Single Instruction Mode
-		spi_write(0x01, 0x80);
+	return failed ? 1 : 0;
+}
+
+/* The FPGA SPI core runs in the clock mode and at the clock rate of the bitstream, CPOL_CPHA
+   and spiClkFreq_Hz are accepted for the API and not used */
+int HAL_initSpi(int chipSelectIndex, unsigned char CPOL_CPHA, int spiClkFreq_Hz)
+{
+	int retval = 0;
+
+	(void)CPOL_CPHA;
+	(void)spiClkFreq_Hz;
 
+	HAL_busAcquire();
+	retval = HAL_spiSetup(chipSelectIndex);
+	HAL_busRelease();
+	return retval;
+}
 
+/* The devices on chipSelectIndex lost their SPI mode (e.g. reset), the next HAL_initSpi()
+   for them sends the setup again */
+void HAL_forgetSpi(int chipSelectIndex)
+{
+	_halCtx->spiConfigured &= ~chipSelectIndex;
+}
+
+/* Points the SPI core at chipSelectIndex. Words still queued go out to the previous device first. */
+static int HAL_spiSelect(int chipSelectIndex)
+{
+	if (_halCtx->spiChannel == (unsigned int)chipSelectIndex)
+	{
+		return 0;
 	}
 
-	fpga_write(SPI_CHIP_SELECT, reg_54_state);
+	if (HAL_spiFlush() || (fpga_write(_halCtx->spiBase + SPI_CHIP_SELECT, chipSelectIndex) != FPGA_OK))
+	{
+		return 1;
+	}
 
+	_halCtx->spiChannel = chipSelectIndex;
 	return 0;
 }
 
+int HAL_setSpiChannel(int chipSelectIndex)
+{
+	int retval = 0;
+
+	HAL_busAcquire();
+	retval = HAL_spiSelect(chipSelectIndex);
+	HAL_busRelease();
+	return retval;
+}
+
 void HAL_closeSpi()
-{}
+{
+	HAL_spiDrain();
+}
 
-int HAL_spiWrite(char *txbuf, int len)
+int HAL_spiDrain()
 {
-	if ((len % 3) != 0)
+	int retval = 0;
+
+	HAL_busAcquire();
+	retval = HAL_spiFlush();
+	HAL_busRelease();
+	return retval;
+}
+
+/* Waits until everything queued in the TX FIFO has been shifted out */
+static int HAL_spiFlush()
+{
+	if (_halCtx->txCredits == HAL_SPI_TX_FIFO_DEPTH)
 	{
-		HAL_writeToLogFile("Error SPI data len [%d]\n", len);
+		return 0;
+	}
+
+	if (HAL_spiWaitStatus(TX_READY))
+	{
+		HAL_writeToLogFile("Error SPI TX FIFO did not drain\n");
 		return 1;
 	}
+	_halCtx->txCredits = HAL_SPI_TX_FIFO_DEPTH;
+	return 0;
+}
 
-	unsigned int status = 0;
-	while (len)
+/* Makes room in the TX FIFO, only looking at the FIFO status once the words pushed since
+   TX_READY was last seen may have filled it */
+static int HAL_spiReserve()
+{
+	if (_halCtx->txCredits == 0)
 	{
-		while (!(status & (1 << 6)))
+		if (HAL_spiWaitStatus(TX_READY))
 		{
-			fpga_read(0x48, &status);
-			usleep(10);
+			HAL_writeToLogFile("Error SPI TX FIFO stuck full\n");
+			return 1;
 		}
-		char data[4] = { 0 };
-		data[2] = *txbuf++;
-		data[1] = *txbuf++;
-		data[0] = *txbuf++;
-		
-		fpga_write(0x44, *((unsigned int *)data));
+		_halCtx->txCredits = HAL_SPI_TX_FIFO_DEPTH;
+	}
+
+	return 0;
+}
 
-		len-=3;
+/* Writes the n words of ops to the TX FIFO in one pass, HAL_spiReserve() made room for them */
+static int HAL_spiPushBatch(const fpgaRegAccess_t *ops, unsigned int n)
+{
+	if (fpga_writev(ops, n) != FPGA_OK)
+	{
+		return 1;
 	}
+
+	_halCtx->txCredits -= n;
+	_halCtx->spiStats.words += n;
 	return 0;
 }
 
+static unsigned int HAL_spiWord(unsigned char *p)
+{
+	return ((unsigned int)p[0] << 16) | ((unsigned int)p[1] << 8) | p[2];
+}
+
+/* Pushes len/3 words into the TX FIFO. With stream set, every word but the last carries
+   SPI_TX_CONTINUE so the whole buffer goes out as a single chip select transaction. */
+static int HAL_spiPushWords(unsigned char *p, int len, int stream)
+{
+	fpgaRegAccess_t ops[HAL_SPI_TX_FIFO_DEPTH];
+	unsigned long long t0 = HAL_getTime_ns();
+	unsigned int flags = stream ? SPI_TX_CONTINUE : 0;
+	unsigned int n = 0;
+	int retval = 0;
+
+	_halCtx->spiStats.bytes += len;
+	while (len)
+	{
+		/* a streamed transaction keeps its chip select to the end */
+		if (!stream)
+		{
+			HAL_spiPreempt();
+		}
+
+		if (HAL_spiReserve())
+		{
+			retval = 1;
+			break;
+		}
+
+		/* as many words as the FIFO takes go out in one batch */
+		for (n = 0; (n < _halCtx->txCredits) && len; n++)
+		{
+			if (len == 3)
+			{
+				flags = 0;
+			}
+
+			ops[n].offset = _halCtx->spiBase + SPI_TX_DATA;
+			ops[n].value = flags | HAL_spiWord(p);
+			p += 3;
+			len -= 3;
+		}
+
+		if (HAL_spiPushBatch(ops, n))
+		{
+			retval = 1;
+			break;
+		}
+	}
+
+	_halCtx->spiStats.txTime_ns += HAL_getTime_ns() - t0;
+	return retval;
+}
+
+int HAL_spiWrite(char *txbuf, int len)
+{
+	int retval = 0;
+
+	if ((len % 3) != 0)
+	{
+		HAL_writeToLogFile("Error SPI data len [%d]\n", len);
+		return 1;
+	}
+
+	HAL_busAcquire();
+	retval = HAL_spiPushWords((unsigned char *)txbuf, len, 0);
+	HAL_busRelease();
+	return retval;
+}
+
+/* 1 when the SPI core can keep chip select asserted across words, see FPGA_SPI_TX_CONTINUE */
+int HAL_spiCanStream()
+{
+	return fpga_hasTxContinue();
+}
+
+/* Sends one streamed transaction: 2 byte instruction header followed by len-2 data bytes */
+int HAL_spiWriteStream(char *txbuf, int len)
+{
+	int retval = 0;
+
+	if ((len % 3) != 0)
+	{
+		HAL_writeToLogFile("Error SPI stream len [%d]\n", len);
+		return 1;
+	}
+
+	if (!HAL_spiCanStream())
+	{
+		HAL_writeToLogFile("Error SPI core can not stream\n");
+		return 1;
+	}
+
+	HAL_busAcquire();
+	retval = HAL_spiPushWords((unsigned char *)txbuf, len, 1);
+	HAL_busRelease();
+	return retval;
+}
+
+static int HAL_spiTransferWords(unsigned char *txbuf, int len, const unsigned char *readFlags, unsigned char *rxdata);
+
 int HAL_spiRead(char *txbuf, int len, char *data)
 {
-	unsigned int status = 0;
+	static const unsigned char isRead = 1;
+
 	txbuf[0] |= 0x80;
-	HAL_spiWrite(txbuf, 3);
-	while (!(status & (1 << 7)))
+	return HAL_spiTransfer(txbuf, 3, &isRead, data);
+}
+
+/* Sends len/3 words; every word whose readFlags[] entry is set returns one byte from
+   SPI_RX_DATA, stored in order into rxdata. The caller says which words are reads because
+   the level of the read bit depends on the device's write bit polarity. Reads are queued back to back,
+   keeping at most HAL_SPI_RX_FIFO_DEPTH of them in flight, and the RX FIFO is drained as
+   it fills. Priority writes go out whenever no read is in flight; while they wait no more
+   words are queued. */
+int HAL_spiTransfer(char *txbuf, int len, const unsigned char *readFlags, char *rxdata)
+{
+	int retval = 0;
+
+	if ((len % 3) != 0)
 	{
-		fpga_read(0x48, &status);
-		usleep(10);
+		HAL_writeToLogFile("Error SPI data len [%d]\n", len);
+		return 1;
 	}
-	fpga_read(0x40, (unsigned int *)data);
+
+	HAL_busAcquire();
+	retval = HAL_spiTransferWords((unsigned char *)txbuf, len, readFlags, (unsigned char *)rxdata);
+	HAL_busRelease();
+	return retval;
+}
+
+static int HAL_spiTransferWords(unsigned char *txbuf, int len, const unsigned char *readFlags, unsigned char *rxdata)
+{
+	fpgaRegAccess_t ops[HAL_SPI_TX_FIFO_DEPTH];
+	unsigned long long t0 = HAL_getTime_ns();
+	unsigned char *p = txbuf;
+	unsigned char *end = p + len;
+	unsigned int pending = 0;
+	unsigned int reads = 0;
+	unsigned int afterRead = 0;
+	unsigned int word = 0;
+	unsigned int n = 0;
+	int retval = 0;
+
+	_halCtx->spiStats.bytes += len;
+	while ((p < end) || pending)
+	{
+		if (HAL_spiPrioPending() && (pending == 0))
+		{
+			HAL_spiPreempt();
+			continue;
+		}
+
+		if ((p < end) && !HAL_spiPrioPending() && (!*readFlags || (pending < HAL_SPI_RX_FIFO_DEPTH)))
+		{
+			if (HAL_spiReserve())
+			{
+				retval = 1;
+				break;
+			}
+
+			/* queue words up to the FIFO room, stopping at a read the RX FIFO has no room for */
+			for (n = 0; (p < end) && (n < _halCtx->txCredits) && (!*readFlags || (pending < HAL_SPI_RX_FIFO_DEPTH)); n++)
+			{
+				ops[n].offset = _halCtx->spiBase + SPI_TX_DATA;
+				ops[n].value = HAL_spiWord(p);
+				if (*readFlags)
+				{
+					afterRead = 0;
+					pending++;
+				}
+				else
+				{
+					afterRead++;
+				}
+				p += 3;
+				readFlags++;
+			}
+
+			if (HAL_spiPushBatch(ops, n))
+			{
+				retval = 1;
+				break;
+			}
+			continue;
+		}
+
+		if (HAL_spiWaitStatus(RX_READY))
+		{
+			HAL_writeToLogFile("Error SPI RX data timeout\n");
+			retval = 1;
+			break;
+		}
+		fpga_read(_halCtx->spiBase + SPI_RX_DATA, &word);
+		*rxdata++ = (unsigned char)(word & 0xFF);
+		_halCtx->spiStats.reads++;
+		reads++;
+		pending--;
+	}
+
+	/* every read word came back, so everything queued up to the last read has left the FIFO;
+	   the words pushed after it may still be there */
+	if ((retval == 0) && (reads > 0))
+	{
+		if ((afterRead < HAL_SPI_TX_FIFO_DEPTH) && (_halCtx->txCredits < (HAL_SPI_TX_FIFO_DEPTH - afterRead)))
+		{
+			_halCtx->txCredits = HAL_SPI_TX_FIFO_DEPTH - afterRead;
+		}
+	}
+
+	_halCtx->spiStats.txTime_ns += HAL_getTime_ns() - t0;
+	return retval;
+}
+
+void HAL_getSpiStats(halSpiStats_t *stats)
+{
+	*stats = _halCtx->spiStats;
+}
+
+void HAL_resetSpiStats()
+{
+	memset(&_halCtx->spiStats, 0, sizeof(_halCtx->spiStats));
 }
 
 /************************************************ Log ***************************************************/
-void HAL_openLogFile(char *filename)
+void HAL_openLogFile(const char *filename)
 {
 	if (pLogFile != NULL)
 	{
@@ -121,22 +707,37 @@ void HAL_openLogFile(char *filename)
 	time_t ltime; /* calendar time */
 	ltime = time(NULL); /* get current cal time */
 	HAL_writeToLogFile("Starting at %s", asctime(localtime(&ltime)));
+
+	/* a reopened log keeps the mode it was closed in */
+	if (_logResume)
+	{
+		HAL_setLogAsync(1);
+	}
 }
 
 void HAL_closeLogFile()
 {
+	/* records still queued belong in this file */
+	int wasAsync = _logAsync;
+
+	HAL_setLogAsync(0);
+	_logResume = wasAsync;
+
 	if (pLogFile != NULL)
 	{
 		time_t ltime; /* calendar time */
 		ltime = time(NULL); /* get current cal time */
 		HAL_writeToLogFile("Closing logfile %s", asctime(localtime(&ltime)));
 		fclose(pLogFile);
+		pLogFile = NULL;
 	}
 }
 
 void HAL_writeToLogFile(char *format,...)
 {
-	if (pLogFile == NULL)
+	FILE *sink = HAL_logSink();
+
+	if (sink == NULL)
 	{
 		return;
 	}
@@ -146,7 +747,7 @@ void HAL_writeToLogFile(char *format,...)
 	vsprintf(buf, format, argptr);
 	va_end(argptr);
 
-	fwrite(buf, strlen(buf),1,pLogFile);
+	fwrite(buf, strlen(buf),1,sink);
 }
 
 void HAL_flushLogFile()
@@ -156,85 +757,350 @@ void HAL_flushLogFile()
 		return;
 	}
 
+	/* let the writer thread catch up with what is queued so far */
+	while (_logAsync && (__atomic_load_n(&_logTail, __ATOMIC_ACQUIRE) != __atomic_load_n(&_logHead, __ATOMIC_ACQUIRE)))
+	{
+		usleep(HAL_LOG_DRAIN_PERIOD_US);
+	}
+
 	fflush(pLogFile);
 }
 
-/************************************************  Timer ***************************************************/
-void HAL_setTimeout_ms(int timeOut_ms)
+/* Formats a record the way the synchronous log always has, returns the text length */
+static int HAL_formatLogRecord(halLogRecord_t *rec, char *buf, int size)
 {
-	struct timeval t, tt;
-	gettimeofday(&tt, NULL);
-	timerclear(&t);
-	if (timeOut_ms >= 1000)
+	switch (rec->type)
 	{
-		t.tv_sec = timeOut_ms / 1000;
-		timeOut_ms -= (t.tv_sec * 1000000);
+	case HAL_LOGREC_SPI_WRITE:
+		return snprintf(buf, size, "SPIWrite: CS:%2d, ADDR:0x%03X, DATA:0x%02X \n", rec->chipSelect, rec->addr, rec->data);
+	case HAL_LOGREC_SPI_READ:
+		return snprintf(buf, size, "SPIRead: CS:%2d, ADDR:0x%03X, ReadData:0x%02X\n", rec->chipSelect, rec->addr, rec->data);
+	case HAL_LOGREC_SPI_STREAM:
+		return snprintf(buf, size, "SPIWriteStream: CS:%2d, ADDR:0x%03X, COUNT:%d \n", rec->chipSelect, rec->addr, rec->count);
+	case HAL_LOGREC_SPI_WRITE_FIELD:
+		return snprintf(buf, size, "SPIWriteField: CS:%2d, ADDR:0x%03X, FIELDVAL:0x%02X, MASK:0x%02X, STARTBIT:%d \n", rec->chipSelect, rec->addr, rec->data, rec->mask, rec->startBit);
+	case HAL_LOGREC_SPI_READ_FIELD:
+		return snprintf(buf, size, "SPIReadField: CS:%2d, ADDR:0x%03X, MASK:0x%02X, STARTBIT:%d, FieldVal:0x%02X\n", rec->chipSelect, rec->addr, rec->mask, rec->startBit, rec->data);
+	default:
+		/* level uses the ADI_LOGLEVEL values: 0x2 = warning, 0x4 = error */
+		return snprintf(buf, size, "%s: %d: %s", (rec->level == 0x4) ? "ERROR" : ((rec->level == 0x2) ? "WARNING" : "MESSAGE"),
+			(int)rec->errorCode, (rec->comment != NULL) ? rec->comment : "");
 	}
-	t.tv_usec = (timeOut_ms * 1000);
-	timeradd(&tt, &t, &_tv);
 }
 
-void HAL_setTimeout_us(int timeOut_us)
+/* Writes every ready record to the log file, returns the number written */
+static int HAL_drainLog()
+{
+	halLogSlot_t *slot = NULL;
+	FILE *sink = NULL;
+	char buf[320];
+	int len = 0;
+	int n = 0;
+
+	for (;;)
+	{
+		slot = &_logRing[_logTail & (HAL_LOG_RING_SIZE - 1)];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (_logTail + 1))
+		{
+			break;
+		}
+
+		len = snprintf(buf, sizeof(buf), "[%llu.%09llu] ", slot->rec.timestamp_ns / 1000000000ULL, slot->rec.timestamp_ns % 1000000000ULL);
+		len += HAL_formatLogRecord(&slot->rec, buf + len, sizeof(buf) - len);
+		if (len > (int)sizeof(buf) - 1)
+		{
+			len = sizeof(buf) - 1;
+		}
+		sink = slot->rec.sink;
+
+		/* hand the slot back to the producers one lap later, a producer may overwrite it
+		   from here on */
+		__atomic_store_n(&slot->seq, _logTail + HAL_LOG_RING_SIZE, __ATOMIC_RELEASE);
+		__atomic_store_n(&_logTail, _logTail + 1, __ATOMIC_RELEASE);
+
+		if (sink != NULL)
+		{
+			fwrite(buf, len, 1, sink);
+		}
+		n++;
+	}
+
+	return n;
+}
+
+static void *HAL_logThread(void *arg)
+{
+	(void)arg;
+
+	while (_logRun)
+	{
+		if (HAL_drainLog() == 0)
+		{
+			usleep(HAL_LOG_DRAIN_PERIOD_US);
+		}
+	}
+
+	return NULL;
+}
+
+/* Turns the asynchronous log on (records are formatted and written by a background thread,
+   each line prefixed with its monotonic timestamp) or off (the queue is drained first, call
+   it while no other thread is logging). HAL_writeToLogFile text still goes straight to the
+   file, ahead of records queued before it. HAL_closeLogFile() stops it, the next
+   HAL_openLogFile() starts it again. Returns 0 on success. */
+int HAL_setLogAsync(int enable)
+{
+	unsigned int i;
+
+	_logResume = 0;
+	if (enable && !_logAsync)
+	{
+		for (i = 0; i < HAL_LOG_RING_SIZE; i++)
+		{
+			_logRing[i].seq = i;
+		}
+		_logHead = 0;
+		_logTail = 0;
+		_logRun = 1;
+		if (pthread_create(&_logThread, NULL, HAL_logThread, NULL) != 0)
+		{
+			_logRun = 0;
+			return 1;
+		}
+		_logAsync = 1;
+	}
+	else if (!enable && _logAsync)
+	{
+		/* new records go to the file directly from here on, then flush what is queued */
+		_logAsync = 0;
+		_logRun = 0;
+		pthread_join(_logThread, NULL);
+		HAL_drainLog();
+	}
+
+	return 0;
+}
+
+/* Logs one record. With the asynchronous log on this only copies it into the ring and
+   never blocks: when the ring is full the record is dropped and counted. */
+void HAL_writeLogRecord(halLogRecord_t *rec)
 {
-	struct timeval t, tt;
-	gettimeofday(&tt, NULL);
-	timerclear(&t);
-	if (timeOut_us >= 1000000)
+	halLogSlot_t *slot = NULL;
+	unsigned long long pos;
+	long long diff;
+	char buf[256];
+
+	rec->sink = HAL_logSink();
+	if (rec->sink == NULL)
+	{
+		return;
+	}
+
+	if (!_logAsync)
 	{
-		t.tv_sec = timeOut_us / 1000000;
-		timeOut_us -= (t.tv_sec * 1000000);
+		HAL_formatLogRecord(rec, buf, sizeof(buf));
+		fwrite(buf, strlen(buf), 1, rec->sink);
+		return;
 	}
-	t.tv_usec = timeOut_us;
-	
-	timeradd(&tt, &t, &_tv);
+
+	rec->timestamp_ns = HAL_getTime_ns();
+	pos = __atomic_load_n(&_logHead, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		slot = &_logRing[pos & (HAL_LOG_RING_SIZE - 1)];
+		diff = (long long)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&_logHead, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			__atomic_fetch_add(&_logDropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else
+		{
+			pos = __atomic_load_n(&_logHead, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->rec = *rec;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+unsigned long long HAL_getLogDropped()
+{
+	return __atomic_load_n(&_logDropped, __ATOMIC_RELAXED);
+}
+
+/************************************************  Timer ***************************************************/
+void HAL_setTimeout_ms(int timeOut_ms)
+{
+	_halCtx->deadline_ns = HAL_getTime_ns() + (unsigned long long)timeOut_ms * 1000000ULL;
+}
+
+void HAL_setTimeout_us(int timeOut_us)
+{
+	_halCtx->deadline_ns = HAL_getTime_ns() + (unsigned long long)timeOut_us * 1000ULL;
 }
 
 unsigned char HAL_hasTimeoutExpired()
 {
-	struct timeval  t_now;
+	return (HAL_getTime_ns() < _halCtx->deadline_ns) ? 1 : 0;
+}
 
-	gettimeofday(&t_now, NULL);
+/* Waits until the monotonic clock reaches deadline_ns. The thread sleeps up to
+   HAL_WAIT_SPIN_US before the deadline, then spins, so the wait ends within a few us
+   of the deadline instead of one scheduler wakeup after it. */
+void HAL_waitUntil_ns(unsigned long long deadline_ns)
+{
+	struct timespec ts;
+	unsigned long long wake_ns = 0;
 
-	if (t_now.tv_sec > _tv.tv_sec)
+	if (deadline_ns > HAL_getTime_ns() + HAL_WAIT_SPIN_US * 1000ULL)
 	{
-		return 0;
+		wake_ns = deadline_ns - HAL_WAIT_SPIN_US * 1000ULL;
+		ts.tv_sec = wake_ns / 1000000000ULL;
+		ts.tv_nsec = wake_ns % 1000000000ULL;
+
+		/* absolute wakeup, restarting after a signal does not add up the time already slept */
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		{
+		}
 	}
 
-	if (t_now.tv_sec < _tv.tv_sec)
+	while (HAL_getTime_ns() < deadline_ns)
 	{
-		return 1;
+		HAL_cpuRelax();
 	}
+}
 
-	if (t_now.tv_usec < _tv.tv_usec)
+void HAL_wait_us(unsigned int time_us)
+{
+	HAL_waitUntil_ns(HAL_getTime_ns() + (unsigned long long)time_us * 1000ULL);
+}
+
+/************************************************  Interrupt ***************************************************/
+/* UIO: writing 1 unmasks the interrupt, it masks itself again each time it fires */
+static int HAL_enableIrq()
+{
+	unsigned int enable = 1;
+
+	return (write(_halCtx->irqFd, &enable, sizeof(enable)) == sizeof(enable)) ? 0 : 1;
+}
+
+/* Opens the UIO device the GP interrupt pin of the calling thread's device is wired to */
+int HAL_openIrq(const char *uioDevice)
+{
+	int fd = open(uioDevice, O_RDWR);
+
+	if (fd < 0)
 	{
 		return 1;
 	}
 
-	return 0;
+	HAL_closeIrq();
+	_halCtx->irqFd = fd;
+	return HAL_enableIrq();
 }
 
-/************************************************ FPGA ***************************************************/
-int fpgaAxiReadWrite(char *uiod, int map_size, int len, int offset, int read_0_writre_1, int data)
+/* Uses an already open fd with UIO semantics (e.g. an emulated interrupt), -1 = none */
+void HAL_setIrqFd(int fd)
+{
+	_halCtx->irqFd = fd;
+	if (fd >= 0)
+	{
+		HAL_enableIrq();
+	}
+}
+
+void HAL_closeIrq()
 {
-	HAL_writeToLogFile("Access to FPGA Axi to offset %d", offset);
-	return 1;
-	
-	switch (read_0_writre_1)
+	if (_halCtx->irqFd >= 0)
 	{
-	case 0:
-		fpga_read(offset, &data);
-		break;
+		close(_halCtx->irqFd);
+	}
+	_halCtx->irqFd = -1;
+}
 
-	case 1:
-		fpga_write(offset, &data);
-		break;
+/* Waits up to time_us or until the interrupt of the calling thread's device fires.
+   Returns 1 when it fired, 0 when the time ran out (a plain HAL_wait_us() without an
+   interrupt source), -1 when the interrupt fd failed. */
+int HAL_waitIrq_us(unsigned int time_us)
+{
+	unsigned long long deadline_ns = HAL_getTime_ns() + (unsigned long long)time_us * 1000ULL;
+	unsigned long long now_ns = 0;
+	unsigned int count = 0;
+	struct timeval tv;
+	fd_set fds;
+	int ret = 0;
 
-	default:
-		return 1;
-		break;
+	if (_halCtx->irqFd < 0)
+	{
+		HAL_waitUntil_ns(deadline_ns);
+		return 0;
+	}
+
+	for (;;)
+	{
+		now_ns = HAL_getTime_ns();
+		if (now_ns >= deadline_ns)
+		{
+			return 0;
+		}
+
+		/* select() for its us resolution, poll() only has ms */
+		tv.tv_sec = (deadline_ns - now_ns) / 1000000000ULL;
+		tv.tv_usec = ((deadline_ns - now_ns) % 1000000000ULL) / 1000;
+		FD_ZERO(&fds);
+		FD_SET(_halCtx->irqFd, &fds);
+
+		ret = select(_halCtx->irqFd + 1, &fds, NULL, NULL, &tv);
+		if (ret > 0)
+		{
+			/* a read returns the number of interrupts so far */
+			if ((read(_halCtx->irqFd, &count, sizeof(count)) != sizeof(count)) || HAL_enableIrq())
+			{
+				return -1;
+			}
+			return 1;
+		}
+
+		if ((ret < 0) && (errno != EINTR))
+		{
+			return -1;
+		}
 	}
-  return 0;
 }
 
+/************************************************ FPGA ***************************************************/
+/* AXI register window (FPGA_AXI_REG_DEV), offset relative to the calling thread's device */
+int HAL_regRead(unsigned int offset, unsigned int *data)
+{
+	return (fpga_axiRegRead(_halCtx->regBase + offset, data) == FPGA_OK) ? 0 : 1;
+}
+
+int HAL_regWrite(unsigned int offset, unsigned int data)
+{
+	return (fpga_axiRegWrite(_halCtx->regBase + offset, data) == FPGA_OK) ? 0 : 1;
+}
+
+/* FPGA DDR window (FPGA_AXI_MEM_DEV), len 32-bit words, copied in bulk */
+int HAL_memRead(unsigned int offset, unsigned int *data, unsigned int len)
+{
+	return (fpga_axiMemRead(offset, data, len) == FPGA_OK) ? 0 : 1;
+}
 
+int HAL_memWrite(unsigned int offset, const unsigned int *data, unsigned int len)
+{
+	return (fpga_axiMemWrite(offset, data, len) == FPGA_OK) ? 0 : 1;
+}
 
+/* direct pointer to len 32-bit words of the DDR window, NULL if they are not accessible */
+void *HAL_memPtr(unsigned int offset, unsigned int len)
+{
+	return fpga_axiMemPtr(offset, len);
+}
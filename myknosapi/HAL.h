@@ -7,19 +7,162 @@
 
 #ifndef HAL_H_
 #define HAL_H_
+#include <stdio.h>
 #include "spi.h"
 
+/* Number of 24-bit words the FPGA SPI TX FIFO holds once TX_READY reports it drained.
+   Setting it to 1 reproduces the original one-word-per-handshake behaviour. */
+#ifndef HAL_SPI_TX_FIFO_DEPTH
+#define HAL_SPI_TX_FIFO_DEPTH	16
+#endif
+
+/* Number of read results the FPGA SPI RX FIFO can hold, bounds the reads kept in flight */
+#ifndef HAL_SPI_RX_FIFO_DEPTH
+#define HAL_SPI_RX_FIFO_DEPTH	16
+#endif
+
+/* Last part of a HAL_wait_us() that is spun instead of slept, covers the scheduler wakeup latency */
+#ifndef HAL_WAIT_SPIN_US
+#define HAL_WAIT_SPIN_US		100
+#endif
+
+/* Priority writes that can wait for the bus of one context, power of 2, see HAL_spiWritePriority() */
+#ifndef HAL_SPI_PRIO_DEPTH
+#define HAL_SPI_PRIO_DEPTH		16
+#endif
+
+/* Polls of a busy bus before the waiting thread starts yielding its CPU */
+#ifndef HAL_BUS_SPIN_LIMIT
+#define HAL_BUS_SPIN_LIMIT		1000
+#endif
+
+/* Max status polls before a TX/RX handshake is declared stuck */
+#ifndef HAL_SPI_SPIN_LIMIT
+#define HAL_SPI_SPIN_LIMIT		1000000
+#endif
+
+typedef struct
+{
+	unsigned long long words;			/* 24-bit words pushed to SPI_TX_DATA */
+	unsigned long long bytes;			/* instruction + data bytes sent */
+	unsigned long long reads;			/* bytes read back from SPI_RX_DATA */
+	unsigned long long statusPolls;		/* reads of SPI_STATUS */
+	unsigned long long stalls;			/* polls that found the FIFO still busy */
+	unsigned long long spinTimeouts;	/* handshakes that exceeded HAL_SPI_SPIN_LIMIT */
+	unsigned long long txTime_ns;		/* time spent sending and reading back words */
+	unsigned long long prioWrites;		/* HAL_spiWritePriority() words sent */
+	unsigned long long prioLatency_ns;	/* their total time from the call until the word left the FIFO */
+	unsigned long long prioMaxLatency_ns;	/* worst of those */
+} halSpiStats_t;
+
+/* One write waiting in the priority lane. seq is the lap of the slot (index & ~(HAL_SPI_PRIO_DEPTH - 1))
+   while it is free and lap + 1 while it holds a write, so a zeroed context starts with all slots free. */
+typedef struct
+{
+	unsigned int seq;
+	unsigned int chipSelect;
+	unsigned int word;					/* SPI_TX_DATA value */
+	unsigned long long queued_ns;
+	volatile int *status;				/* set to 1 once sent, 2 on failure */
+} halSpiPrioSlot_t;
+
+/* Per device HAL state. Every thread starts on a shared default context, HAL_setContext()
+   switches the calling thread to another one so devices on separate SPI cores can be driven
+   from separate threads at the same time. Set a context up with HAL_initContext() before
+   filling in spiBase, logFile and regBase. */
+typedef struct halContext
+{
+	int spiBase;						/* offset of the device's FPGA SPI core, added to SPI_RX_DATA.. SPI_CHIP_SELECT */
+	FILE *logFile;						/* log sink for this device, NULL = the file of HAL_openLogFile() */
+	unsigned int txCredits;				/* SPI engine state */
+	halSpiStats_t spiStats;
+	unsigned long long deadline_ns;		/* HAL_setTimeout_ms/us, HAL_getTime_ns() time */
+	int irqFd;							/* UIO fd of the device's GP interrupt pin, -1 = none, see HAL_openIrq() */
+	unsigned int regBase;				/* offset of the device's registers in the AXI register window, added by HAL_regRead/Write */
+	unsigned int spiChannel;			/* SPI_CHIP_SELECT value last set by HAL_setSpiChannel(), 0 = not set yet */
+	unsigned int spiConfigured;			/* chip select bits (SPI_TRAMSIVER, SPI_CLOCKS) whose device HAL_initSpi() has set up */
+	int busBusy;						/* 1 while a thread is in an SPI call on this context */
+	unsigned int prioHead;				/* priority lane, filled by HAL_spiWritePriority() from any thread */
+	unsigned int prioTail;				/* and emptied by the thread holding the bus */
+	halSpiPrioSlot_t prio[HAL_SPI_PRIO_DEPTH];
+} halContext_t;
+
+/* Records held by the asynchronous log between the caller and the writer thread, power of 2.
+   When it is full new records are dropped and counted instead of blocking the caller. */
+#ifndef HAL_LOG_RING_SIZE
+#define HAL_LOG_RING_SIZE	8192
+#endif
+
+/* How long the log writer thread sleeps when it finds the ring empty */
+#ifndef HAL_LOG_DRAIN_PERIOD_US
+#define HAL_LOG_DRAIN_PERIOD_US	1000
+#endif
+
+typedef enum
+{
+	HAL_LOGREC_MESSAGE = 0,			/* level, errorCode, comment */
+	HAL_LOGREC_SPI_WRITE,			/* chipSelect, addr, data */
+	HAL_LOGREC_SPI_READ,			/* chipSelect, addr, data */
+	HAL_LOGREC_SPI_STREAM,			/* chipSelect, addr, count */
+	HAL_LOGREC_SPI_WRITE_FIELD,		/* chipSelect, addr, data, mask, startBit */
+	HAL_LOGREC_SPI_READ_FIELD		/* chipSelect, addr, data, mask, startBit */
+} halLogRecordType_t;
+
+/* One log entry. comment must point to a string that outlives the log (the API only
+   passes string literals), the record is formatted later on the writer thread. */
+typedef struct
+{
+	unsigned long long timestamp_ns;	/* CLOCK_MONOTONIC, filled in by HAL_writeLogRecord */
+	const char *comment;
+	unsigned int errorCode;
+	unsigned short addr;
+	unsigned short count;
+	unsigned char type;					/* halLogRecordType_t */
+	unsigned char level;				/* ADI_LOGLEVEL of HAL_LOGREC_MESSAGE records */
+	unsigned char chipSelect;
+	unsigned char data;
+	unsigned char mask;
+	unsigned char startBit;
+	FILE *sink;							/* filled in by HAL_writeLogRecord */
+} halLogRecord_t;
+
+void HAL_initContext(halContext_t *ctx);
+void HAL_setContext(halContext_t *ctx);
+halContext_t *HAL_getContext();
 void HAL_writeToLogFile(char *p,...);
+void HAL_writeLogRecord(halLogRecord_t *rec);
+int HAL_setLogAsync(int enable);
+unsigned long long HAL_getLogDropped();
 int HAL_initSpi(int chipSelectIndex, unsigned char CPOL_CPHA, int spiClkFreq_Hz);
 void HAL_closeSpi();
+void HAL_forgetSpi(int chipSelectIndex);
+int HAL_setSpiChannel(int chipSelectIndex);
 int HAL_spiWrite(char *txbuf, int len);
+int HAL_spiWriteStream(char *txbuf, int len);
+int HAL_spiCanStream();
 int HAL_spiRead(char *txbuf, int len, char *data);
-void HAL_openLogFile(char *filename);
+int HAL_spiTransfer(char *txbuf, int len, const unsigned char *readFlags, char *rxdata);
+int HAL_spiDrain();
+int HAL_spiWritePriority(int chipSelectIndex, unsigned int word);
+void HAL_getSpiStats(halSpiStats_t *stats);
+void HAL_resetSpiStats();
+void HAL_openLogFile(const char *filename);
 void HAL_closeLogFile();
 void HAL_flushLogFile();
+unsigned long long HAL_getTime_ns();
+void HAL_wait_us(unsigned int time_us);
+void HAL_waitUntil_ns(unsigned long long deadline_ns);
 void HAL_setTimeout_ms(int timeOut_ms);
 void HAL_setTimeout_us(int timeOut_us);
 unsigned char HAL_hasTimeoutExpired();
-int fpgaAxiReadWrite(char *uiod, int map_size, int len, int offset, int Zero_one, int data);
+int HAL_openIrq(const char *uioDevice);
+void HAL_setIrqFd(int fd);
+void HAL_closeIrq();
+int HAL_waitIrq_us(unsigned int time_us);
+int HAL_regRead(unsigned int offset, unsigned int *data);
+int HAL_regWrite(unsigned int offset, unsigned int data);
+int HAL_memRead(unsigned int offset, unsigned int *data, unsigned int len);
+int HAL_memWrite(unsigned int offset, const unsigned int *data, unsigned int len);
+void *HAL_memPtr(unsigned int offset, unsigned int len);
 
 #endif
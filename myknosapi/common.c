@@ -15,8 +15,10 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "common.h" 
 #include "fpga.h"
+#include "HAL.h"
 
 
 /*
@@ -26,14 +28,157 @@
 #include "logging.h"
 */
 
-static uint8_t _writeBitPolarity = 1;
-static uint8_t _longInstructionWord = 0;
-static uint8_t _chipSelectIndex = 0;
+/* SPI state of the calling thread, a thread works on one device (or a few in turn) at a time */
+static __thread uint8_t _writeBitPolarity = 1;
+static __thread uint8_t _longInstructionWord = 0;
+static __thread uint8_t _chipSelectIndex = 0;
+static __thread spiSettings_t *_pendingBatch = NULL; /* device whose spiBatch holds unsent writes */
+static __thread struct halContext *_halContext = NULL; /* HAL context bound to this thread, NULL = default */
+static __thread uint8_t _spiPriority = 0;     /* 1 = CMB_SPIWriteByte uses the priority lane, see CMB_setSPIPriority */
+static spiSettings_t *_scriptSettings = NULL; /* device being recorded */
+static cmbSpiScript_t *_script = NULL;        /* script being recorded, NULL when not recording */
+static uint32_t _scriptMute = 0;              /* >0 while internal accesses must not be recorded */
+
+static cmbStats_t _cmbStats;                  /* call counters, see CMB_getStats */
+
+#define CMB_STAT_ADD(var, val)  __atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+#define CMB_STAT_LOAD(var)      __atomic_load_n(&(var), __ATOMIC_RELAXED)
+
+#if (CMB_ENABLE_DEVSTATS == 1)
+static __thread cmbDevStats_t *_statsDevice = NULL;  /* statistics of the device this thread accesses, charged for waits */
+static __thread const char *_statsCaller = NULL;     /* entry message of the MYKONOS_* function this thread entered last */
+static __thread cmbDevStats_t *_statsCallerDev = NULL; /* device _statsCallerIndex belongs to, NULL = not looked up yet */
+static __thread int32_t _statsCallerIndex = -1;     /* caller[] being charged, -1 = none */
+
+static uint64_t CMB_statsNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+/* caller[] of dev the function this thread entered last is charged to, added on its first
+   access to the device, -1 when dev has no free slot */
+static int32_t CMB_statsCaller(cmbDevStats_t *dev)
+{
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    if (dev == _statsCallerDev)
+    {
+        return(_statsCallerIndex);
+    }
+
+    _statsCallerDev = dev;
+    _statsCallerIndex = -1;
+    if (_statsCaller == NULL)
+    {
+        return(-1);
+    }
+
+    /* the messages are string literals, the pointer identifies the function */
+    count = __atomic_load_n(&dev->numCallers, __ATOMIC_ACQUIRE);
+    for (i = 0; i < count; i++)
+    {
+        if (dev->caller[i].name == _statsCaller)
+        {
+            break;
+        }
+    }
+
+    if (i == count)
+    {
+        if (count >= CMB_DEVSTATS_MAX_CALLERS)
+        {
+            return(-1);
+        }
+        dev->caller[i].name = _statsCaller;
+        __atomic_store_n(&dev->numCallers, count + 1, __ATOMIC_RELEASE);
+    }
+
+    CMB_STAT_ADD(dev->caller[i].entries, 1);
+    _statsCallerIndex = (int32_t)i;
+
+    return(_statsCallerIndex);
+}
+
+/* accounts one completed call of type op that started at t0, dev NULL = statistics not kept */
+static void CMB_statsAdd(cmbDevStats_t *dev, cmbStatOp_t op, uint32_t items, uint32_t writes, uint32_t reads, uint64_t t0)
+{
+    cmbOpStats_t *stat = NULL;
+    cmbCallerStats_t *caller = NULL;
+    uint64_t dt = 0;
+    uint64_t us = 0;
+    uint32_t bin = 0;
+    int32_t callerIndex = -1;
+
+    if (dev == NULL)
+    {
+        return;
+    }
+
+    stat = &dev->op[op];
+    dt = CMB_statsNow() - t0;
+    us = dt / 1000;
+
+    while ((us > 0) && (bin < (CMB_DEVSTATS_HIST_BINS - 1)))
+    {
+        us >>= 1;
+        bin++;
+    }
+
+    CMB_STAT_ADD(stat->calls, 1);
+    CMB_STAT_ADD(stat->items, items);
+    CMB_STAT_ADD(stat->time_ns, dt);
+    CMB_STAT_ADD(stat->hist[bin], 1);
+    if (dt > CMB_STAT_LOAD(stat->maxTime_ns))
+    {
+        __atomic_store_n(&stat->maxTime_ns, dt, __ATOMIC_RELAXED);
+    }
+
+    /* a field write is charged through the read and write it makes */
+    if (op != CMB_STATOP_WRITEFIELD)
+    {
+        callerIndex = CMB_statsCaller(dev);
+    }
+
+    if (callerIndex >= 0)
+    {
+        caller = &dev->caller[callerIndex];
+        CMB_STAT_ADD(caller->spiWrites, writes);
+        CMB_STAT_ADD(caller->spiReads, reads);
+        CMB_STAT_ADD(caller->time_ns, dt);
+    }
+}
+
+/* called with the "MYKONOS_xxx()" entry message every API function logs, the calls this
+   thread makes from now on are charged to it */
+static void CMB_statsEnterCall(const char *name)
+{
+    _statsCaller = name;
+    _statsCallerDev = NULL;
+    _statsCallerIndex = -1;
+}
+
+#define CMB_STATS_START(t0)                                         (t0) = CMB_statsNow()
+#define CMB_STATS_END(dev, op, items, writes, reads, t0)            CMB_statsAdd((dev), (op), (items), (writes), (reads), (t0))
+#else
+#define CMB_STATS_START(t0)                                         (void)(t0)
+#define CMB_STATS_END(dev, op, items, writes, reads, t0)
+#endif
+
+static commonErr_t CMB_SPIWriteArray(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count);
+static commonErr_t CMB_SPIWritePriority(spiSettings_t *spiSettings, uint16_t addr, uint8_t data);
+
+#define CMB_SPISCRIPT_MAGIC   0x534B594D /* "MYKS" */
+#define CMB_SPISCRIPT_VERSION 1
 
 ADI_LOGLEVEL CMB_LOGLEVEL = ADIHAL_LOG_ALL;
 
 commonErr_t CMB_closeHardware(void)
 {
+    CMB_SPIBatchFlush();
     HAL_closeSpi();
     HAL_closeLogFile();
 
@@ -46,9 +191,9 @@ commonErr_t CMB_setGPIO(uint32_t GPIO)
 }
 
 /* 
-	spiChipSelectIndex = 0x01 - reset transiver
-						 0x02 - reset clocks
-						 0x03 - both
+	spiChipSelectIndex = 0x01 - reset transiver  (FPGA reg 0x10 bit 0)
+						 0x02 - reset clocks     (FPGA reg 0x10 bit 1)
+						 0x03 - FPGA reg 0x10 bit 2
 */
 
 commonErr_t CMB_hardReset(uint8_t spiChipSelectIndex)
@@ -59,29 +204,28 @@ commonErr_t CMB_hardReset(uint8_t spiChipSelectIndex)
 
     if ((spiChipSelectIndex >= 1) && (spiChipSelectIndex <= 3))
     {
-        switch(spiChipSelectIndex)
-        {
-            case 1:
-                devResetBit = ~1;
-                break;
-            case 2:
-                devResetBit = ~2;
-                break;
-
-            default:
-                devResetBit = ~3;
-                break;
-        }
+        /* one reset line per chip select, the other bits of the register are left alone */
+        devResetBit = (uint32_t)1 << (spiChipSelectIndex - 1);
 
         HAL_writeToLogFile("ResetDut at index %d", spiChipSelectIndex);
 
-        /* toggle FPGA reg bit that goes out to FMC reset pin. FPGA reg
-         * is active high, but signal to pins is active low.
+        /* queued writes belong before the reset */
+        CMB_SPIBatchFlush();
+
+        /* pulse the FPGA reg bit that goes out to the FMC reset pin. FPGA reg
+         * is active high (1 = in reset), but signal to pins is active low.
          */
         error = CMB_regRead(0x10, &readData);
-        error |= CMB_regWrite(0x10, (readData | devResetBit));
-        error |= CMB_wait_ms(1);
-        error |= CMB_regWrite(0x10, (readData & ~devResetBit));
+        if (!error)
+        {
+            error |= CMB_regWrite(0x10, (readData | devResetBit));
+            error |= CMB_wait_ms(1);
+            error |= CMB_regWrite(0x10, (readData & ~devResetBit));
+        }
+
+        /* the reset device is back in its default SPI mode, the next access sets it up again */
+        HAL_forgetSpi(spiChipSelectIndex);
+        _chipSelectIndex = 0;
 
         if(error)
         {
@@ -103,7 +247,7 @@ commonErr_t CMB_setSPIOptions(spiSettings_t *spiSettings)
 
     error = HAL_initSpi((spiSettings->chipSelectIndex), (uint8_t)((spiSettings->CPOL <<1) | (spiSettings->CPHA)), (spiSettings->spiClkFreq_Hz));
 
-    if(error < 0)
+    if(error != 0)
     {
         return(COMMONERR_FAILED);
     }
@@ -113,16 +257,280 @@ commonErr_t CMB_setSPIOptions(spiSettings_t *spiSettings)
 
 commonErr_t CMB_setSPIChannel(uint16_t chipSelectIndex )
 {
-    /* 0 = all chip selects de-asserted */
+    /* 0 = all chip selects de-asserted. The device was set up by CMB_setSPIOptions once,
+       switching back to it only changes the chip select */
+    if (HAL_setSpiChannel(chipSelectIndex))
+    {
+        return(COMMONERR_FAILED);
+    }
     _chipSelectIndex = (uint8_t)chipSelectIndex;
 
     return(COMMONERR_OK);
 }
 
+/* Drives the HAL context (SPI core, FPGA registers, timeout, interrupt, log) of this device from
+   the calling thread. Switching to another context means its chip select has to be set up again. */
+void CMB_bindContext(spiSettings_t *spiSettings)
+{
+    if (_halContext != spiSettings->halContext)
+    {
+        HAL_setContext(spiSettings->halContext);
+        _halContext = spiSettings->halContext;
+        _chipSelectIndex = 0;
+    }
+
+#if (CMB_ENABLE_DEVSTATS == 1)
+    _statsDevice = spiSettings->devStats;
+#endif
+}
+
+/* logs one SPI access, see HAL_writeLogRecord */
+static void CMB_logSpi(halLogRecordType_t type, uint8_t chipSelectIndex, uint16_t addr, uint8_t data, uint8_t mask, uint8_t startBit, uint16_t count)
+{
+    halLogRecord_t rec;
+
+    rec.comment = NULL;
+    rec.errorCode = 0;
+    rec.type = (uint8_t)type;
+    rec.level = ADIHAL_LOG_SPI;
+    rec.chipSelect = chipSelectIndex;
+    rec.addr = addr;
+    rec.data = data;
+    rec.mask = mask;
+    rec.startBit = startBit;
+    rec.count = count;
+    HAL_writeLogRecord(&rec);
+}
+
+/* write-through update of the register shadow after a write or a read of addr */
+static void CMB_regShadowUpdate(spiSettings_t *spiSettings, uint16_t addr, uint8_t data)
+{
+    cmbRegShadow_t *shadow = spiSettings->regShadow;
+
+    if ((shadow == NULL) || shadow->suspended || (addr >= CMB_REGSHADOW_SIZE))
+    {
+        return;
+    }
+
+    if (!(shadow->flags[addr] & CMB_REGSHADOW_VOLATILE))
+    {
+        shadow->value[addr] = data;
+        shadow->flags[addr] |= CMB_REGSHADOW_VALID;
+    }
+}
+
+/* reserves len bytes for a new record of type op, returns NULL when not recording it */
+static uint8_t *CMB_SPIScriptAppend(spiSettings_t *spiSettings, uint8_t op, uint32_t len)
+{
+    uint8_t *rec = NULL;
+
+    if ((_script == NULL) || _scriptMute || (spiSettings != _scriptSettings) || _script->overflow)
+    {
+        return(NULL);
+    }
+
+    if ((_script->len + len) > _script->size)
+    {
+        _script->overflow = 1;
+        return(NULL);
+    }
+
+    rec = &_script->buf[_script->len];
+    rec[0] = op;
+    _script->lastRecord = _script->len;
+    _script->len += len;
+
+    return(rec);
+}
+
+static void CMB_SPIScriptAddWrite(spiSettings_t *spiSettings, uint16_t addr, uint8_t data)
+{
+    uint8_t *rec = NULL;
+    uint16_t count = 0;
+
+    if ((_script == NULL) || _scriptMute || (spiSettings != _scriptSettings) || _script->overflow)
+    {
+        return;
+    }
+
+    /* extend the last record while it is a write block at the end of the script */
+    rec = &_script->buf[_script->lastRecord];
+    if ((_script->len > 0) && (rec[0] == CMB_SPISCRIPT_WRITES))
+    {
+        count = (uint16_t)(rec[1] | (rec[2] << 8));
+        if ((count < 0xFFFF) && ((_script->len + 3) <= _script->size))
+        {
+            _script->buf[_script->len++] = (uint8_t)(addr & 0xFF);
+            _script->buf[_script->len++] = (uint8_t)(addr >> 8);
+            _script->buf[_script->len++] = data;
+            count++;
+            rec[1] = (uint8_t)(count & 0xFF);
+            rec[2] = (uint8_t)(count >> 8);
+            return;
+        }
+    }
+
+    rec = CMB_SPIScriptAppend(spiSettings, CMB_SPISCRIPT_WRITES, 6);
+    if (rec != NULL)
+    {
+        rec[1] = 1;
+        rec[2] = 0;
+        rec[3] = (uint8_t)(addr & 0xFF);
+        rec[4] = (uint8_t)(addr >> 8);
+        rec[5] = data;
+    }
+}
+
+static void CMB_SPIScriptAddRead(spiSettings_t *spiSettings, uint16_t addr)
+{
+    uint8_t *rec = NULL;
+
+    if ((_script == NULL) || _scriptMute || (spiSettings != _scriptSettings) || _script->overflow)
+    {
+        return;
+    }
+
+    /* a poll loop reading the same register again only needs its last read */
+    rec = &_script->buf[_script->lastRecord];
+    if ((_script->len > 0) && (rec[0] == CMB_SPISCRIPT_READ) && (rec[1] == (addr & 0xFF)) && (rec[2] == (addr >> 8)))
+    {
+        rec[3] = 0;
+        rec[4] = 0;
+        return;
+    }
+
+    rec = CMB_SPIScriptAppend(spiSettings, CMB_SPISCRIPT_READ, 5);
+    if (rec != NULL)
+    {
+        rec[1] = (uint8_t)(addr & 0xFF);
+        rec[2] = (uint8_t)(addr >> 8);
+        rec[3] = 0; /* mask 0: plain read, no expected value */
+        rec[4] = 0;
+    }
+}
+
+static void CMB_SPIScriptAddWait(uint32_t time_ms)
+{
+    uint8_t *rec = NULL;
+
+    if (_script == NULL)
+    {
+        return;
+    }
+
+    rec = CMB_SPIScriptAppend(_scriptSettings, CMB_SPISCRIPT_WAIT, 5);
+    if (rec != NULL)
+    {
+        rec[1] = (uint8_t)(time_ms & 0xFF);
+        rec[2] = (uint8_t)((time_ms >> 8) & 0xFF);
+        rec[3] = (uint8_t)((time_ms >> 16) & 0xFF);
+        rec[4] = (uint8_t)((time_ms >> 24) & 0xFF);
+    }
+}
+
+commonErr_t CMB_SPIBatchBegin(spiSettings_t *spiSettings)
+{
+    if (spiSettings->spiBatch != NULL)
+    {
+        spiSettings->spiBatch->depth++;
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIBatchCommit(spiSettings_t *spiSettings)
+{
+    if (spiSettings->spiBatch == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    /* a batch opened inside another one goes out with the outer one */
+    if ((spiSettings->spiBatch->depth > 0) && (--spiSettings->spiBatch->depth > 0))
+    {
+        return(COMMONERR_OK);
+    }
+
+    if (_pendingBatch == spiSettings)
+    {
+        return(CMB_SPIBatchFlush());
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIBatchFlush(void)
+{
+    spiSettings_t *spiSettings = _pendingBatch;
+    cmbSpiBatch_t *batch = NULL;
+    uint32_t count = 0;
+
+    if (spiSettings == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    batch = spiSettings->spiBatch;
+    count = batch->count;
+    _pendingBatch = NULL;
+    batch->count = 0;
+    batch->flushes++;
+
+    /* the queued writes were recorded and counted when CMB_SPIWriteByte queued them */
+    return(CMB_SPIWriteArray(spiSettings, &batch->addr[0], &batch->data[0], count));
+}
+
 commonErr_t CMB_SPIWriteByte(spiSettings_t *spiSettings, uint16_t addr, uint8_t data)
 {
     int32_t retval = 0;
     unsigned char txbuf[] = {0x00,0x00,0x00};
+    cmbSpiBatch_t *batch = spiSettings->spiBatch;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    CMB_SPIScriptAddWrite(spiSettings, addr, data);
+    CMB_STAT_ADD(_cmbStats.spiWrites, 1);
+
+    if (_spiPriority)
+    {
+        retval = CMB_SPIWritePriority(spiSettings, addr, data);
+        CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEBYTE, 1, 1, 0, tStart);
+        return((commonErr_t)retval);
+    }
+
+    if ((batch != NULL) && (batch->depth > 0))
+    {
+        /* only one device can have writes queued, keep the bus order across devices */
+        if ((_pendingBatch != NULL) && (_pendingBatch != spiSettings))
+        {
+            if (CMB_SPIBatchFlush())
+            {
+                return(COMMONERR_FAILED);
+            }
+        }
+
+        batch->addr[batch->count] = addr;
+        batch->data[batch->count] = data;
+        batch->count++;
+        batch->writes++;
+        _pendingBatch = spiSettings;
+        CMB_regShadowUpdate(spiSettings, addr, data);
+
+        if (batch->count >= CMB_SPIBATCH_SIZE)
+        {
+            retval = CMB_SPIBatchFlush();
+        }
+
+        CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEBYTE, 1, 1, 0, tStart);
+        return((commonErr_t)retval);
+    }
+
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_bindContext(spiSettings);
 
     if (_chipSelectIndex != spiSettings->chipSelectIndex)
     {
@@ -139,28 +547,31 @@ commonErr_t CMB_SPIWriteByte(spiSettings_t *spiSettings, uint16_t addr, uint8_t
 
     if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
     {
-        HAL_writeToLogFile("SPIWrite: CS:%2d, ADDR:0x%03X, DATA:0x%02X \n", spiSettings->chipSelectIndex,addr, data);
+        CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, addr, data, 0, 0, 1);
     }
 
     if (spiSettings->longInstructionWord){
         txbuf[0] = ((_writeBitPolarity & 1) << 7) | ((addr >> 8) & 0x7F);
         txbuf[1] = addr & 0xFF;
         txbuf[2] = data;
-        retval = HAL_spiWrite(txbuf, 3);
+        retval = HAL_spiWrite((char *)txbuf, 3);
 
-        if (retval < 0)
+        if (retval != 0)
             goto error;
     }
     else
     {
         txbuf[0] = ((_writeBitPolarity & 1) << 7) | (addr  & 0x7F);
         txbuf[1] = data;
-        retval = HAL_spiWrite(txbuf, 2);
+        retval = HAL_spiWrite((char *)txbuf, 2);
 
-        if (retval < 0)
+        if (retval != 0)
             goto error;
     }
 
+    CMB_regShadowUpdate(spiSettings, addr, data);
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEBYTE, 1, 1, 0, tStart);
+
     return(COMMONERR_OK);
 
 error:
@@ -168,13 +579,120 @@ error:
     return(COMMONERR_FAILED);
 }
 
+/* Writes one register ahead of the transfers other threads run on the device's bus: a bulk
+   transfer in progress (e.g. an ARM memory load) lets it through at its next chunk boundary,
+   see HAL_spiWritePriority. The device needs the 16bit instruction word and must have been
+   accessed once the normal way so its SPI mode is set up. */
+static commonErr_t CMB_SPIWritePriority(spiSettings_t *spiSettings, uint16_t addr, uint8_t data)
+{
+    uint32_t word = 0;
+
+    /* this thread's queued writes were issued first */
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_bindContext(spiSettings);
+
+    if (!spiSettings->longInstructionWord)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    {
+        CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, addr, data, 0, 0, 1);
+    }
+
+    word = ((uint32_t)(((spiSettings->writeBitPolarity & 1) << 7) | ((addr >> 8) & 0x7F)) << 16) | ((uint32_t)(addr & 0xFF) << 8) | data;
+    if (HAL_spiWritePriority(spiSettings->chipSelectIndex, word))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_regShadowUpdate(spiSettings, addr, data);
+    return(COMMONERR_OK);
+}
+
+/* 1 = the CMB_SPIWriteByte calls of the calling thread, and so the MYKONOS functions it calls
+   that only write registers (MYKONOS_setTx1Attenuation, MYKONOS_setRx1ManualGain, ...), use the
+   priority lane of the device's bus. Reads and multi byte writes keep their place in line. */
+commonErr_t CMB_setSPIPriority(uint8_t enable)
+{
+    _spiPriority = (enable != 0);
+    return(COMMONERR_OK);
+}
+
 commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count)
 {
     uint32_t i = 0;
-    uint32_t txBufIndex = 0;
-    int32_t retval = 0;
-    unsigned char txbuf[SPIARRAYSIZE] = {0x00};
-    uint32_t spiArrayTripSize = SPIARRAYTRIPSIZE;
+    commonErr_t retval = COMMONERR_OK;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        CMB_SPIScriptAddWrite(spiSettings, addr[i], data[i]);
+    }
+    CMB_STAT_ADD(_cmbStats.spiWrites, count);
+
+    retval = CMB_SPIWriteArray(spiSettings, addr, data, count);
+    if (retval == COMMONERR_OK)
+    {
+        CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEBYTES, count, count, 0, tStart);
+    }
+
+    return(retval);
+}
+
+/* encodes a write the way CMB_SPIWriteArray sends it, 16bit instruction word only */
+commonErr_t CMB_SPIEncodeWrite(spiSettings_t *spiSettings, uint16_t addr, uint8_t data, uint8_t *word)
+{
+    if (!spiSettings->longInstructionWord)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    word[0] = ((spiSettings->writeBitPolarity & 1) << 7) | ((addr >> 8) & 0x7F);
+    word[1] = (addr & 0xFF);
+    word[2] = data;
+
+    return(COMMONERR_OK);
+}
+
+/* sends count writes encoded by CMB_SPIEncodeWrite in large HAL transfers, without touching them */
+commonErr_t CMB_SPIWriteEncoded(spiSettings_t *spiSettings, const uint8_t *words, uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t len = count * 3;
+    uint32_t chunk = 0;
+    uint16_t addr = 0;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    /* the words are only taken apart again while a script is recorded */
+    if (_script != NULL)
+    {
+        for (i = 0; i < len; i += 3)
+        {
+            addr = ((uint16_t)(words[i] & 0x7F) << 8) | words[i + 1];
+            CMB_SPIScriptAddWrite(spiSettings, addr, words[i + 2]);
+        }
+    }
+    CMB_STAT_ADD(_cmbStats.spiWrites, count);
+
+    CMB_bindContext(spiSettings);
 
     if (_chipSelectIndex != spiSettings->chipSelectIndex)
     {
@@ -189,33 +707,157 @@ commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_
         }
     }
 
-    if (spiSettings->longInstructionWord)
+    for (i = 0; i < len; i += chunk)
     {
-        if (spiSettings->enSpiStreaming)
-        {
+        chunk = ((len - i) < CMB_SPIENCODED_CHUNK) ? (len - i) : CMB_SPIENCODED_CHUNK;
 
+        /* one log record per chunk: first register and number of writes */
+        if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+        {
+            addr = ((uint16_t)(words[i] & 0x7F) << 8) | words[i + 1];
+            CMB_logSpi(HAL_LOGREC_SPI_STREAM, spiSettings->chipSelectIndex, addr, 0, 0, 0, (uint16_t)(chunk / 3));
         }
-        else
+
+        if (HAL_spiWrite((char *)&words[i], (int)chunk) != 0)
         {
-            txBufIndex = 0;
+            printf("Error writing SPI");
+            return(COMMONERR_FAILED);
+        }
+    }
 
-            for (i = 0; i < count; i++)
-            {
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEBYTES, count, count, 0, tStart);
+
+    return(COMMONERR_OK);
+}
+
+/* sends count register writes, packing them into as few HAL transfers as possible */
+static commonErr_t CMB_SPIWriteArray(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t txBufIndex = 0;
+    int32_t retval = 0;
+    unsigned char txbuf[SPIARRAYSIZE] = {0x00};
+    unsigned char streamBuf[SPIARRAYSIZE];
+    uint32_t spiArrayTripSize = SPIARRAYTRIPSIZE;
+    uint32_t runLength = 0;
+    int32_t addrStep = 1;
+
+    CMB_bindContext(spiSettings);
+
+    if (_chipSelectIndex != spiSettings->chipSelectIndex)
+    {
+        if(CMB_setSPIOptions(spiSettings))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        if(CMB_setSPIChannel(spiSettings->chipSelectIndex))
+        {
+            return(COMMONERR_FAILED);
+        }
+    }
+
+    if (spiSettings->longInstructionWord)
+    {
+        /* a SPI core without SPI_TX_CONTINUE gets the writes one by one, see fpga.h */
+        if (spiSettings->enSpiStreaming && HAL_spiCanStream())
+        {
+            /* in streaming mode the device moves to the next address after each data byte */
+            addrStep = (spiSettings->autoIncAddrUp > 0) ? 1 : -1;
+            txBufIndex = 0;
+            i = 0;
+
+            while (i < count)
+            {
+                runLength = 1;
+                while (((i + runLength) < count) && (runLength < (spiArrayTripSize - 2)) &&
+                       (addr[i + runLength] == (uint16_t)(addr[i + runLength - 1] + addrStep)))
+                {
+                    runLength++;
+                }
+
+                /* header + data must fill whole 3 byte FPGA words, so stream 3k+1 data bytes */
+                runLength -= ((runLength - 1) % 3);
+
+                if (runLength == 1)
+                {
+                    /* a single byte is an ordinary header + data triple, queue it with the others */
+                    txbuf[txBufIndex++] = ((_writeBitPolarity & 1) << 7) | ((addr[i] >> 8) & 0x7F);
+                    txbuf[txBufIndex++] = (addr[i] & 0xFF);
+                    txbuf[txBufIndex++] = data[i];
+
+                    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+                    {
+                        CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, addr[i], data[i], 0, 0, 1);
+                    }
+
+                    i++;
+
+                    if (txBufIndex < spiArrayTripSize)
+                    {
+                        continue;
+                    }
+                }
+
+                /* Send queued triples before starting a stream so the write order is kept */
+                if (txBufIndex > 0)
+                {
+                    retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                    if (retval != 0)
+                        goto error;
+
+                    txBufIndex = 0;
+                }
+
+                if (runLength > 1)
+                {
+                    streamBuf[0] = ((_writeBitPolarity & 1) << 7) | ((addr[i] >> 8) & 0x7F);
+                    streamBuf[1] = (addr[i] & 0xFF);
+                    memcpy(&streamBuf[2], &data[i], runLength);
+
+                    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+                    {
+                        CMB_logSpi(HAL_LOGREC_SPI_STREAM, spiSettings->chipSelectIndex, addr[i], 0, 0, 0, (uint16_t)runLength);
+                    }
+
+                    retval = HAL_spiWriteStream((char *)streamBuf, runLength + 2);
+                    if (retval != 0)
+                        goto error;
+
+                    i += runLength;
+                }
+            }
+
+            if (txBufIndex > 0)
+            {
+                retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                if (retval != 0)
+                    goto error;
+
+                txBufIndex = 0;
+            }
+        }
+        else
+        {
+            txBufIndex = 0;
+
+            for (i = 0; i < count; i++)
+            {
                 txbuf[txBufIndex++] = ((_writeBitPolarity & 1) << 7) | ((addr[i] >> 8) & 0x7F);
                 txbuf[txBufIndex++] = (addr[i] & 0xFF);
                 txbuf[txBufIndex++] = data[i];
 
                 if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
                 {
-                    HAL_writeToLogFile("SPIWrite: CS:%2d, ADDR:0x%03X, DATA:0x%02X \n", spiSettings->chipSelectIndex, addr[i], data[i]);
+                    CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, addr[i], data[i], 0, 0, 1);
                 }
 
                 /* Send full buffer when possible */
                 if (txBufIndex >= spiArrayTripSize)
                 {
                     /* Send full buffer when possible */
-                    retval = HAL_spiWrite(txbuf, txBufIndex);
-                    if (retval < 0)
+                    retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                    if (retval != 0)
                         goto error;
 
                     txBufIndex = 0;
@@ -225,8 +867,8 @@ commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_
             /* Send any data that was not sent as a full buffer before */
             if (txBufIndex > 0)
             {
-                retval = HAL_spiWrite(txbuf, txBufIndex);
-                if (retval < 0)
+                retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                if (retval != 0)
                     goto error;
 
                 txBufIndex = 0;
@@ -236,12 +878,7 @@ commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_
     }
     else
     {
-        /* 8bit instruction word */
-        if (spiSettings->enSpiStreaming)
-        {
-
-        }
-        else
+        /* 8bit instruction word, streaming is only supported with the 16bit instruction word */
         {
 
             txBufIndex = 0;
@@ -252,147 +889,750 @@ commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_
                 txbuf[txBufIndex++] = ((_writeBitPolarity & 1) << 7) | (addr[i]  & 0x7F);
                 txbuf[txBufIndex++] = data[i];
 
-                if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+                if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+                {
+                    CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, addr[i], data[i], 0, 0, 1);
+                }
+
+                if (txBufIndex >= spiArrayTripSize)
+                {
+                    /* Send full buffer when possible */
+                    retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                    if (retval != 0)
+                        goto error;
+
+                    txBufIndex = 0;
+                }
+            }
+
+            /* Send any data that was not sent as a full buffer before */
+            if (txBufIndex > 0)
+            {
+                retval = HAL_spiWrite((char *)txbuf, txBufIndex);
+                if (retval != 0)
+                    goto error;
+
+                txBufIndex = 0;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        CMB_regShadowUpdate(spiSettings, addr[i], data[i]);
+    }
+
+    return(COMMONERR_OK);
+
+error:
+    printf("Error writing SPI");
+    return(COMMONERR_FAILED);
+}
+
+commonErr_t CMB_SPIReadByte(spiSettings_t *spiSettings, uint16_t addr, uint8_t *readdata)
+{
+    uint8_t data=0;
+    int32_t retval = 0;
+    unsigned char txbuf[] = {0x00,0x00,0x00};
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+
+    /* the read must see every write queued before it */
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_bindContext(spiSettings);
+
+    if(_chipSelectIndex != spiSettings->chipSelectIndex)
+    {
+        if(CMB_setSPIOptions(spiSettings))
+        {
+            return(COMMONERR_FAILED);
+        }
+        if(CMB_setSPIChannel(spiSettings->chipSelectIndex))
+        {
+            return(COMMONERR_FAILED);
+        }
+    }
+    if(spiSettings->longInstructionWord)
+    {
+        txbuf[0] = ((~_writeBitPolarity & 1) << 7) | ((addr >> 8) & 0x7F);
+        txbuf[1] = addr & 0xFF;
+        retval = HAL_spiRead((char *)txbuf, 2, (char *)&data);
+        if (retval != 0)
+        {
+            return(COMMONERR_FAILED);
+        }
+        else
+        {
+            *readdata =(uint8_t)data;
+        }
+    }
+    else
+    {
+        txbuf[0] = ((~_writeBitPolarity & 1) << 7) | (addr & 0x7F);
+        retval = HAL_spiRead((char *)txbuf, 1, (char *)&data);
+        if (retval != 0)
+        {
+            printf("Error writing SPI");
+            return(COMMONERR_FAILED);
+        }
+        else
+        {
+            *readdata =(uint8_t)data;
+        }
+    }
+    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    {
+        CMB_logSpi(HAL_LOGREC_SPI_READ, spiSettings->chipSelectIndex, addr, *readdata, 0, 0, 1);
+    }
+
+    CMB_regShadowUpdate(spiSettings, addr, *readdata);
+    CMB_SPIScriptAddRead(spiSettings, addr);
+    CMB_STAT_ADD(_cmbStats.spiReads, 1);
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_READBYTE, 1, 0, 1, tStart);
+
+    return(COMMONERR_OK);
+}
+
+/* Sends an ordered list of register accesses. Entries with CMB_SPI_READ set in addr[] (or
+ * all entries when forceRead is set) are reads and return their value in data[], the others
+ * write data[]. The accesses are queued back to back and the read results collected as the
+ * FPGA RX FIFO fills, instead of waiting for each read before sending the next access.
+ */
+static commonErr_t CMB_SPITransfer(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count, uint8_t forceRead)
+{
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t start = 0;
+    uint32_t txBufIndex = 0;
+    uint32_t rxIndex = 0;
+    uint16_t regAddr = 0;
+    uint8_t isRead = 0;
+    int32_t retval = 0;
+    unsigned char txbuf[SPIARRAYSIZE] = {0x00};
+    unsigned char rxbuf[SPIARRAYSIZE / 3] = {0x00};
+    unsigned char readFlags[SPIARRAYSIZE / 3] = {0x00};
+    uint32_t reads = 0;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_bindContext(spiSettings);
+
+    if (_chipSelectIndex != spiSettings->chipSelectIndex)
+    {
+        if(CMB_setSPIOptions(spiSettings))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        if(CMB_setSPIChannel(spiSettings->chipSelectIndex))
+        {
+            return(COMMONERR_FAILED);
+        }
+    }
+
+    if (!spiSettings->longInstructionWord)
+    {
+        /* 8bit instruction word has no pipelined path, fall back to single accesses */
+        for (i = 0; i < count; i++)
+        {
+            regAddr = addr[i] & ~CMB_SPI_READ;
+            if (forceRead || (addr[i] & CMB_SPI_READ))
+            {
+                retval = CMB_SPIReadByte(spiSettings, regAddr, &data[i]);
+            }
+            else
+            {
+                retval = CMB_SPIWriteByte(spiSettings, regAddr, data[i]);
+            }
+
+            if (retval != 0)
+            {
+                return(COMMONERR_FAILED);
+            }
+        }
+
+        return(COMMONERR_OK);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        regAddr = addr[i] & ~CMB_SPI_READ;
+        /* the HAL is told which words are reads, the read bit level depends on the polarity */
+        readFlags[txBufIndex / 3] = (forceRead || (addr[i] & CMB_SPI_READ)) ? 1 : 0;
+        if (readFlags[txBufIndex / 3])
+        {
+            txbuf[txBufIndex++] = ((~_writeBitPolarity & 1) << 7) | ((regAddr >> 8) & 0x7F);
+            txbuf[txBufIndex++] = (regAddr & 0xFF);
+            txbuf[txBufIndex++] = 0x00;
+        }
+        else
+        {
+            txbuf[txBufIndex++] = ((_writeBitPolarity & 1) << 7) | ((regAddr >> 8) & 0x7F);
+            txbuf[txBufIndex++] = (regAddr & 0xFF);
+            txbuf[txBufIndex++] = data[i];
+        }
+
+        /* Send full buffer when possible */
+        if ((txBufIndex >= SPIARRAYTRIPSIZE) || (i == (count - 1)))
+        {
+            retval = HAL_spiTransfer((char *)txbuf, txBufIndex, readFlags, (char *)rxbuf);
+            if (retval != 0)
+            {
+                printf("Error reading SPI");
+                return(COMMONERR_FAILED);
+            }
+
+            /* read results come back in the order the reads were queued */
+            rxIndex = 0;
+            for (j = start; j <= i; j++)
+            {
+                regAddr = addr[j] & ~CMB_SPI_READ;
+                isRead = (forceRead || (addr[j] & CMB_SPI_READ)) ? 1 : 0;
+                if (isRead)
+                {
+                    data[j] = rxbuf[rxIndex++];
+                }
+                CMB_regShadowUpdate(spiSettings, regAddr, data[j]);
+                if (isRead)
+                {
+                    CMB_SPIScriptAddRead(spiSettings, regAddr);
+                    CMB_STAT_ADD(_cmbStats.spiReads, 1);
+                    reads++;
+                }
+                else
+                {
+                    CMB_SPIScriptAddWrite(spiSettings, regAddr, data[j]);
+                    CMB_STAT_ADD(_cmbStats.spiWrites, 1);
+                }
+
+                if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+                {
+                    if (isRead)
+                    {
+                        CMB_logSpi(HAL_LOGREC_SPI_READ, spiSettings->chipSelectIndex, regAddr, data[j], 0, 0, 1);
+                    }
+                    else
+                    {
+                        CMB_logSpi(HAL_LOGREC_SPI_WRITE, spiSettings->chipSelectIndex, regAddr, data[j], 0, 0, 1);
+                    }
+                }
+            }
+
+            start = i + 1;
+            txBufIndex = 0;
+        }
+    }
+
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_TRANSFER, count, count - reads, reads, tStart);
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIReadBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *readdata, uint32_t count)
+{
+    return(CMB_SPITransfer(spiSettings, addr, readdata, count, 1));
+}
+
+commonErr_t CMB_SPITransferBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count)
+{
+    return(CMB_SPITransfer(spiSettings, addr, data, count, 0));
+}
+
+commonErr_t CMB_SPIWriteField(spiSettings_t *spiSettings, uint16_t addr, uint8_t field_val, uint8_t mask, uint8_t start_bit)
+{
+    uint8_t Val=0;
+    cmbRegShadow_t *shadow = NULL;
+    commonErr_t retval = COMMONERR_OK;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    {
+        CMB_logSpi(HAL_LOGREC_SPI_WRITE_FIELD, spiSettings->chipSelectIndex, addr, field_val, mask, start_bit, 1);
+    }
+    CMB_STAT_ADD(_cmbStats.fieldWrites, 1);
+
+    shadow = spiSettings->regShadow;
+    if ((shadow != NULL) && !shadow->suspended && (addr < CMB_REGSHADOW_SIZE) &&
+        ((shadow->flags[addr] & (CMB_REGSHADOW_VALID | CMB_REGSHADOW_VOLATILE)) == CMB_REGSHADOW_VALID))
+    {
+        /* configuration register already known, skip the SPI read */
+        Val = shadow->value[addr];
+        shadow->hits++;
+    }
+    else
+    {
+        if (shadow != NULL)
+        {
+            shadow->misses++;
+        }
+
+        /* the write below carries the whole register, replay does not need this read */
+        _scriptMute++;
+        retval = CMB_SPIReadByte(spiSettings, addr, &Val);
+        _scriptMute--;
+        if(retval)
+        {
+            return(COMMONERR_FAILED);
+        }
+    }
+    Val = (Val & ~mask) | ((field_val << start_bit) & mask);
+    if(CMB_SPIWriteByte(spiSettings, addr, Val))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WRITEFIELD, 1, 1, 0, tStart);
+
+    return(COMMONERR_OK);
+}
+
+/* read a field in a single register space (not multibyte fields) */
+commonErr_t CMB_SPIReadField(spiSettings_t *spiSettings, uint16_t addr, uint8_t *field_val, uint8_t mask, uint8_t start_bit)
+{
+    uint8_t data;
+
+    if(CMB_SPIReadByte(spiSettings, addr, &data))
+    {
+        return(COMMONERR_FAILED);
+    }
+    *field_val =(uint8_t)((data & mask) >> start_bit);
+
+    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    {
+        CMB_logSpi(HAL_LOGREC_SPI_READ_FIELD, spiSettings->chipSelectIndex, addr, *field_val, mask, start_bit, 1);
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_regShadowSeed(spiSettings_t *spiSettings, const uint8_t *defaults, uint32_t count)
+{
+    cmbRegShadow_t *shadow = spiSettings->regShadow;
+    uint32_t i = 0;
+
+    if (shadow == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    if (count > CMB_REGSHADOW_SIZE)
+    {
+        count = CMB_REGSHADOW_SIZE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(shadow->flags[i] & CMB_REGSHADOW_VOLATILE))
+        {
+            shadow->value[i] = defaults[i];
+            shadow->flags[i] |= CMB_REGSHADOW_VALID;
+        }
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_regShadowSetVolatile(spiSettings_t *spiSettings, uint16_t firstAddr, uint16_t lastAddr)
+{
+    cmbRegShadow_t *shadow = spiSettings->regShadow;
+    uint32_t i = 0;
+
+    if (shadow == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    if ((firstAddr > lastAddr) || (lastAddr >= CMB_REGSHADOW_SIZE))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    for (i = firstAddr; i <= lastAddr; i++)
+    {
+        shadow->flags[i] = CMB_REGSHADOW_VOLATILE;
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_regShadowInvalidate(spiSettings_t *spiSettings)
+{
+    cmbRegShadow_t *shadow = spiSettings->regShadow;
+    uint32_t i = 0;
+
+    if (shadow == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    for (i = 0; i < CMB_REGSHADOW_SIZE; i++)
+    {
+        shadow->flags[i] &= ~CMB_REGSHADOW_VALID;
+    }
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_regShadowSuspend(spiSettings_t *spiSettings, uint8_t suspend)
+{
+    cmbRegShadow_t *shadow = spiSettings->regShadow;
+
+    if (shadow == NULL)
+    {
+        return(COMMONERR_OK);
+    }
+
+    /* nothing was tracked while suspended, so resume with an empty shadow */
+    if (shadow->suspended && !suspend)
+    {
+        CMB_regShadowInvalidate(spiSettings);
+    }
+    shadow->suspended = (suspend > 0) ? 1 : 0;
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIScriptRecord(spiSettings_t *spiSettings, cmbSpiScript_t *script)
+{
+    /* accesses already queued belong before the recording starts or stops */
+    if (CMB_SPIBatchFlush())
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    if (script != NULL)
+    {
+        script->len = 0;
+        script->lastRecord = 0;
+        script->overflow = 0;
+    }
+
+    _scriptSettings = spiSettings;
+    _script = script;
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIScriptCheckpoint(spiSettings_t *spiSettings, uint16_t addr, uint8_t mask, uint8_t expected)
+{
+    uint32_t pos = 0;
+    uint32_t found = 0xFFFFFFFF;
+    uint8_t *rec = NULL;
+
+    if ((_script == NULL) || (spiSettings != _scriptSettings))
+    {
+        return(COMMONERR_OK);
+    }
+
+    /* walk the records to find the last read of addr */
+    while (pos < _script->len)
+    {
+        rec = &_script->buf[pos];
+        switch (rec[0])
+        {
+            case CMB_SPISCRIPT_WRITES:
+                pos += 3 + (3 * (uint32_t)(rec[1] | (rec[2] << 8)));
+                break;
+            case CMB_SPISCRIPT_READ:
+                if ((rec[1] == (addr & 0xFF)) && (rec[2] == (addr >> 8)))
+                {
+                    found = pos;
+                }
+                pos += 5;
+                break;
+            default:
+                pos += 5;
+                break;
+        }
+    }
+
+    if (found == 0xFFFFFFFF)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    _script->buf[found + 3] = mask;
+    _script->buf[found + 4] = expected & mask;
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_SPIScriptReplay(spiSettings_t *spiSettings, cmbSpiScript_t *script)
+{
+    uint32_t pos = 0;
+    uint32_t i = 0;
+    uint32_t count = 0;
+    uint32_t time_ms = 0;
+    uint16_t addr = 0;
+    uint8_t mask = 0;
+    uint8_t expected = 0;
+    uint8_t data = 0;
+    uint8_t *rec = NULL;
+    uint16_t addrArray[CMB_SPIBATCH_SIZE];
+    uint8_t dataArray[CMB_SPIBATCH_SIZE];
+    cmbDeadline_t deadline;
+    commonErr_t retval = COMMONERR_OK;
+
+    if ((script == NULL) || script->overflow || (_script == script))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    _scriptMute++;
+    while ((pos < script->len) && (retval == COMMONERR_OK))
+    {
+        rec = &script->buf[pos];
+        switch (rec[0])
+        {
+            case CMB_SPISCRIPT_WRITES:
+                /* stream the block through the multi byte write path */
+                count = (uint32_t)(rec[1] | (rec[2] << 8));
+                pos += 3;
+                while ((count > 0) && (retval == COMMONERR_OK))
                 {
-                    HAL_writeToLogFile("SPIWrite: CS:%2d, ADDR:0x%03X, DATA:0x%02X \n", spiSettings->chipSelectIndex, addr[i], data[i]);
+                    for (i = 0; (i < CMB_SPIBATCH_SIZE) && (count > 0); i++, count--, pos += 3)
+                    {
+                        addrArray[i] = (uint16_t)(script->buf[pos] | (script->buf[pos + 1] << 8));
+                        dataArray[i] = script->buf[pos + 2];
+                    }
+                    retval = CMB_SPIWriteBytes(spiSettings, &addrArray[0], &dataArray[0], i);
                 }
+                break;
 
-                if (txBufIndex >= spiArrayTripSize)
-                {
-                    /* Send full buffer when possible */
-                    retval = HAL_spiWrite(txbuf, txBufIndex);
-                    if (retval < 0)
-                        goto error;
+            case CMB_SPISCRIPT_READ:
+                addr = (uint16_t)(rec[1] | (rec[2] << 8));
+                mask = rec[3];
+                expected = rec[4];
+                pos += 5;
 
-                    txBufIndex = 0;
+                retval = CMB_SPIReadByte(spiSettings, addr, &data);
+                if ((retval == COMMONERR_OK) && ((data & mask) != expected))
+                {
+                    /* checkpoint, give the device time to get there. Own deadline: the
+                       context timeout may be in use by the caller of the replay */
+                    CMB_deadlineStart_ms(&deadline, CMB_SPISCRIPT_POLL_TIMEOUT_MS);
+                    do
+                    {
+                        if (CMB_deadlineExpired(&deadline))
+                        {
+                            HAL_writeToLogFile("SPIScriptReplay: checkpoint ADDR:0x%03X, MASK:0x%02X expected 0x%02X, read 0x%02X\n", addr, mask, expected, data);
+                            retval = COMMONERR_FAILED;
+                            break;
+                        }
+                        retval = CMB_SPIReadByte(spiSettings, addr, &data);
+                    } while ((retval == COMMONERR_OK) && ((data & mask) != expected));
                 }
-            }
+                break;
 
-            /* Send any data that was not sent as a full buffer before */
-            if (txBufIndex > 0)
-            {
-                retval = HAL_spiWrite(txbuf, txBufIndex);
-                if (retval < 0)
-                    goto error;
+            case CMB_SPISCRIPT_WAIT:
+                time_ms = (uint32_t)rec[1] | ((uint32_t)rec[2] << 8) | ((uint32_t)rec[3] << 16) | ((uint32_t)rec[4] << 24);
+                pos += 5;
+                retval = CMB_wait_ms(time_ms);
+                break;
 
-                txBufIndex = 0;
-            }
+            default:
+                HAL_writeToLogFile("SPIScriptReplay: bad record 0x%02X at %d\n", rec[0], pos);
+                retval = COMMONERR_FAILED;
+                break;
         }
     }
+    _scriptMute--;
 
-    return(COMMONERR_OK);
-
-error:
-    printf("Error writing SPI");
-    return(COMMONERR_FAILED);
+    return(retval);
 }
 
-commonErr_t CMB_SPIReadByte(spiSettings_t *spiSettings, uint16_t addr, uint8_t *readdata)
+commonErr_t CMB_SPIScriptSave(cmbSpiScript_t *script, const char *filename)
 {
-    uint8_t data=0;
-    int32_t retval = 0;
-    unsigned char txbuf[] = {0x00,0x00,0x00};
+    FILE *fp = NULL;
+    uint8_t header[13];
+    uint32_t magic = CMB_SPISCRIPT_MAGIC;
+    uint32_t i = 0;
 
-    if(_chipSelectIndex != spiSettings->chipSelectIndex)
+    if (script->overflow)
     {
-        if(CMB_setSPIOptions(spiSettings))
-        {
-            return(COMMONERR_FAILED);
-        }
-        if(CMB_setSPIChannel(spiSettings->chipSelectIndex))
-        {
-            return(COMMONERR_FAILED);
-        }
+        return(COMMONERR_FAILED);
     }
-    if(spiSettings->longInstructionWord)
+
+    for (i = 0; i < 4; i++)
     {
-        txbuf[0] = ((~_writeBitPolarity & 1) << 7) | ((addr >> 8) & 0x7F);
-        txbuf[1] = addr & 0xFF;
-        retval = HAL_spiRead(txbuf, 2, &data);
-        if (retval < 0)
-        {
-            return(COMMONERR_FAILED);
-        }
-        else
-        {
-            *readdata =(uint8_t)data;
-        }
+        header[i] = (uint8_t)(magic >> (8 * i));
+        header[5 + i] = (uint8_t)(script->userData >> (8 * i));
+        header[9 + i] = (uint8_t)(script->len >> (8 * i));
     }
-    else
+    header[4] = CMB_SPISCRIPT_VERSION;
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL)
     {
-        txbuf[0] = ((~_writeBitPolarity & 1) << 7) | (addr & 0x7F);
-        retval = HAL_spiRead(txbuf, 1, &data);
-        if (retval < 0)
-        {
-            printf("Error writing SPI");
-            return(COMMONERR_FAILED);
-        }
-        else
-        {
-            *readdata =(uint8_t)data;
-        }
+        return(COMMONERR_FAILED);
     }
-    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+
+    if ((fwrite(header, sizeof(header), 1, fp) != 1) || ((script->len > 0) && (fwrite(script->buf, script->len, 1, fp) != 1)))
     {
-        HAL_writeToLogFile("SPIRead: CS:%2d, ADDR:0x%03X, ReadData:0x%02X\n", spiSettings->chipSelectIndex, addr, *readdata);
+        fclose(fp);
+        return(COMMONERR_FAILED);
     }
 
+    fclose(fp);
     return(COMMONERR_OK);
 }
 
-commonErr_t CMB_SPIWriteField(spiSettings_t *spiSettings, uint16_t addr, uint8_t field_val, uint8_t mask, uint8_t start_bit)
+commonErr_t CMB_SPIScriptLoad(cmbSpiScript_t *script, const char *filename)
 {
-    uint8_t Val=0;
+    FILE *fp = NULL;
+    uint8_t header[13];
+    uint32_t magic = 0;
+    uint32_t len = 0;
+    uint32_t userData = 0;
+    uint32_t i = 0;
 
-    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
     {
-        HAL_writeToLogFile("SPIWriteField: CS:%2d, ADDR:0x%03X, FIELDVAL:0x%02X, MASK:0x%02X, STARTBIT:%d \n", spiSettings->chipSelectIndex,addr, field_val, mask, start_bit);
+        return(COMMONERR_FAILED);
     }
-    if(CMB_SPIReadByte(spiSettings, addr, &Val))
+
+    if (fread(header, sizeof(header), 1, fp) != 1)
     {
+        fclose(fp);
         return(COMMONERR_FAILED);
     }
-    Val = (Val & ~mask) | ((field_val << start_bit) & mask);
-    if(CMB_SPIWriteByte(spiSettings, addr, Val))
+
+    for (i = 0; i < 4; i++)
     {
+        magic |= (uint32_t)header[i] << (8 * i);
+        userData |= (uint32_t)header[5 + i] << (8 * i);
+        len |= (uint32_t)header[9 + i] << (8 * i);
+    }
+
+    if ((magic != CMB_SPISCRIPT_MAGIC) || (header[4] != CMB_SPISCRIPT_VERSION) || (len > script->size) ||
+        ((len > 0) && (fread(script->buf, len, 1, fp) != 1)))
+    {
+        fclose(fp);
         return(COMMONERR_FAILED);
     }
 
+    fclose(fp);
+    script->len = len;
+    script->lastRecord = 0;
+    script->userData = userData;
+    script->overflow = 0;
+
     return(COMMONERR_OK);
 }
 
-/* read a field in a single register space (not multibyte fields) */
-commonErr_t CMB_SPIReadField(spiSettings_t *spiSettings, uint16_t addr, uint8_t *field_val, uint8_t mask, uint8_t start_bit)
+commonErr_t CMB_getStats(cmbStats_t *stats)
 {
-    uint8_t data;
+    stats->spiWrites = CMB_STAT_LOAD(_cmbStats.spiWrites);
+    stats->spiReads = CMB_STAT_LOAD(_cmbStats.spiReads);
+    stats->fieldWrites = CMB_STAT_LOAD(_cmbStats.fieldWrites);
+    stats->timeoutChecks = CMB_STAT_LOAD(_cmbStats.timeoutChecks);
+    stats->waits = CMB_STAT_LOAD(_cmbStats.waits);
+    stats->waitTime_us = CMB_STAT_LOAD(_cmbStats.waitTime_us);
 
-    if(CMB_SPIReadByte(spiSettings, addr, &data))
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_resetStats(void)
+{
+    memset(&_cmbStats, 0, sizeof(_cmbStats));
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_getDeviceStats(spiSettings_t *spiSettings, cmbDevStats_t *snapshot)
+{
+#if (CMB_ENABLE_DEVSTATS == 1)
+    cmbDevStats_t *dev = spiSettings->devStats;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    if (dev == NULL)
     {
         return(COMMONERR_FAILED);
     }
-    *field_val =(uint8_t)((data & mask) >> start_bit);
 
-    if(CMB_LOGLEVEL & ADIHAL_LOG_SPI)
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    /* field by field, each counter is consistent on its own */
+    for (i = 0; i < CMB_STATOP_NUM; i++)
+    {
+        snapshot->op[i].calls = CMB_STAT_LOAD(dev->op[i].calls);
+        snapshot->op[i].items = CMB_STAT_LOAD(dev->op[i].items);
+        snapshot->op[i].time_ns = CMB_STAT_LOAD(dev->op[i].time_ns);
+        snapshot->op[i].maxTime_ns = CMB_STAT_LOAD(dev->op[i].maxTime_ns);
+        for (j = 0; j < CMB_DEVSTATS_HIST_BINS; j++)
+        {
+            snapshot->op[i].hist[j] = CMB_STAT_LOAD(dev->op[i].hist[j]);
+        }
+    }
+
+    snapshot->numCallers = __atomic_load_n(&dev->numCallers, __ATOMIC_ACQUIRE);
+    for (i = 0; i < snapshot->numCallers; i++)
+    {
+        snapshot->caller[i].name = dev->caller[i].name;
+        snapshot->caller[i].entries = CMB_STAT_LOAD(dev->caller[i].entries);
+        snapshot->caller[i].spiWrites = CMB_STAT_LOAD(dev->caller[i].spiWrites);
+        snapshot->caller[i].spiReads = CMB_STAT_LOAD(dev->caller[i].spiReads);
+        snapshot->caller[i].time_ns = CMB_STAT_LOAD(dev->caller[i].time_ns);
+    }
+
+    return(COMMONERR_OK);
+#else
+    return(COMMONERR_FAILED);
+#endif
+}
+
+commonErr_t CMB_resetDeviceStats(spiSettings_t *spiSettings)
+{
+#if (CMB_ENABLE_DEVSTATS == 1)
+    if (spiSettings->devStats == NULL)
     {
-        HAL_writeToLogFile("SPIReadField: CS:%2d, ADDR:0x%03X, MASK:0x%02X, STARTBIT:%d, FieldVal:0x%02X\n", spiSettings->chipSelectIndex,addr, mask, start_bit, *field_val);
+        return(COMMONERR_FAILED);
     }
 
+    /* not atomic against a concurrent update, call it while the device is idle. Threads
+       look their caller slot up again on their next entry */
+    memset(spiSettings->devStats, 0, sizeof(*spiSettings->devStats));
+#endif
+
     return(COMMONERR_OK);
 }
 
 commonErr_t CMB_writeToLog(ADI_LOGLEVEL level, uint8_t deviceIndex, uint32_t errorCode, const char *comment){
+    halLogRecord_t rec;
 
-    if((CMB_LOGLEVEL & ADIHAL_LOG_ERROR) && (level == ADIHAL_LOG_ERROR))
-    {
-        HAL_writeToLogFile("ERROR: %d: %s", (int)errorCode, comment);
-    }
-    else if((CMB_LOGLEVEL & ADIHAL_LOG_WARNING) && (level == ADIHAL_LOG_WARNING))
+#if (CMB_ENABLE_DEVSTATS == 1)
+    /* every MYKONOS_* function logs its name on entry, use it to attribute the SPI cost */
+    if ((level == ADIHAL_LOG_MESSAGE) && (errorCode == 0) && (strncmp(comment, "MYKONOS_", 8) == 0))
     {
-        HAL_writeToLogFile("WARNING: %d: %s",(int)errorCode, comment);
+        CMB_statsEnterCall(comment);
     }
-    else if((CMB_LOGLEVEL & ADIHAL_LOG_MESSAGE) && (level == ADIHAL_LOG_MESSAGE))
+#endif
+
+    if(((CMB_LOGLEVEL & ADIHAL_LOG_ERROR) && (level == ADIHAL_LOG_ERROR)) ||
+       ((CMB_LOGLEVEL & ADIHAL_LOG_WARNING) && (level == ADIHAL_LOG_WARNING)) ||
+       ((CMB_LOGLEVEL & ADIHAL_LOG_MESSAGE) && (level == ADIHAL_LOG_MESSAGE)))
     {
-        HAL_writeToLogFile("MESSAGE: %d: %s",(int)errorCode, comment);
+        /* "ERROR: %d: %s", "WARNING: %d: %s" or "MESSAGE: %d: %s", see HAL_writeLogRecord */
+        memset(&rec, 0, sizeof(rec));
+        rec.type = HAL_LOGREC_MESSAGE;
+        rec.level = (uint8_t)level;
+        rec.chipSelect = deviceIndex;
+        rec.errorCode = errorCode;
+        rec.comment = comment;
+        HAL_writeLogRecord(&rec);
     }
     else if(CMB_LOGLEVEL == ADIHAL_LOG_NONE )
     {
@@ -430,42 +1670,130 @@ commonErr_t CMB_flushLog(void)
 
 commonErr_t CMB_wait_ms(uint32_t time_ms)
 {
-    /* nanosleep can be interrupted, if so, call until total time has completed */
-    struct timespec t0;
-    struct timespec t1;
-    struct timespec *temp;
-    struct timespec *waitTime = &t0;
-    struct timespec *remaining = &t1;
+    return(CMB_wait_us(time_ms * 1000));
+}
+
+commonErr_t CMB_wait_us(uint32_t time_us)
+{
+    uint64_t tStart = 0;
 
-    waitTime->tv_sec = time_ms/1000;
-    waitTime->tv_nsec = (time_ms % 1000) * (1000000);
+    CMB_STATS_START(tStart);
 
-    while((nanosleep(waitTime, remaining) == (-1)) && (errno == EINTR))
+    /* whatever the caller waits for needs its writes on the device first */
+    CMB_SPIBatchFlush();
+    CMB_SPIScriptAddWait((time_us + 999) / 1000);
+    CMB_STAT_ADD(_cmbStats.waits, 1);
+    CMB_STAT_ADD(_cmbStats.waitTime_us, time_us);
+
+    /* sleeps for the bulk and spins for the last HAL_WAIT_SPIN_US, us accurate */
+    HAL_wait_us(time_us);
+
+    CMB_STATS_END(_statsDevice, CMB_STATOP_WAIT, time_us, 0, 0, tStart);
+
+    return(COMMONERR_OK);
+}
+
+/* Pause between two status polls of a device, ends early when the device's GP interrupt
+   fires (*interrupted = 1, may be NULL). Without an interrupt source it is a plain wait. Not
+   recorded into an SPI script, the replay polls the status itself (CMB_SPISCRIPT_READ). */
+commonErr_t CMB_pollWait_us(spiSettings_t *spiSettings, uint32_t time_us, uint8_t *interrupted)
+{
+    int irq = 0;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    CMB_SPIBatchFlush();
+    CMB_bindContext(spiSettings);
+    CMB_STAT_ADD(_cmbStats.waits, 1);
+    CMB_STAT_ADD(_cmbStats.waitTime_us, time_us);
+    irq = HAL_waitIrq_us(time_us);
+    CMB_STATS_END(spiSettings->devStats, CMB_STATOP_WAIT, time_us, 0, 0, tStart);
+
+    if (interrupted != NULL)
     {
-        /* if nanosleep returned early due to a interrupt, nanosleep again using remaining time */
-        temp = waitTime;
-        waitTime = remaining;
-        remaining = temp;
+        *interrupted = (irq == 1) ? 1 : 0;
     }
 
+    return((irq < 0) ? COMMONERR_FAILED : COMMONERR_OK);
+}
+
+commonErr_t CMB_openIrq(spiSettings_t *spiSettings, const char *uioDevice)
+{
+    CMB_bindContext(spiSettings);
+    return((HAL_openIrq(uioDevice) == 0) ? COMMONERR_OK : COMMONERR_FAILED);
+}
+
+commonErr_t CMB_setIrqFd(spiSettings_t *spiSettings, int fd)
+{
+    CMB_bindContext(spiSettings);
+    HAL_setIrqFd(fd);
     return(COMMONERR_OK);
 }
 
-commonErr_t CMB_wait_us(uint32_t time_us)
+commonErr_t CMB_closeIrq(spiSettings_t *spiSettings)
+{
+    CMB_bindContext(spiSettings);
+    HAL_closeIrq();
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_deadlineStart_us(cmbDeadline_t *deadline, uint32_t timeOut_us)
+{
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    CMB_SPIBatchFlush();
+    deadline->expiry_ns = HAL_getTime_ns() + (uint64_t)timeOut_us * 1000;
+    CMB_STATS_END(_statsDevice, CMB_STATOP_SETTIMEOUT, 1, 0, 0, tStart);
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_deadlineStart_ms(cmbDeadline_t *deadline, uint32_t timeOut_ms)
+{
+    return(CMB_deadlineStart_us(deadline, timeOut_ms * 1000));
+}
+
+commonErr_t CMB_deadlineExpired(const cmbDeadline_t *deadline)
+{
+    uint64_t now = 0;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    now = HAL_getTime_ns();
+    CMB_STAT_ADD(_cmbStats.timeoutChecks, 1);
+    CMB_STATS_END(_statsDevice, CMB_STATOP_CHECKTIMEOUT, 1, 0, 0, tStart);
+
+    return((now >= deadline->expiry_ns) ? COMMONERR_FAILED : COMMONERR_OK);
+}
+
+uint32_t CMB_deadlineRemaining_us(const cmbDeadline_t *deadline)
 {
-    return(CMB_wait_ms( time_us / 1000));
+    uint64_t now = HAL_getTime_ns();
+
+    return((now >= deadline->expiry_ns) ? 0 : (uint32_t)((deadline->expiry_ns - now) / 1000));
 }
 
 commonErr_t CMB_setTimeout_ms(uint32_t timeOut_ms)
 {
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    CMB_SPIBatchFlush();
     HAL_setTimeout_ms(timeOut_ms);
+    CMB_STATS_END(_statsDevice, CMB_STATOP_SETTIMEOUT, 1, 0, 0, tStart);
 
     return(COMMONERR_OK);
 }
 
 commonErr_t CMB_setTimeout_us(uint32_t timeOut_us)
 {
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+    CMB_SPIBatchFlush();
     HAL_setTimeout_us(timeOut_us);
+    CMB_STATS_END(_statsDevice, CMB_STATOP_SETTIMEOUT, 1, 0, 0, tStart);
 
     return(COMMONERR_OK);
 }
@@ -473,9 +1801,16 @@ commonErr_t CMB_setTimeout_us(uint32_t timeOut_us)
 commonErr_t CMB_hasTimeoutExpired()
 {
     uint8_t retval = 0;
+    uint64_t tStart = 0;
+
+    CMB_STATS_START(tStart);
+
+    /* HAL_hasTimeoutExpired() returns 1 while the timeout is still running */
     retval = HAL_hasTimeoutExpired();
+    CMB_STAT_ADD(_cmbStats.timeoutChecks, 1);
+    CMB_STATS_END(_statsDevice, CMB_STATOP_CHECKTIMEOUT, 1, 0, 0, tStart);
 
-    if (retval > 0)
+    if (retval == 0)
     {
         return (COMMONERR_FAILED);
     }
@@ -487,11 +1822,9 @@ commonErr_t CMB_hasTimeoutExpired()
 
 commonErr_t CMB_regRead(uint32_t offset, uint32_t *data)
 {
-    char *uiod = "/dev/uio0";
-    const uint32_t map_size = 0x1000;
     uint32_t error = 0;
 
-    error = fpgaAxiReadWrite(uiod, map_size, 1, offset, 0, data);
+    error = HAL_regRead(offset, data);
 
     if(CMB_LOGLEVEL & ADIHAL_LOG_AXI_REG)
     {
@@ -511,11 +1844,9 @@ commonErr_t CMB_regRead(uint32_t offset, uint32_t *data)
 
 commonErr_t CMB_regWrite(uint32_t offset, uint32_t data)
 {
-    char *uiod = "/dev/uio0";
-    const uint32_t map_size = 0x1000;
     uint32_t error = 0;
 
-    error = fpgaAxiReadWrite(uiod, map_size, 1, offset, 1, &data);
+    error = HAL_regWrite(offset, data);
 
     if(CMB_LOGLEVEL & ADIHAL_LOG_AXI_REG)
     {
@@ -534,11 +1865,9 @@ commonErr_t CMB_regWrite(uint32_t offset, uint32_t data)
 
 commonErr_t CMB_memRead(uint32_t offset, uint32_t *data, uint32_t len)
 {
-    char *uiod = "/dev/uio1";
-    const uint32_t map_size = 0x40000000;
     uint32_t error = 0;
 
-    error = fpgaAxiReadWrite(uiod, map_size, len, offset, 0, data);
+    error = HAL_memRead(offset, data, len);
 
     if(CMB_LOGLEVEL & ADIHAL_LOG_AXI_MEM)
     {
@@ -557,11 +1886,9 @@ commonErr_t CMB_memRead(uint32_t offset, uint32_t *data, uint32_t len)
 
 commonErr_t CMB_memWrite(uint32_t offset, uint32_t *data, uint32_t len)
 {
-    char *uiod = "/dev/uio1";
-    const uint32_t map_size = 0x40000000;
     uint32_t error = 0;
 
-    error = fpgaAxiReadWrite(uiod, map_size, len, offset, 1, data);
+    error = HAL_memWrite(offset, data, len);
 
     if(CMB_LOGLEVEL & ADIHAL_LOG_AXI_MEM)
     {
@@ -577,3 +1904,168 @@ commonErr_t CMB_memWrite(uint32_t offset, uint32_t *data, uint32_t len)
         return(COMMONERR_OK);
     }
 }
+
+/* starts the capture engine on buffer fillIndex unless the application still holds it */
+static commonErr_t CMB_captureArm(cmbCaptureRing_t *ring)
+{
+    uint32_t offset = ring->ddrOffset + (ring->fillIndex * ring->bufferWords * 4);
+    uint32_t error = 0;
+
+    if (__atomic_load_n(&ring->held[ring->fillIndex], __ATOMIC_ACQUIRE))
+    {
+        return(COMMONERR_OK);
+    }
+
+    error = CMB_regWrite(FPGA_CAPTURE_ADDR, offset);
+    error |= CMB_regWrite(FPGA_CAPTURE_LEN, ring->bufferWords);
+    error |= CMB_regWrite(FPGA_CAPTURE_CTRL, ((uint32_t)ring->source << FPGA_CAPTURE_SRC_SHIFT) | FPGA_CAPTURE_START);
+
+    if (error != 0)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    ring->filling = 1;
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_captureStart(cmbCaptureRing_t *ring)
+{
+    uint32_t *base = NULL;
+    uint32_t i = 0;
+
+    if ((ring == NULL) || (ring->spiSettings == NULL) ||
+        (ring->numBuffers < 2) || (ring->numBuffers > CMB_CAPTURE_MAX_BUFFERS) ||
+        (ring->bufferWords == 0) || (ring->bufferWords & 3) || (ring->ddrOffset & 15) ||
+        (ring->bufferWords > (UINT32_MAX / 4) / ring->numBuffers))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    base = (uint32_t *)HAL_memPtr(ring->ddrOffset, ring->numBuffers * ring->bufferWords);
+    if (base == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    for (i = 0; i < ring->numBuffers; i++)
+    {
+        ring->buffer[i] = base + (i * ring->bufferWords);
+        ring->held[i] = 0;
+    }
+    ring->fillIndex = 0;
+    ring->filling = 0;
+    ring->sequence = 0;
+    ring->stalls = 0;
+    ring->running = 1;
+
+    if(CMB_LOGLEVEL & ADIHAL_LOG_AXI_MEM)
+    {
+        HAL_writeToLogFile("Capture Start: OFFSET_ADDR:0x%08X, LENGTH:0x%08X, BUFFERS:%u\n", ring->ddrOffset, ring->bufferWords, ring->numBuffers);
+    }
+
+    CMB_bindContext(ring->spiSettings);
+    return(CMB_captureArm(ring));
+}
+
+commonErr_t CMB_captureAcquire(cmbCaptureRing_t *ring, cmbCaptureView_t *view, uint32_t timeout_us)
+{
+    cmbDeadline_t deadline;
+    uint32_t interval_us = 0;
+    uint32_t status = 0;
+    uint32_t index = 0;
+
+    if ((ring == NULL) || (view == NULL) || !ring->running)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    interval_us = (ring->pollInterval_us != 0) ? ring->pollInterval_us : CMB_CAPTURE_POLL_US;
+    CMB_bindContext(ring->spiSettings);
+    CMB_deadlineStart_us(&deadline, timeout_us);
+
+    for (;;)
+    {
+        /* the engine waits here while the application holds the next buffer */
+        if (!ring->filling && CMB_captureArm(ring))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        if (ring->filling)
+        {
+            if (CMB_regRead(FPGA_CAPTURE_STATUS, &status))
+            {
+                return(COMMONERR_FAILED);
+            }
+
+            if (status & FPGA_CAPTURE_ERROR)
+            {
+                ring->filling = 0;
+                return(COMMONERR_FAILED);
+            }
+
+            if (status & FPGA_CAPTURE_DONE)
+            {
+                break;
+            }
+        }
+
+        if (CMB_deadlineExpired(&deadline))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        CMB_pollWait_us(ring->spiSettings, interval_us, NULL);
+    }
+
+    index = ring->fillIndex;
+    __atomic_store_n(&ring->held[index], 1, __ATOMIC_RELAXED);
+    ring->filling = 0;
+    ring->fillIndex = (index + 1) % ring->numBuffers;
+
+    /* the engine fills the next buffer while the application works on this one, a failure
+       shows up on the next CMB_captureAcquire */
+    CMB_captureArm(ring);
+    if (!ring->filling)
+    {
+        ring->stalls++;
+    }
+
+    view->data = ring->buffer[index];
+    view->numWords = ring->bufferWords;
+    view->index = index;
+    view->sequence = ring->sequence++;
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_captureRelease(cmbCaptureRing_t *ring, const cmbCaptureView_t *view)
+{
+    if ((ring == NULL) || (view == NULL) || (view->index >= ring->numBuffers) ||
+        (view->data != ring->buffer[view->index]) ||
+        !__atomic_load_n(&ring->held[view->index], __ATOMIC_RELAXED))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    /* the application is done reading the buffer before the engine may fill it again */
+    __atomic_store_n(&ring->held[view->index], 0, __ATOMIC_RELEASE);
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_captureStop(cmbCaptureRing_t *ring)
+{
+    if ((ring == NULL) || !ring->running)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    /* held buffers stay valid, the engine writes no more of the ring */
+    CMB_bindContext(ring->spiSettings);
+    ring->running = 0;
+    ring->filling = 0;
+
+    return(CMB_regWrite(FPGA_CAPTURE_CTRL, 0));
+}
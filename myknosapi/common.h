@@ -22,11 +22,43 @@ extern "C" {
 
 #define THROW_ERROR()
 
+struct halContext; /* HAL.h */
+
 #define SPIARRAYSIZE 1024
 
 /* assuming 3 byte SPI message - integer math enforces floor() */
 #define SPIARRAYTRIPSIZE ((SPIARRAYSIZE / 3) * 3)
 
+/* bytes of a pre-encoded write stream CMB_SPIWriteEncoded hands to the HAL at a time */
+#define CMB_SPIENCODED_CHUNK (SPIARRAYTRIPSIZE * 16)
+
+/* set in an addr[] entry of CMB_SPITransferBytes to read that register into data[] instead of writing it */
+#define CMB_SPI_READ 0x8000
+
+/* cmbSpiScript_t record types */
+#define CMB_SPISCRIPT_WRITES 0x01 /* count u16, then count x (addr u16, data u8) */
+#define CMB_SPISCRIPT_READ   0x02 /* addr u16, mask u8, expected u8: replay polls until (reg & mask) == expected */
+#define CMB_SPISCRIPT_WAIT   0x03 /* time_ms u32 */
+
+/* how long a replayed checkpoint read may poll before the script is declared stale */
+#define CMB_SPISCRIPT_POLL_TIMEOUT_MS 1000
+
+/* number of registers covered by the optional register shadow (0x000 - 0xFFF) */
+#define CMB_REGSHADOW_SIZE 0x1000
+
+/* number of register writes a cmbSpiBatch_t holds before it is flushed */
+#define CMB_SPIBATCH_SIZE (SPIARRAYTRIPSIZE / 3)
+
+/* largest ring CMB_captureStart accepts */
+#define CMB_CAPTURE_MAX_BUFFERS 16
+
+/* capture status poll interval when cmbCaptureRing_t.pollInterval_us is 0 */
+#define CMB_CAPTURE_POLL_US 50
+
+/* cmbRegShadow_t flags[] bits */
+#define CMB_REGSHADOW_VALID    0x01 /* value[] holds what the device register contains */
+#define CMB_REGSHADOW_VOLATILE 0x02 /* register is changed by the device itself, never served from the shadow */
+
 /*========================================
  * Enums and structures
  *=======================================*/
@@ -58,6 +90,137 @@ typedef enum
 	ADIHAL_LOG_ALL     = 0x3F
 } ADI_LOGLEVEL;
 
+/**
+ * \brief Write-through shadow of a device register space
+ *
+ * Keeps the last value written to (or read from) each register so CMB_SPIWriteField
+ * can skip the SPI read of its read-modify-write. Registers flagged volatile always go
+ * to the device. While suspended the shadow is neither used nor updated.
+ */
+typedef struct
+{
+    uint8_t value[CMB_REGSHADOW_SIZE];  ///< last known register values
+    uint8_t flags[CMB_REGSHADOW_SIZE];  ///< CMB_REGSHADOW_VALID / CMB_REGSHADOW_VOLATILE per register
+    uint8_t suspended;                  ///< 1 = bypass the shadow, every access goes to the device
+    uint32_t hits;                      ///< read-modify-writes served from the shadow
+    uint32_t misses;                    ///< read-modify-writes that had to read the device
+} cmbRegShadow_t;
+
+/**
+ * \brief Register write batch used between CMB_SPIBatchBegin and CMB_SPIBatchCommit
+ *
+ * CMB_SPIWriteByte queues writes here instead of sending each one on its own. The queue
+ * goes out as one CMB_SPIWriteBytes transfer on commit, when it is full, and before any
+ * SPI read, wait, timeout or access to another device, so the device sees the original order.
+ * Begin/Commit pairs nest, only the outermost commit ends the batch.
+ */
+typedef struct
+{
+    uint16_t addr[CMB_SPIBATCH_SIZE];   ///< queued register addresses
+    uint8_t data[CMB_SPIBATCH_SIZE];    ///< queued register values
+    uint32_t count;                     ///< number of queued writes
+    uint8_t depth;                      ///< CMB_SPIBatchBegin calls not committed yet, 0 = writes go out directly
+    uint32_t writes;                    ///< writes that went through the batch
+    uint32_t flushes;                   ///< transfers used to send them
+} cmbSpiBatch_t;
+
+/**
+ * \brief Recorded SPI access script used by CMB_SPIScriptRecord and CMB_SPIScriptReplay
+ *
+ * Holds the ordered register writes, reads and waits of one device as a compact byte
+ * stream. Reads are replayed as plain reads unless CMB_SPIScriptCheckpoint gave them an
+ * expected value, in which case replay polls for it and fails on timeout.
+ */
+typedef struct
+{
+    uint8_t *buf;                       ///< record storage, owned by the caller
+    uint32_t size;                      ///< bytes available in buf
+    uint32_t len;                       ///< bytes of buf in use
+    uint32_t lastRecord;                ///< offset of the last record, used to merge records
+    uint32_t userData;                  ///< saved with the script, e.g. a configuration version
+    uint8_t overflow;                   ///< 1 = buf was too small, the script is incomplete
+} cmbSpiScript_t;
+
+/* per device call statistics, 0 compiles out the timestamps taken around every CMB call */
+#ifndef CMB_ENABLE_DEVSTATS
+#define CMB_ENABLE_DEVSTATS 1
+#endif
+
+#define CMB_DEVSTATS_HIST_BINS  24  /* bin 0: < 1us, bin n: [2^(n-1), 2^n) us, the last bin is open ended */
+#define CMB_DEVSTATS_MAX_CALLERS 64 /* distinct MYKONOS_* functions attributed per device */
+
+typedef enum
+{
+    CMB_STATOP_WRITEBYTE = 0,
+    CMB_STATOP_WRITEBYTES,
+    CMB_STATOP_READBYTE,
+    CMB_STATOP_TRANSFER,            ///< CMB_SPIReadBytes / CMB_SPITransferBytes
+    CMB_STATOP_WRITEFIELD,          ///< includes the read and write it issues
+    CMB_STATOP_WAIT,
+    CMB_STATOP_SETTIMEOUT,
+    CMB_STATOP_CHECKTIMEOUT,
+    CMB_STATOP_NUM
+} cmbStatOp_t;
+
+/**
+ * \brief Timeout owned by the caller, on the monotonic clock. Unlike CMB_setTimeout_ms a
+ *        poll loop can run its own deadline while a function it calls runs another one.
+ */
+typedef struct
+{
+    uint64_t expiry_ns;                 ///< HAL_getTime_ns() time the deadline passes
+} cmbDeadline_t;
+
+/**
+ * \brief Count and latency of one CMB call type
+ */
+typedef struct
+{
+    uint64_t calls;                     ///< completed calls
+    uint64_t items;                     ///< registers accessed, or us waited for CMB_STATOP_WAIT
+    uint64_t time_ns;                   ///< total time spent in the calls
+    uint64_t maxTime_ns;                ///< slowest call
+    uint32_t hist[CMB_DEVSTATS_HIST_BINS]; ///< latency histogram, see CMB_DEVSTATS_HIST_BINS
+} cmbOpStats_t;
+
+/**
+ * \brief SPI and wait cost charged to one MYKONOS_* function
+ *
+ * Costs are charged to the MYKONOS_* function the accessing thread entered last, so a caller
+ * is only charged for the accesses it makes before its first sub call.
+ */
+typedef struct
+{
+    const char *name;                   ///< entry message of the function, "MYKONOS_xxx()\n"
+    uint64_t entries;                   ///< times the function was entered and then accessed the device
+    uint64_t spiWrites;                 ///< register writes charged to it
+    uint64_t spiReads;                  ///< register reads charged to it
+    uint64_t time_ns;                   ///< SPI and wait time charged to it
+} cmbCallerStats_t;
+
+/**
+ * \brief Statistics of one device, kept in spiSettings_t::devStats, read with CMB_getDeviceStats
+ */
+typedef struct
+{
+    cmbOpStats_t op[CMB_STATOP_NUM];
+    uint32_t numCallers;
+    cmbCallerStats_t caller[CMB_DEVSTATS_MAX_CALLERS];
+} cmbDevStats_t;
+
+/**
+ * \brief Call counters kept by the CMB layer, read with CMB_getStats
+ */
+typedef struct
+{
+    uint64_t spiWrites;                 ///< register writes, batched or not
+    uint64_t spiReads;                  ///< register reads, including the reads of field read-modify-writes
+    uint64_t fieldWrites;               ///< CMB_SPIWriteField calls
+    uint64_t timeoutChecks;             ///< CMB_hasTimeoutExpired calls, one per poll loop iteration
+    uint64_t waits;                     ///< CMB_wait_ms / CMB_wait_us calls
+    uint64_t waitTime_us;               ///< total time requested by those waits
+} cmbStats_t;
+
 /**
  * \brief Data structure to hold SPI settings for all system device types
  */
@@ -69,13 +232,68 @@ typedef struct
 	uint8_t MSBFirst;               ///< 1 = MSBFirst, 0 = LSBFirst
 	uint8_t CPHA;                   ///< clock phase, sets which clock edge the data updates (valid 0 or 1)
 	uint8_t CPOL;                   ///< clock polarity 0 = clock starts low, 1 = clock starts high
-    uint8_t enSpiStreaming;         ///< Not implemented. SW feature to improve SPI throughput.
-    uint8_t autoIncAddrUp;          ///< Not implemented. For SPI Streaming, set address increment direction. 1= next addr = addr+1, 0:addr = addr-1
+    uint8_t enSpiStreaming;         ///< 1 = CMB_SPIWriteBytes sends runs of consecutive addresses as one streamed transaction (16bit instruction word, FPGA SPI core with SPI_TX_CONTINUE only)
+    uint8_t autoIncAddrUp;          ///< For SPI Streaming, set address increment direction. 1= next addr = addr+1, 0:addr = addr-1
     uint8_t fourWireMode;           ///< 1: Use 4-wire SPI, 0: 3-wire SPI (SDIO pin is bidirectional). NOTE: ADI's FPGA platform always uses 4-wire mode.
     uint32_t spiClkFreq_Hz;         ///< SPI Clk frequency in Hz (default 25000000), platform will use next lowest frequency that it's baud rate generator can create */
+    cmbRegShadow_t *regShadow;      ///< optional register shadow for this device, NULL = every read goes to the device
+    cmbSpiBatch_t *spiBatch;        ///< optional write batch buffer for this device, NULL = CMB_SPIBatchBegin has no effect
+    struct halContext *halContext;  ///< SPI core, timeout and log sink of this device, NULL = shared default. The thread accessing the device switches to it
+    cmbDevStats_t *devStats;        ///< optional call statistics of this device, zero initialized, NULL = not kept
 
 } spiSettings_t;
 
+/*!< \brief Sample stream the FPGA capture engine stores */
+typedef enum
+{
+    CMB_CAPTURE_RX = 0,
+    CMB_CAPTURE_ORX
+} cmbCaptureSource_t;
+
+/**
+ * \brief One filled capture buffer, handed out by CMB_captureAcquire
+ *
+ * data points straight into the FPGA DDR window. The engine does not write the buffer again
+ * until it is given back with CMB_captureRelease, from this or any other thread.
+ */
+typedef struct
+{
+    const uint32_t *data;               ///< captured 32-bit sample words, as stored by the FPGA
+    uint32_t numWords;                  ///< words in data
+    uint32_t index;                     ///< buffer of the ring
+    uint32_t sequence;                  ///< capture number since CMB_captureStart, consecutive captures are not contiguous in time, see cmbCaptureRing_t
+} cmbCaptureView_t;
+
+/**
+ * \brief Ring of capture buffers in the FPGA DDR window
+ *
+ * The engine fills the buffers in ring order. Each one then belongs to the application until it
+ * is released, while the engine goes on with the next one; when the next one is still held the
+ * engine waits (counted in stalls). One thread at a time may call CMB_captureAcquire.
+ *
+ * The engine holds one buffer at a time and is restarted in software, by the CMB_captureAcquire
+ * that finds the previous buffer done. The samples arriving between the end of one buffer and
+ * that restart (at least one status poll and three register writes) are not captured.
+ */
+typedef struct
+{
+    spiSettings_t *spiSettings;         ///< device whose capture engine fills the ring, its halContext selects the FPGA registers
+    cmbCaptureSource_t source;          ///< stream to capture
+    uint32_t ddrOffset;                 ///< byte offset of buffer 0 in the DDR window, 16 byte aligned
+    uint32_t bufferWords;               ///< 32-bit words per buffer, a multiple of 4
+    uint32_t numBuffers;                ///< buffers in the ring, 2 to CMB_CAPTURE_MAX_BUFFERS
+    uint32_t pollInterval_us;           ///< capture status poll interval, 0 = CMB_CAPTURE_POLL_US
+
+    /* state, set up by CMB_captureStart */
+    uint32_t *buffer[CMB_CAPTURE_MAX_BUFFERS]; ///< address of each buffer in the mapped DDR window
+    uint8_t held[CMB_CAPTURE_MAX_BUFFERS];     ///< 1 = owned by the application
+    uint32_t fillIndex;                 ///< buffer the engine fills next
+    uint8_t filling;                    ///< 1 = engine started on fillIndex
+    uint8_t running;                    ///< 1 = between CMB_captureStart and CMB_captureStop
+    uint32_t sequence;                  ///< captures handed out
+    uint32_t stalls;                    ///< times the engine had to wait for a buffer to be released
+} cmbCaptureRing_t;
+
 /* global variable so application layer can set the log level */
 extern ADI_LOGLEVEL CMB_LOGLEVEL;
 
@@ -85,24 +303,65 @@ commonErr_t CMB_closeHardware(void);
 /* GPIO function */
 commonErr_t CMB_setGPIO(uint32_t GPIO);
 
-/* hardware reset function */
+/* hardware reset function, acts on the FPGA registers of the context bound by CMB_bindContext() */
 commonErr_t CMB_hardReset(uint8_t spiChipSelectIndex);
+void CMB_bindContext(spiSettings_t *spiSettings);
 
 /* SPI read/write functions */
 commonErr_t CMB_setSPIOptions(spiSettings_t *spiSettings); /* allows the platform HAL to work with devices with various SPI settings */
 commonErr_t CMB_setSPIChannel(uint16_t chipSelectIndex );  /* value of 0 deasserts all chip selects */
 commonErr_t CMB_SPIWriteByte(spiSettings_t *spiSettings, uint16_t addr, uint8_t data); /* single SPI byte write function */
 commonErr_t CMB_SPIWriteBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count);
+commonErr_t CMB_SPIEncodeWrite(spiSettings_t *spiSettings, uint16_t addr, uint8_t data, uint8_t *word); /* the 3 byte SPI word of a register write, for CMB_SPIWriteEncoded */
+commonErr_t CMB_SPIWriteEncoded(spiSettings_t *spiSettings, const uint8_t *words, uint32_t count); /* count pre-encoded writes, volatile registers only: the shadow is not updated */
 commonErr_t CMB_SPIReadByte (spiSettings_t *spiSettings, uint16_t addr, uint8_t *readdata); /* single SPI byte read function */
+commonErr_t CMB_SPIReadBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *readdata, uint32_t count); /* pipelined multi byte read */
+commonErr_t CMB_SPITransferBytes(spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count); /* ordered mix of writes and reads (addr | CMB_SPI_READ) */
 commonErr_t CMB_SPIWriteField(spiSettings_t *spiSettings, uint16_t addr, uint8_t  field_val, uint8_t mask, uint8_t start_bit); /* write a field in a single register */
 commonErr_t CMB_SPIReadField (spiSettings_t *spiSettings, uint16_t addr, uint8_t *field_val, uint8_t mask, uint8_t start_bit);	/* read a field in a single register */
+commonErr_t CMB_SPIBatchBegin(spiSettings_t *spiSettings); /* queue following CMB_SPIWriteByte calls */
+commonErr_t CMB_SPIBatchCommit(spiSettings_t *spiSettings); /* ends the innermost batch, the outermost one sends the queued writes and stops queueing */
+commonErr_t CMB_SPIBatchFlush(void); /* send any queued writes now */
+commonErr_t CMB_setSPIPriority(uint8_t enable); /* 1 = this thread's CMB_SPIWriteByte calls overtake other threads' transfers on the bus */
+
+/* call counters, all devices */
+commonErr_t CMB_getStats(cmbStats_t *stats);
+commonErr_t CMB_resetStats(void);
+
+/* per device call statistics, updated without locks, a snapshot may be taken from any thread */
+commonErr_t CMB_getDeviceStats(spiSettings_t *spiSettings, cmbDevStats_t *snapshot);
+commonErr_t CMB_resetDeviceStats(spiSettings_t *spiSettings);
+
+/* SPI script record/replay functions */
+commonErr_t CMB_SPIScriptRecord(spiSettings_t *spiSettings, cmbSpiScript_t *script); /* record accesses to this device into script, NULL stops */
+commonErr_t CMB_SPIScriptCheckpoint(spiSettings_t *spiSettings, uint16_t addr, uint8_t mask, uint8_t expected); /* the last recorded read of addr must return expected under mask */
+commonErr_t CMB_SPIScriptReplay(spiSettings_t *spiSettings, cmbSpiScript_t *script); /* COMMONERR_FAILED when a checkpoint does not match */
+commonErr_t CMB_SPIScriptSave(cmbSpiScript_t *script, const char *filename);
+commonErr_t CMB_SPIScriptLoad(cmbSpiScript_t *script, const char *filename);
+
+/* register shadow functions, no-ops when spiSettings->regShadow is NULL */
+commonErr_t CMB_regShadowSeed(spiSettings_t *spiSettings, const uint8_t *defaults, uint32_t count); /* load reset defaults for the non volatile registers */
+commonErr_t CMB_regShadowSetVolatile(spiSettings_t *spiSettings, uint16_t firstAddr, uint16_t lastAddr); /* never serve firstAddr..lastAddr from the shadow */
+commonErr_t CMB_regShadowInvalidate(spiSettings_t *spiSettings); /* forget all cached values */
+commonErr_t CMB_regShadowSuspend(spiSettings_t *spiSettings, uint8_t suspend); /* 1 = bypass the shadow, 0 = resume with an empty shadow */
 
 /* platform timer functions */
 commonErr_t CMB_wait_ms(uint32_t time_ms);
 commonErr_t CMB_wait_us(uint32_t time_us);
-commonErr_t CMB_setTimeout_ms(uint32_t timeOut_ms);
+commonErr_t CMB_pollWait_us(spiSettings_t *spiSettings, uint32_t time_us, uint8_t *interrupted); /* pause between status polls, not recorded into SPI scripts */
+commonErr_t CMB_setTimeout_ms(uint32_t timeOut_ms); /* one timeout per thread, see cmbDeadline_t for nested waits */
 commonErr_t CMB_setTimeout_us(uint32_t timeOut_us);
 commonErr_t CMB_hasTimeoutExpired();
+commonErr_t CMB_deadlineStart_ms(cmbDeadline_t *deadline, uint32_t timeOut_ms);
+commonErr_t CMB_deadlineStart_us(cmbDeadline_t *deadline, uint32_t timeOut_us);
+commonErr_t CMB_deadlineExpired(const cmbDeadline_t *deadline); /* COMMONERR_FAILED once the deadline has passed */
+uint32_t CMB_deadlineRemaining_us(const cmbDeadline_t *deadline);
+
+/* GP interrupt of a device, wakes CMB_pollWait_us early. The fd follows UIO semantics:
+   write 1 to unmask, poll for POLLIN, read the 32-bit event count */
+commonErr_t CMB_openIrq(spiSettings_t *spiSettings, const char *uioDevice);
+commonErr_t CMB_setIrqFd(spiSettings_t *spiSettings, int fd);
+commonErr_t CMB_closeIrq(spiSettings_t *spiSettings);
 
 /* platform logging functions */
 commonErr_t CMB_openLog(const char *filename);
@@ -118,6 +377,12 @@ commonErr_t CMB_regWrite(uint32_t offset, uint32_t data);
 commonErr_t CMB_memRead(uint32_t offset, uint32_t *data, uint32_t len);
 commonErr_t CMB_memWrite(uint32_t offset, uint32_t *data, uint32_t len);
 
+/* zero copy Rx/ORx capture into a ring of DDR buffers */
+commonErr_t CMB_captureStart(cmbCaptureRing_t *ring);
+commonErr_t CMB_captureAcquire(cmbCaptureRing_t *ring, cmbCaptureView_t *view, uint32_t timeout_us); /* next filled buffer, COMMONERR_FAILED on timeout */
+commonErr_t CMB_captureRelease(cmbCaptureRing_t *ring, const cmbCaptureView_t *view); /* give the buffer back to the engine */
+commonErr_t CMB_captureStop(cmbCaptureRing_t *ring);
+
 #ifdef __cplusplus
 }
 #endif
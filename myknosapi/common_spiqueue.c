@@ -0,0 +1,448 @@
+/**
+ *\file common_spiqueue.c
+ *
+ *\brief SPI requests from several threads (AGC monitor, temperature poller, control plane, ...)
+ *       go into a lock free queue and are sent by one worker thread per bus. The worker sends
+ *       consecutive requests to the same device as one CMB_SPITransferBytes burst.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "common.h"
+#include "common_spiqueue.h"
+
+typedef struct
+{
+    uint32_t seq;                               /* position the cell is ready for, see CMB_spiQueueSubmit */
+    cmbSpiRequest_t *req;
+} cmbSpiQueueCell_t;
+
+struct cmbSpiQueue
+{
+    cmbSpiQueueCell_t *cells;
+    uint32_t mask;
+    uint32_t tail;                              /* next position producers claim */
+    uint32_t head;                              /* next position the worker takes, worker only */
+    uint32_t sleeping;                          /* 1 = the worker waits on wake */
+    uint32_t stopping;
+    uint32_t waiters;                           /* threads in CMB_spiRequestWait */
+    sem_t wake;
+    pthread_t worker;
+    pthread_mutex_t lock;                       /* only taken to sleep in / wake CMB_spiRequestWait */
+    pthread_cond_t done;
+    cmbSpiQueueStats_t stats;
+
+    /* burst being built by the worker */
+    cmbSpiRequest_t *reqs[CMB_SPIQUEUE_BURST];
+    uint16_t addr[CMB_SPIQUEUE_BURST];
+    uint8_t data[CMB_SPIQUEUE_BURST];
+};
+
+/* register accesses of a request in a burst */
+static uint32_t CMB_spiQueueEntries(const cmbSpiRequest_t *req)
+{
+    return((req->type == CMB_SPIREQ_WRITES) ? req->count : 1);
+}
+
+/* takes the oldest request, NULL when the queue is empty */
+static cmbSpiRequest_t *CMB_spiQueuePop(cmbSpiQueue_t *queue)
+{
+    cmbSpiQueueCell_t *cell = &queue->cells[queue->head & queue->mask];
+    cmbSpiRequest_t *req = NULL;
+
+    if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != queue->head + 1)
+    {
+        return(NULL);
+    }
+
+    req = cell->req;
+
+    /* hands the cell back to the producers one lap later */
+    __atomic_store_n(&cell->seq, queue->head + queue->mask + 1, __ATOMIC_RELEASE);
+    queue->head++;
+
+    return(req);
+}
+
+static void CMB_spiQueueWakeWorker(cmbSpiQueue_t *queue)
+{
+    if (__atomic_load_n(&queue->sleeping, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST))
+    {
+        sem_post(&queue->wake);
+    }
+}
+
+/* waits for a producer, unless one came in while the worker was getting ready to sleep */
+static void CMB_spiQueueSleep(cmbSpiQueue_t *queue)
+{
+    cmbSpiQueueCell_t *cell = &queue->cells[queue->head & queue->mask];
+
+    __atomic_store_n(&queue->sleeping, 1, __ATOMIC_SEQ_CST);
+
+    if ((__atomic_load_n(&cell->seq, __ATOMIC_SEQ_CST) == queue->head + 1) ||
+        __atomic_load_n(&queue->stopping, __ATOMIC_SEQ_CST))
+    {
+        if (__atomic_exchange_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST))
+        {
+            return;
+        }
+        /* a producer cleared sleeping first, take its post */
+    }
+
+    while ((sem_wait(&queue->wake) != 0) && (errno == EINTR))
+    {
+    }
+}
+
+static void CMB_spiQueueComplete(cmbSpiRequest_t *req, commonErr_t status)
+{
+    cmbSpiCallback_t callback = req->callback;
+    void *userData = req->userData;
+
+    /* the worker does not touch req after this, a waiter may reuse it right away */
+    __atomic_store_n(&req->status, (int32_t)status, __ATOMIC_SEQ_CST);
+
+    if (callback != NULL)
+    {
+        callback(req, userData);
+    }
+}
+
+/* sends the n requests collected in queue->reqs as one transfer */
+static void CMB_spiQueueSendBurst(cmbSpiQueue_t *queue, uint32_t n)
+{
+    cmbSpiRequest_t *req = NULL;
+    commonErr_t status = COMMONERR_OK;
+    uint32_t entries = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        req = queue->reqs[i];
+        switch (req->type)
+        {
+        case CMB_SPIREQ_READ:
+            queue->addr[entries] = req->addr | CMB_SPI_READ;
+            queue->data[entries++] = 0;
+            break;
+
+        case CMB_SPIREQ_WRITES:
+            for (j = 0; j < req->count; j++)
+            {
+                queue->addr[entries] = req->addrs[j];
+                queue->data[entries++] = req->datas[j];
+            }
+            break;
+
+        default:
+            queue->addr[entries] = req->addr;
+            queue->data[entries++] = req->data;
+            break;
+        }
+    }
+
+    /* reads and writes of several requests go out as one transfer, so writes after the last
+       read rely on HAL_spiTransfer keeping the FIFO credits of the words it read back */
+    status = CMB_SPITransferBytes(queue->reqs[0]->spiSettings, queue->addr, queue->data, entries);
+
+    entries = 0;
+    for (i = 0; i < n; i++)
+    {
+        req = queue->reqs[i];
+        if ((req->type == CMB_SPIREQ_READ) && (status == COMMONERR_OK))
+        {
+            *req->readData = queue->data[entries];
+        }
+        entries += CMB_spiQueueEntries(req);
+        CMB_spiQueueComplete(req, status);
+    }
+
+    __atomic_fetch_add(&queue->stats.requests, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&queue->stats.bursts, 1, __ATOMIC_RELAXED);
+    if (n > queue->stats.maxBurst)
+    {
+        __atomic_store_n(&queue->stats.maxBurst, n, __ATOMIC_RELAXED);
+    }
+}
+
+static void *CMB_spiQueueWorker(void *arg)
+{
+    cmbSpiQueue_t *queue = (cmbSpiQueue_t *)arg;
+    cmbSpiRequest_t *next = NULL;
+    spiSettings_t *spiSettings = NULL;
+    uint32_t entries = 0;
+    uint32_t n = 0;
+
+    for (;;)
+    {
+        if (next == NULL)
+        {
+            next = CMB_spiQueuePop(queue);
+        }
+
+        if (next == NULL)
+        {
+            if (__atomic_load_n(&queue->stopping, __ATOMIC_SEQ_CST))
+            {
+                break;
+            }
+            CMB_spiQueueSleep(queue);
+            continue;
+        }
+
+        if (CMB_spiQueueEntries(next) > CMB_SPIQUEUE_BURST)
+        {
+            CMB_spiQueueComplete(next, CMB_SPIWriteBytes(next->spiSettings, next->addrs, next->datas, next->count));
+            __atomic_fetch_add(&queue->stats.requests, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&queue->stats.bursts, 1, __ATOMIC_RELAXED);
+            next = NULL;
+        }
+        else
+        {
+            /* next and whatever is queued behind it for the same device */
+            spiSettings = next->spiSettings;
+            entries = 0;
+            n = 0;
+            do
+            {
+                entries += CMB_spiQueueEntries(next);
+                queue->reqs[n++] = next;
+                next = CMB_spiQueuePop(queue);
+            } while ((next != NULL) && (next->spiSettings == spiSettings) && (n < CMB_SPIQUEUE_BURST) &&
+                     (entries + CMB_spiQueueEntries(next) <= CMB_SPIQUEUE_BURST));
+
+            CMB_spiQueueSendBurst(queue, n);
+        }
+
+        if (__atomic_load_n(&queue->waiters, __ATOMIC_SEQ_CST))
+        {
+            pthread_mutex_lock(&queue->lock);
+            pthread_cond_broadcast(&queue->done);
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+
+    return(NULL);
+}
+
+commonErr_t CMB_spiQueueCreate(cmbSpiQueue_t **queue, uint32_t depth)
+{
+    cmbSpiQueue_t *q = NULL;
+    pthread_condattr_t attr;
+    uint32_t i = 0;
+
+    if ((queue == NULL) || (depth < 2) || (depth & (depth - 1)))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    q = (cmbSpiQueue_t *)calloc(1, sizeof(cmbSpiQueue_t));
+    if (q == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    q->cells = (cmbSpiQueueCell_t *)calloc(depth, sizeof(cmbSpiQueueCell_t));
+    if ((q->cells == NULL) || (sem_init(&q->wake, 0, 0) != 0))
+    {
+        free(q->cells);
+        free(q);
+        return(COMMONERR_FAILED);
+    }
+
+    for (i = 0; i < depth; i++)
+    {
+        q->cells[i].seq = i;
+    }
+    q->mask = depth - 1;
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->done, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&q->worker, NULL, CMB_spiQueueWorker, q) != 0)
+    {
+        pthread_cond_destroy(&q->done);
+        pthread_mutex_destroy(&q->lock);
+        sem_destroy(&q->wake);
+        free(q->cells);
+        free(q);
+        return(COMMONERR_FAILED);
+    }
+
+    *queue = q;
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_spiQueueDestroy(cmbSpiQueue_t *queue)
+{
+    if (queue == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    __atomic_store_n(&queue->stopping, 1, __ATOMIC_SEQ_CST);
+    CMB_spiQueueWakeWorker(queue);
+    pthread_join(queue->worker, NULL);
+
+    pthread_cond_destroy(&queue->done);
+    pthread_mutex_destroy(&queue->lock);
+    sem_destroy(&queue->wake);
+    free(queue->cells);
+    free(queue);
+
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_spiQueueSubmit(cmbSpiQueue_t *queue, cmbSpiRequest_t *req)
+{
+    cmbSpiQueueCell_t *cell = NULL;
+    uint32_t pos = 0;
+    int32_t diff = 0;
+
+    if ((queue == NULL) || (req == NULL) || (req->spiSettings == NULL) ||
+        __atomic_load_n(&queue->stopping, __ATOMIC_RELAXED) ||
+        ((req->type == CMB_SPIREQ_READ) && (req->readData == NULL)) ||
+        ((req->type == CMB_SPIREQ_WRITES) && ((req->count == 0) || (req->addrs == NULL) || (req->datas == NULL))))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    req->status = CMB_SPIREQ_PENDING;
+
+    /* claim a cell: it is free for position pos once its seq equals pos */
+    pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        cell = &queue->cells[pos & queue->mask];
+        diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* full, the worker frees a cell per request it takes */
+            sched_yield();
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->req = req;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    CMB_spiQueueWakeWorker(queue);
+    return(COMMONERR_OK);
+}
+
+commonErr_t CMB_spiQueueWriteByte(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t addr, uint8_t data)
+{
+    if (req == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    req->type = CMB_SPIREQ_WRITE;
+    req->spiSettings = spiSettings;
+    req->addr = addr;
+    req->data = data;
+    return(CMB_spiQueueSubmit(queue, req));
+}
+
+commonErr_t CMB_spiQueueReadByte(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t addr, uint8_t *readdata)
+{
+    if (req == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    req->type = CMB_SPIREQ_READ;
+    req->spiSettings = spiSettings;
+    req->addr = addr;
+    req->readData = readdata;
+    return(CMB_spiQueueSubmit(queue, req));
+}
+
+commonErr_t CMB_spiQueueWriteBytes(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count)
+{
+    if (req == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    req->type = CMB_SPIREQ_WRITES;
+    req->spiSettings = spiSettings;
+    req->addrs = addr;
+    req->datas = data;
+    req->count = count;
+    return(CMB_spiQueueSubmit(queue, req));
+}
+
+commonErr_t CMB_spiRequestWait(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, uint32_t timeout_us)
+{
+    struct timespec ts;
+    int32_t status = CMB_SPIREQ_PENDING;
+    int ret = 0;
+
+    if ((queue == NULL) || (req == NULL))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    status = __atomic_load_n(&req->status, __ATOMIC_ACQUIRE);
+    if (status != CMB_SPIREQ_PENDING)
+    {
+        return((commonErr_t)status);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_us / 1000000;
+    ts.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    __atomic_fetch_add(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&queue->lock);
+    while (((status = __atomic_load_n(&req->status, __ATOMIC_SEQ_CST)) == CMB_SPIREQ_PENDING) && (ret != ETIMEDOUT))
+    {
+        ret = pthread_cond_timedwait(&queue->done, &queue->lock, &ts);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    __atomic_fetch_sub(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return((status == CMB_SPIREQ_PENDING) ? COMMONERR_FAILED : (commonErr_t)status);
+}
+
+commonErr_t CMB_spiQueueGetStats(cmbSpiQueue_t *queue, cmbSpiQueueStats_t *stats)
+{
+    if ((queue == NULL) || (stats == NULL))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    stats->requests = __atomic_load_n(&queue->stats.requests, __ATOMIC_RELAXED);
+    stats->bursts = __atomic_load_n(&queue->stats.bursts, __ATOMIC_RELAXED);
+    stats->maxBurst = __atomic_load_n(&queue->stats.maxBurst, __ATOMIC_RELAXED);
+
+    return(COMMONERR_OK);
+}
@@ -0,0 +1,83 @@
+/**
+ * \file common_spiqueue.h
+ * \brief Contains type definitions and prototype declarations for common_spiqueue.c,
+ *        SPI requests from several threads sent by one worker thread per bus
+ */
+
+#ifndef _COMMON_SPIQUEUE_H_
+#define _COMMON_SPIQUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "common.h"
+
+/* cmbSpiRequest_t.status while the request is queued or on the bus */
+#define CMB_SPIREQ_PENDING (-1)
+
+/* register accesses the worker sends as one CMB_SPITransferBytes burst at most */
+#define CMB_SPIQUEUE_BURST 256
+
+typedef struct cmbSpiQueue cmbSpiQueue_t;
+struct cmbSpiRequest;
+
+/* runs on the worker thread once the request is done, it may submit or free req */
+typedef void (*cmbSpiCallback_t)(struct cmbSpiRequest *req, void *userData);
+
+typedef enum
+{
+    CMB_SPIREQ_WRITE = 0,               /*!< addr = data */
+    CMB_SPIREQ_READ,                    /*!< *readData = addr */
+    CMB_SPIREQ_WRITES                   /*!< addrs[i] = datas[i], count entries */
+} cmbSpiRequestType_t;
+
+/**
+ * \brief One queued SPI access, owned by the caller until it completes
+ *
+ * Filled in by CMB_spiQueueWriteByte, CMB_spiQueueReadByte or CMB_spiQueueWriteBytes;
+ * callback and userData are left as the caller set them.
+ */
+typedef struct cmbSpiRequest
+{
+    cmbSpiRequestType_t type;
+    spiSettings_t *spiSettings;         ///< device, must be on the queue's bus
+    uint16_t addr;
+    uint8_t data;
+    uint8_t *readData;                  ///< CMB_SPIREQ_READ result
+    uint16_t *addrs;                    ///< CMB_SPIREQ_WRITES registers
+    uint8_t *datas;                     ///< CMB_SPIREQ_WRITES values
+    uint32_t count;                     ///< CMB_SPIREQ_WRITES entries
+    cmbSpiCallback_t callback;          ///< NULL = none, wait with CMB_spiRequestWait
+    void *userData;                     ///< passed to callback
+    volatile int32_t status;            ///< CMB_SPIREQ_PENDING, then commonErr_t of the access
+} cmbSpiRequest_t;
+
+/**
+ * \brief Queue counters, see CMB_spiQueueGetStats
+ */
+typedef struct
+{
+    uint64_t requests;                  ///< requests completed
+    uint64_t bursts;                    ///< SPI transfers used for them
+    uint32_t maxBurst;                  ///< most requests sent in one transfer
+} cmbSpiQueueStats_t;
+
+/* The queue owns every device submitted to it while it runs: the worker accesses them with
+   CMB_SPITransferBytes, and the regShadow, spiBatch and chip select state of a spiSettings_t
+   are not thread safe. No other thread may call CMB_SPI* (or MYKONOS_*) on these devices
+   until CMB_spiQueueDestroy has returned. */
+commonErr_t CMB_spiQueueCreate(cmbSpiQueue_t **queue, uint32_t depth);  /* depth: power of 2 */
+commonErr_t CMB_spiQueueDestroy(cmbSpiQueue_t *queue);                  /* completes what is queued, then stops the worker */
+commonErr_t CMB_spiQueueSubmit(cmbSpiQueue_t *queue, cmbSpiRequest_t *req); /* lock free, any thread, waits for room when full */
+commonErr_t CMB_spiQueueWriteByte(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t addr, uint8_t data);
+commonErr_t CMB_spiQueueReadByte(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t addr, uint8_t *readdata);
+commonErr_t CMB_spiQueueWriteBytes(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, spiSettings_t *spiSettings, uint16_t *addr, uint8_t *data, uint32_t count);
+commonErr_t CMB_spiRequestWait(cmbSpiQueue_t *queue, cmbSpiRequest_t *req, uint32_t timeout_us); /* status of req, COMMONERR_FAILED on timeout */
+commonErr_t CMB_spiQueueGetStats(cmbSpiQueue_t *queue, cmbSpiQueueStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
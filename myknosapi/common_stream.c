@@ -0,0 +1,672 @@
+/**
+ *\file common_stream.c
+ *
+ *\brief Continuous IQ streaming between the FPGA DDR and a file or socket. The calling
+ *       thread drives the FPGA capture / playback engine while a second thread converts
+ *       the samples and does the file I/O, so the engine works on one buffer while the
+ *       previous one is on its way to (or from) the file.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "common.h"
+#include "common_stream.h"
+#include "fpga.h"
+#include "HAL.h"
+
+/* 8 samples per kernel step: 16 byte int16 / uint32 vectors, 32 byte float vectors (two NEON q
+   registers on the HPS) */
+typedef int16_t cmbVecS16_t __attribute__((vector_size(16)));
+typedef int32_t cmbVecS32_t __attribute__((vector_size(32)));
+typedef float cmbVecF32_t __attribute__((vector_size(32)));
+typedef uint32_t cmbVecU32_t __attribute__((vector_size(16)));
+
+/* int16 full scale, the default scale of float samples */
+#define CMB_STREAM_FULL_SCALE 32768.0f
+
+typedef struct
+{
+    cmbStream_t *stream;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t done;                                   /* the side feeding the other one has finished */
+    uint8_t failed;                                 /* either side hit an error */
+
+    /* Rx: captured buffers on their way to the file thread */
+    cmbCaptureRing_t ring;
+    cmbCaptureView_t queue[CMB_CAPTURE_MAX_BUFFERS];
+    uint32_t head;
+    uint32_t count;
+    uint32_t held;                                  /* buffers queued or being written */
+
+    /* Tx: buffers read from the file on their way to the DDR */
+    uint32_t *staging[CMB_STREAM_TX_BUFFERS];
+    int32_t stagingWords[CMB_STREAM_TX_BUFFERS];    /* words in a full slot, 0 = end of the file, -1 = error */
+    uint8_t stagingFull[CMB_STREAM_TX_BUFFERS];
+
+    /* conversion scratch of the file thread */
+    uint32_t *words;                                /* bufferWords, channel 1 in the first half, channel 2 in the second */
+    float *values;                                  /* 2 * bufferWords */
+} cmbStreamPipe_t;
+
+void CMB_iqToFloat(const int16_t *in, float *out, uint32_t count, float scale)
+{
+    cmbVecS16_t s;
+    cmbVecF32_t f;
+
+    for (; count >= 8; count -= 8)
+    {
+        memcpy(&s, in, sizeof(s));
+        f = __builtin_convertvector(s, cmbVecF32_t) * scale;
+        memcpy(out, &f, sizeof(f));
+        in += 8;
+        out += 8;
+    }
+
+    for (; count > 0; count--)
+    {
+        *out++ = (float)*in++ * scale;
+    }
+}
+
+void CMB_iqFromFloat(const float *in, int16_t *out, uint32_t count, float scale)
+{
+    const cmbVecF32_t maxVal = (cmbVecF32_t){0} + 32767.0f;
+    const cmbVecF32_t minVal = (cmbVecF32_t){0} - 32768.0f;
+    const cmbVecS32_t signBit = (cmbVecS32_t){0} + (int32_t)0x80000000;
+    const cmbVecS32_t half = (cmbVecS32_t){0} + (int32_t)0x3F000000; /* 0.5f */
+    cmbVecF32_t f;
+    cmbVecS32_t mask;
+    cmbVecS16_t s;
+    float v = 0;
+
+    for (; count >= 8; count -= 8)
+    {
+        memcpy(&f, in, sizeof(f));
+        f = f * scale;
+
+        /* round half away from zero, then saturate */
+        f = f + (cmbVecF32_t)(((cmbVecS32_t)f & signBit) | half);
+        mask = (f > maxVal);
+        f = (cmbVecF32_t)((mask & (cmbVecS32_t)maxVal) | (~mask & (cmbVecS32_t)f));
+        mask = (f < minVal);
+        f = (cmbVecF32_t)((mask & (cmbVecS32_t)minVal) | (~mask & (cmbVecS32_t)f));
+
+        s = __builtin_convertvector(__builtin_convertvector(f, cmbVecS32_t), cmbVecS16_t);
+        memcpy(out, &s, sizeof(s));
+        in += 8;
+        out += 8;
+    }
+
+    for (; count > 0; count--)
+    {
+        v = *in++ * scale;
+        v = (v < 0) ? (v - 0.5f) : (v + 0.5f);
+        v = (v > 32767.0f) ? 32767.0f : ((v < -32768.0f) ? -32768.0f : v);
+        *out++ = (int16_t)v;
+    }
+}
+
+void CMB_iqDeinterleave(const uint32_t *in, uint32_t *out1, uint32_t *out2, uint32_t numWords)
+{
+    const cmbVecU32_t even = {0, 2, 4, 6};
+    const cmbVecU32_t odd = {1, 3, 5, 7};
+    cmbVecU32_t a;
+    cmbVecU32_t b;
+    cmbVecU32_t c;
+
+    for (; numWords >= 8; numWords -= 8)
+    {
+        memcpy(&a, in, sizeof(a));
+        memcpy(&b, in + 4, sizeof(b));
+        c = __builtin_shuffle(a, b, even);
+        memcpy(out1, &c, sizeof(c));
+        c = __builtin_shuffle(a, b, odd);
+        memcpy(out2, &c, sizeof(c));
+        in += 8;
+        out1 += 4;
+        out2 += 4;
+    }
+
+    for (; numWords >= 2; numWords -= 2)
+    {
+        *out1++ = *in++;
+        *out2++ = *in++;
+    }
+}
+
+void CMB_iqInterleave(const uint32_t *in1, const uint32_t *in2, uint32_t *out, uint32_t numWords)
+{
+    const cmbVecU32_t low = {0, 4, 1, 5};
+    const cmbVecU32_t high = {2, 6, 3, 7};
+    cmbVecU32_t a;
+    cmbVecU32_t b;
+    cmbVecU32_t c;
+
+    for (; numWords >= 8; numWords -= 8)
+    {
+        memcpy(&a, in1, sizeof(a));
+        memcpy(&b, in2, sizeof(b));
+        c = __builtin_shuffle(a, b, low);
+        memcpy(out, &c, sizeof(c));
+        c = __builtin_shuffle(a, b, high);
+        memcpy(out + 4, &c, sizeof(c));
+        in1 += 4;
+        in2 += 4;
+        out += 8;
+    }
+
+    for (; numWords >= 2; numWords -= 2)
+    {
+        *out++ = *in1++;
+        *out++ = *in2++;
+    }
+}
+
+static int CMB_streamWriteAll(int fd, const void *buf, size_t bytes)
+{
+    const char *p = (const char *)buf;
+    ssize_t ret = 0;
+
+    while (bytes > 0)
+    {
+        ret = write(fd, p, bytes);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += ret;
+        bytes -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/* reads up to bytes, less only at the end of the file. Returns the bytes read, -1 on error */
+static ssize_t CMB_streamReadAll(int fd, void *buf, size_t bytes)
+{
+    char *p = (char *)buf;
+    size_t total = 0;
+    ssize_t ret = 0;
+
+    while (total < bytes)
+    {
+        ret = read(fd, p + total, bytes - total);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (ret == 0)
+        {
+            break;
+        }
+        total += (size_t)ret;
+    }
+
+    return (ssize_t)total;
+}
+
+/* writes numWords sample words of one channel to fd in the stream format */
+static int CMB_streamWriteChannel(cmbStreamPipe_t *pipe, int fd, const uint32_t *data, uint32_t numWords)
+{
+    cmbStream_t *stream = pipe->stream;
+    float scale = (stream->scale != 0) ? stream->scale : (1.0f / CMB_STREAM_FULL_SCALE);
+
+    if (stream->format == CMB_STREAM_FLOAT)
+    {
+        CMB_iqToFloat((const int16_t *)data, pipe->values, numWords * 2, scale);
+        stream->bytes += (uint64_t)numWords * 2 * sizeof(float);
+        return CMB_streamWriteAll(fd, pipe->values, (size_t)numWords * 2 * sizeof(float));
+    }
+
+    stream->bytes += (uint64_t)numWords * 4;
+    return CMB_streamWriteAll(fd, data, (size_t)numWords * 4);
+}
+
+/* reads up to numWords sample words of one channel from fd in the stream format. Returns
+   the words read, -1 on error */
+static int32_t CMB_streamReadChannel(cmbStreamPipe_t *pipe, int fd, uint32_t *data, uint32_t numWords)
+{
+    cmbStream_t *stream = pipe->stream;
+    float scale = (stream->scale != 0) ? stream->scale : CMB_STREAM_FULL_SCALE;
+    ssize_t bytes = 0;
+
+    if (stream->format == CMB_STREAM_FLOAT)
+    {
+        bytes = CMB_streamReadAll(fd, pipe->values, (size_t)numWords * 2 * sizeof(float));
+        if (bytes < 0)
+        {
+            return -1;
+        }
+        numWords = (uint32_t)bytes / (2 * sizeof(float));
+        CMB_iqFromFloat(pipe->values, (int16_t *)data, numWords * 2, scale);
+        stream->bytes += (uint64_t)bytes;
+        return (int32_t)numWords;
+    }
+
+    bytes = CMB_streamReadAll(fd, data, (size_t)numWords * 4);
+    if (bytes < 0)
+    {
+        return -1;
+    }
+    stream->bytes += (uint64_t)bytes;
+    return (int32_t)(bytes / 4);
+}
+
+/* Rx file thread: writes the captured buffers in order and gives them back to the ring */
+static void *CMB_streamRxWriter(void *arg)
+{
+    cmbStreamPipe_t *pipe = (cmbStreamPipe_t *)arg;
+    cmbStream_t *stream = pipe->stream;
+    cmbCaptureView_t view;
+    uint32_t half = 0;
+    int error = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pipe->lock);
+        while ((pipe->count == 0) && !pipe->done)
+        {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+
+        if (pipe->count == 0)
+        {
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+
+        view = pipe->queue[pipe->head];
+        pipe->head = (pipe->head + 1) % CMB_CAPTURE_MAX_BUFFERS;
+        pipe->count--;
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (stream->fd2 >= 0)
+        {
+            /* Rx1 and Rx2 words alternate */
+            half = view.numWords / 2;
+            CMB_iqDeinterleave(view.data, pipe->words, pipe->words + half, half * 2);
+            error = CMB_streamWriteChannel(pipe, stream->fd, pipe->words, half);
+            error |= CMB_streamWriteChannel(pipe, stream->fd2, pipe->words + half, half);
+        }
+        else
+        {
+            /* int16 samples go from the DDR window to the file without a copy */
+            error = CMB_streamWriteChannel(pipe, stream->fd, view.data, view.numWords);
+        }
+        stream->words += view.numWords;
+
+        CMB_captureRelease(&pipe->ring, &view);
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->held--;
+        if (error)
+        {
+            pipe->failed = 1;
+        }
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (error)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static commonErr_t CMB_streamRx(cmbStreamPipe_t *pipe)
+{
+    cmbStream_t *stream = pipe->stream;
+    cmbCaptureView_t view;
+    pthread_t writer;
+    uint64_t queued = 0;
+    commonErr_t error = COMMONERR_OK;
+
+    pipe->ring.spiSettings = stream->spiSettings;
+    pipe->ring.source = stream->source;
+    pipe->ring.ddrOffset = stream->ddrOffset;
+    pipe->ring.bufferWords = stream->bufferWords;
+    pipe->ring.numBuffers = stream->numBuffers;
+
+    if (CMB_captureStart(&pipe->ring))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    if (pthread_create(&writer, NULL, CMB_streamRxWriter, pipe) != 0)
+    {
+        CMB_captureStop(&pipe->ring);
+        return(COMMONERR_FAILED);
+    }
+
+    while (!__atomic_load_n(&stream->stop, __ATOMIC_RELAXED) && ((stream->maxWords == 0) || (queued < stream->maxWords)))
+    {
+        /* leave the engine a free buffer instead of timing out on one the file thread holds */
+        pthread_mutex_lock(&pipe->lock);
+        while ((pipe->held >= stream->numBuffers) && !pipe->failed)
+        {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (pipe->failed)
+        {
+            break;
+        }
+
+        if (CMB_captureAcquire(&pipe->ring, &view, stream->timeout_us))
+        {
+            error = COMMONERR_FAILED;
+            break;
+        }
+
+        if ((stream->maxWords != 0) && (view.numWords > stream->maxWords - queued))
+        {
+            view.numWords = (uint32_t)(stream->maxWords - queued);
+        }
+        queued += view.numWords;
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->queue[(pipe->head + pipe->count) % CMB_CAPTURE_MAX_BUFFERS] = view;
+        pipe->count++;
+        pipe->held++;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->done = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    pthread_join(writer, NULL);
+
+    CMB_captureStop(&pipe->ring);
+    stream->stalls = pipe->ring.stalls;
+
+    return((pipe->failed) ? COMMONERR_FAILED : error);
+}
+
+/* Tx file thread: reads and converts the next buffer while the previous one is written to
+   the DDR and played */
+static void *CMB_streamTxReader(void *arg)
+{
+    cmbStreamPipe_t *pipe = (cmbStreamPipe_t *)arg;
+    cmbStream_t *stream = pipe->stream;
+    uint64_t total = 0;
+    uint32_t slot = 0;
+    uint32_t want = 0;
+    uint32_t half = 0;
+    int32_t n1 = 0;
+    int32_t n2 = 0;
+    int32_t numWords = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->stagingFull[slot] && !pipe->failed)
+        {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (pipe->failed)
+        {
+            break;
+        }
+
+        want = stream->bufferWords;
+        if ((stream->maxWords != 0) && (want > stream->maxWords - total))
+        {
+            want = (uint32_t)(stream->maxWords - total);
+        }
+
+        if (__atomic_load_n(&stream->stop, __ATOMIC_RELAXED))
+        {
+            numWords = 0;
+        }
+        else if (stream->fd2 >= 0)
+        {
+            /* Tx1 from fd and Tx2 from fd2, alternating words in the DDR */
+            half = want / 2;
+            n1 = CMB_streamReadChannel(pipe, stream->fd, pipe->words, half);
+            n2 = CMB_streamReadChannel(pipe, stream->fd2, pipe->words + half, half);
+            numWords = ((n1 < 0) || (n2 < 0)) ? -1 : (((n1 < n2) ? n1 : n2) * 2);
+            if (numWords > 0)
+            {
+                CMB_iqInterleave(pipe->words, pipe->words + half, pipe->staging[slot], (uint32_t)numWords);
+            }
+        }
+        else
+        {
+            numWords = CMB_streamReadChannel(pipe, stream->fd, pipe->staging[slot], want);
+        }
+
+        if (numWords > 0)
+        {
+            total += (uint32_t)numWords;
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->stagingWords[slot] = numWords;
+        pipe->stagingFull[slot] = 1;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (numWords <= 0)
+        {
+            break;
+        }
+        slot = (slot + 1) % CMB_STREAM_TX_BUFFERS;
+    }
+
+    return NULL;
+}
+
+/* waits for the playback engine to finish its buffer, counts a stall when it already had */
+static commonErr_t CMB_streamTxWaitDone(cmbStreamPipe_t *pipe)
+{
+    cmbStream_t *stream = pipe->stream;
+    cmbDeadline_t deadline;
+    uint32_t status = 0;
+    uint8_t first = 1;
+
+    CMB_deadlineStart_us(&deadline, stream->timeout_us);
+
+    for (;;)
+    {
+        if (CMB_regRead(FPGA_PLAYBACK_STATUS, &status) || (status & FPGA_PLAYBACK_ERROR))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        if (status & FPGA_PLAYBACK_DONE)
+        {
+            if (first)
+            {
+                stream->stalls++;
+            }
+            return(COMMONERR_OK);
+        }
+
+        if (CMB_deadlineExpired(&deadline))
+        {
+            return(COMMONERR_FAILED);
+        }
+
+        first = 0;
+        CMB_pollWait_us(stream->spiSettings, CMB_CAPTURE_POLL_US, NULL);
+    }
+}
+
+static commonErr_t CMB_streamTx(cmbStreamPipe_t *pipe)
+{
+    cmbStream_t *stream = pipe->stream;
+    pthread_t reader;
+    uint32_t slot = 0;
+    uint32_t offset = 0;
+    uint32_t error = 0;
+    uint8_t playing = 0;
+    int32_t numWords = 0;
+
+    if (pthread_create(&reader, NULL, CMB_streamTxReader, pipe) != 0)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pipe->lock);
+        while (!pipe->stagingFull[slot])
+        {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        numWords = pipe->stagingWords[slot];
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (numWords <= 0)
+        {
+            error = (numWords < 0) ? 1 : 0;
+            break;
+        }
+
+        /* DDR buffer slot last played two buffers ago, it is free since the previous one started */
+        offset = stream->ddrOffset + (slot * stream->bufferWords * 4);
+        error = CMB_memWrite(offset, pipe->staging[slot], (uint32_t)numWords);
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->stagingFull[slot] = 0;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+
+        /* the engine takes one buffer at a time, the next one starts only after the status
+           poll has seen the previous one done: the deframer gets no samples in between */
+        if (playing)
+        {
+            error |= CMB_streamTxWaitDone(pipe);
+        }
+
+        if (error == 0)
+        {
+            error = CMB_regWrite(FPGA_PLAYBACK_ADDR, offset);
+            error |= CMB_regWrite(FPGA_PLAYBACK_LEN, (uint32_t)numWords);
+            error |= CMB_regWrite(FPGA_PLAYBACK_CTRL, FPGA_PLAYBACK_START);
+        }
+
+        if (error)
+        {
+            break;
+        }
+
+        playing = 1;
+        stream->words += (uint32_t)numWords;
+        slot = (slot + 1) % CMB_STREAM_TX_BUFFERS;
+    }
+
+    if (playing && (error == 0))
+    {
+        error = CMB_streamTxWaitDone(pipe);
+    }
+
+    /* stops the reader if it is still going */
+    pthread_mutex_lock(&pipe->lock);
+    pipe->failed = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    pthread_join(reader, NULL);
+
+    return((error != 0) ? COMMONERR_FAILED : COMMONERR_OK);
+}
+
+commonErr_t CMB_streamRun(cmbStream_t *stream)
+{
+    cmbStreamPipe_t *pipe = NULL;
+    uint32_t i = 0;
+    uint8_t allocFailed = 0;
+    commonErr_t error = COMMONERR_OK;
+
+    if ((stream == NULL) || (stream->spiSettings == NULL) || (stream->fd < 0) ||
+        (stream->bufferWords == 0) || (stream->bufferWords & 7) || (stream->ddrOffset & 15) ||
+        ((stream->direction == CMB_STREAM_RX) &&
+         ((stream->numBuffers < 2) || (stream->numBuffers > CMB_CAPTURE_MAX_BUFFERS))) ||
+        (stream->bufferWords > (UINT32_MAX / 8) / CMB_CAPTURE_MAX_BUFFERS))
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    pipe = (cmbStreamPipe_t *)calloc(1, sizeof(cmbStreamPipe_t));
+    if (pipe == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    pipe->stream = stream;
+    pipe->words = (uint32_t *)malloc((size_t)stream->bufferWords * sizeof(uint32_t));
+    pipe->values = (float *)malloc((size_t)stream->bufferWords * 2 * sizeof(float));
+    allocFailed = ((pipe->words == NULL) || (pipe->values == NULL));
+
+    if (stream->direction == CMB_STREAM_TX)
+    {
+        for (i = 0; i < CMB_STREAM_TX_BUFFERS; i++)
+        {
+            pipe->staging[i] = (uint32_t *)malloc((size_t)stream->bufferWords * sizeof(uint32_t));
+            allocFailed |= (pipe->staging[i] == NULL);
+        }
+    }
+
+    stream->stop = 0;
+    stream->words = 0;
+    stream->bytes = 0;
+    stream->stalls = 0;
+
+    if (allocFailed)
+    {
+        error = COMMONERR_FAILED;
+    }
+    else
+    {
+        pthread_mutex_init(&pipe->lock, NULL);
+        pthread_cond_init(&pipe->cond, NULL);
+
+        /* the engine registers are those of this device */
+        CMB_bindContext(stream->spiSettings);
+        error = (stream->direction == CMB_STREAM_RX) ? CMB_streamRx(pipe) : CMB_streamTx(pipe);
+
+        pthread_cond_destroy(&pipe->cond);
+        pthread_mutex_destroy(&pipe->lock);
+    }
+
+    for (i = 0; i < CMB_STREAM_TX_BUFFERS; i++)
+    {
+        free(pipe->staging[i]);
+    }
+    free(pipe->values);
+    free(pipe->words);
+    free(pipe);
+
+    return(error);
+}
+
+commonErr_t CMB_streamStop(cmbStream_t *stream)
+{
+    if (stream == NULL)
+    {
+        return(COMMONERR_FAILED);
+    }
+
+    __atomic_store_n(&stream->stop, 1, __ATOMIC_RELAXED);
+    return(COMMONERR_OK);
+}
@@ -0,0 +1,79 @@
+/**
+ * \file common_stream.h
+ * \brief Contains type definitions and prototype declarations for common_stream.c,
+ *        continuous IQ streaming between the FPGA DDR and a file or socket
+ */
+
+#ifndef _COMMON_STREAM_H_
+#define _COMMON_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "common.h"
+
+/* playback buffers a CMB_STREAM_TX stream uses in the DDR window, one plays while the next is written */
+#define CMB_STREAM_TX_BUFFERS 2
+
+/*!< \brief Direction of a stream */
+typedef enum
+{
+    CMB_STREAM_RX = 0,                  /*!< capture engine to fd */
+    CMB_STREAM_TX                       /*!< fd to playback engine */
+} cmbStreamDirection_t;
+
+/*!< \brief Sample format on the file or socket */
+typedef enum
+{
+    CMB_STREAM_INT16 = 0,               /*!< interleaved int16 I, Q, the FPGA sample words as they are */
+    CMB_STREAM_FLOAT                    /*!< interleaved float I, Q (complex float) */
+} cmbStreamFormat_t;
+
+/**
+ * \brief Stream settings and counters for CMB_streamRun
+ *
+ * Two channels (Rx1/Rx2, Tx1/Tx2) share the FPGA buffers with their sample words alternating.
+ * With fd2 set they are split on Rx, channel 1 going to fd and channel 2 to fd2, and merged
+ * from fd and fd2 on Tx.
+ *
+ * Neither direction is gapless. The FPGA engines take one buffer at a time and are restarted
+ * in software once the previous buffer is done, so a few us of samples are lost (Rx, see
+ * cmbCaptureRing_t) or not sent (Tx) between two buffers. Larger buffers make the gaps rarer.
+ */
+typedef struct
+{
+    spiSettings_t *spiSettings;         ///< device whose capture / playback engine is used, see cmbCaptureRing_t
+    cmbStreamDirection_t direction;
+    cmbCaptureSource_t source;          ///< CMB_STREAM_RX stream to capture
+    int fd;                             ///< file or socket samples go to (Rx) or come from (Tx)
+    int fd2;                            ///< second channel, -1 = both channels interleaved on fd
+    cmbStreamFormat_t format;
+    float scale;                        ///< float = int16 * scale on Rx, int16 = float * scale on Tx, 0 = +-1.0 full scale
+    uint32_t ddrOffset;                 ///< byte offset of the stream's buffers in the DDR window, 16 byte aligned
+    uint32_t bufferWords;               ///< 32-bit sample words per buffer, a multiple of 8
+    uint32_t numBuffers;                ///< Rx capture ring depth, 2 to CMB_CAPTURE_MAX_BUFFERS (Tx uses CMB_STREAM_TX_BUFFERS)
+    uint64_t maxWords;                  ///< stop after this many sample words, 0 = until CMB_streamStop or the end of fd
+    uint32_t timeout_us;                ///< longest wait for one buffer of the FPGA engine
+
+    /* updated while the stream runs */
+    volatile uint8_t stop;              ///< set by CMB_streamStop
+    uint64_t words;                     ///< sample words moved
+    uint64_t bytes;                     ///< bytes moved on fd and fd2
+    uint32_t stalls;                    ///< times the FPGA engine had to wait for the file side
+} cmbStream_t;
+
+commonErr_t CMB_streamRun(cmbStream_t *stream);   /* blocks until maxWords, CMB_streamStop, end of fd or an error */
+commonErr_t CMB_streamStop(cmbStream_t *stream);  /* from any thread, CMB_streamRun returns after the buffer in flight */
+
+/* conversion kernels, vectorized, any alignment */
+void CMB_iqToFloat(const int16_t *in, float *out, uint32_t count, float scale);     /* count int16 values */
+void CMB_iqFromFloat(const float *in, int16_t *out, uint32_t count, float scale);   /* rounds to nearest and saturates */
+void CMB_iqDeinterleave(const uint32_t *in, uint32_t *out1, uint32_t *out2, uint32_t numWords); /* numWords / 2 words to each channel */
+void CMB_iqInterleave(const uint32_t *in1, const uint32_t *in2, uint32_t *out, uint32_t numWords);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -5,6 +5,7 @@
  *      Author: x300
  */
 #include "fpga.h"
+#include "fpga_sim.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,6 +14,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 
@@ -22,12 +24,76 @@
 #define HW_REGS_MASK    HW_REGS_LEN-1
 
 static	int           _fd = 0;
-static	void          *_virtual_base = NULL;
+static	volatile unsigned int *_virtual_base = NULL;	/* published once mapped, see fpga_regs() */
+static	fpgaBackend_t _backend = FPGA_BACKEND_AUTO;
+static	pthread_mutex_t _mapLock = PTHREAD_MUTEX_INITIALIZER;	/* first access may come from several threads */
+
+/* AXI register window and DDR window, mapped on first use and kept until fpga_close() */
+typedef struct
+{
+	const char    *dev;
+	unsigned int  size;
+	int           fd;
+	void          *base;
+} fpgaAxiMap_t;
+
+static	fpgaAxiMap_t  _axiReg = { FPGA_AXI_REG_DEV, FPGA_AXI_REG_SIZE, 0, NULL };
+static	fpgaAxiMap_t  _axiMem = { FPGA_AXI_MEM_DEV, FPGA_AXI_MEM_SIZE, 0, NULL };
+
+/* Orders the register accesses of a batch against the memory accesses around it: writes
+   after the data they publish (e.g. DDR buffers), reads before the data they announce */
+#if defined(__arm__) || defined(__aarch64__)
+#define FPGA_BARRIER()	__asm__ __volatile__("dmb sy" ::: "memory")
+#else
+#define FPGA_BARRIER()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/* 16 byte vector, NEON q register on the HPS, SSE on a PC build */
+typedef unsigned int fpgaVec_t __attribute__((vector_size(16)));
+
+/* Must be called before the first FPGA access, the backend can not change once in use */
+fpgaErr_t fpga_setBackend(fpgaBackend_t backend)
+{
+	if ((_virtual_base != NULL) && (backend != FPGA_BACKEND_HW))
+	{
+		return FPGA_FAILED;
+	}
+
+	_backend = backend;
+	return FPGA_OK;
+}
+
+fpgaBackend_t fpga_getBackend()
+{
+	const char *env = NULL;
+
+	if (_backend == FPGA_BACKEND_AUTO)
+	{
+		env = getenv("FPGA_BACKEND");
+		_backend = ((env != NULL) && (strcmp(env, "sim") == 0)) ? FPGA_BACKEND_SIM : FPGA_BACKEND_HW;
+	}
+
+	return _backend;
+}
+
+/* 1 when SPI_TX_DATA honours SPI_TX_CONTINUE, see FPGA_SPI_TX_CONTINUE */
+int fpga_hasTxContinue()
+{
+	return (fpga_getBackend() == FPGA_BACKEND_SIM) ? 1 : FPGA_SPI_TX_CONTINUE;
+}
 
 
 //=============================================
 fpgaErr_t fpga_init ()
 {
+  void *base = NULL;
+
+  if (fpga_getBackend() == FPGA_BACKEND_SIM)
+  {
+    fpga_simReset();
+    return FPGA_OK;
+  }
+
   _fd = open(DEV, O_RDWR|O_SYNC);
   if (_fd == -1)
   {
@@ -36,59 +102,370 @@ fpgaErr_t fpga_init ()
   }
 
   // Map the address space for the Lightweight bridge into user space so we can interact with them.
-  _virtual_base = mmap(NULL,                     /* addr */
-                      HW_REGS_LEN,              /* length */
-                      PROT_READ|PROT_WRITE,     /* prot */
-                      MAP_SHARED,               /* flags */
-                      _fd,                       /* fd */
-                      HW_REGS_BASE);            /* offset */
-
-  if (_virtual_base == MAP_FAILED)
+  base = mmap(NULL,                     /* addr */
+              HW_REGS_LEN,              /* length */
+              PROT_READ|PROT_WRITE,     /* prot */
+              MAP_SHARED,               /* flags */
+              _fd,                       /* fd */
+              HW_REGS_BASE);            /* offset */
+
+  if (base == MAP_FAILED)
   {
     printf("ERROR: mmap() failed...\n" );
     close(_fd);
 	_fd = 0;
-	_virtual_base = NULL;
     return FPGA_FAILED;
   }
 
+  /* other threads read _virtual_base without the lock */
+  __atomic_store_n(&_virtual_base, (volatile unsigned int *)base, __ATOMIC_RELEASE);
   return FPGA_OK;
 }
 
+/* Maps the registers on first use, only one of the threads racing here does the mapping */
+static fpgaErr_t fpga_map()
+{
+	fpgaErr_t ret = FPGA_OK;
+
+	pthread_mutex_lock(&_mapLock);
+	if (_virtual_base == NULL)
+	{
+		ret = fpga_init();
+	}
+	pthread_mutex_unlock(&_mapLock);
+
+	return ret;
+}
+
+static void fpga_axiUnmap(fpgaAxiMap_t *map)
+{
+	if (map->base != NULL)
+	{
+		munmap(map->base, map->size);
+		map->base = NULL;
+	}
+
+	if (map->fd > 0)
+	{
+		close(map->fd);
+		map->fd = 0;
+	}
+}
+
 void fpga_close()
 {
 	if (_fd != 0)
 	{
+		munmap((void *)_virtual_base, HW_REGS_LEN);
 		close(_fd);
 		_fd = 0;
 		_virtual_base = NULL;
 	}
+
+	pthread_mutex_lock(&_mapLock);
+	fpga_axiUnmap(&_axiReg);
+	fpga_axiUnmap(&_axiMem);
+	pthread_mutex_unlock(&_mapLock);
 }
 
-fpgaErr_t fpga_write(int offset, unsigned int data)
+/* Register window of the board backend, mapped on the first access. The backend and the
+   mapping are looked up once per batch, not once per register. */
+static volatile unsigned int *fpga_regs()
 {
-	if (_virtual_base == NULL)
-	{ 
-		if (fpga_init() != FPGA_OK)
+	volatile unsigned int *base = __atomic_load_n(&_virtual_base, __ATOMIC_ACQUIRE);
+
+	if ((base == NULL) && (fpga_map() == FPGA_OK))
+	{
+		base = __atomic_load_n(&_virtual_base, __ATOMIC_ACQUIRE);
+	}
+
+	return base;
+}
+
+/* Writes ops in array order, one barrier ahead of the batch */
+fpgaErr_t fpga_writev(const fpgaRegAccess_t *ops, unsigned int count)
+{
+	volatile unsigned int *base = NULL;
+	unsigned int i = 0;
+
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		for (i = 0; i < count; i++)
 		{
-			return FPGA_FAILED;
+			if (fpga_simWrite(ops[i].offset, ops[i].value) != FPGA_OK)
+			{
+				return FPGA_FAILED;
+			}
 		}
+		return FPGA_OK;
+	}
+
+	base = fpga_regs();
+	if (base == NULL)
+	{
+		return FPGA_FAILED;
+	}
+
+	FPGA_BARRIER();
+	for (i = 0; i < count; i++)
+	{
+		base[ops[i].offset / 4] = ops[i].value;
 	}
-	
-	*(unsigned int*)(_virtual_base + offset) = data;
 
 	return FPGA_OK;
 }
 
+/* Reads ops in array order, one barrier behind the batch */
+fpgaErr_t fpga_readv(fpgaRegAccess_t *ops, unsigned int count)
+{
+	volatile unsigned int *base = NULL;
+	unsigned int i = 0;
+
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (fpga_simRead(ops[i].offset, &ops[i].value) != FPGA_OK)
+			{
+				return FPGA_FAILED;
+			}
+		}
+		return FPGA_OK;
+	}
+
+	base = fpga_regs();
+	if (base == NULL)
+	{
+		return FPGA_FAILED;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		ops[i].value = base[ops[i].offset / 4];
+	}
+	FPGA_BARRIER();
+
+	return FPGA_OK;
+}
+
+fpgaErr_t fpga_write(int offset, unsigned int data)
+{
+	fpgaRegAccess_t op = { (unsigned int)offset, data };
+
+	return fpga_writev(&op, 1);
+}
+
 fpgaErr_t fpga_read(int offset, unsigned int *data)
 {
-	if (_virtual_base == NULL)
+	fpgaRegAccess_t op = { (unsigned int)offset, 0 };
+	fpgaErr_t ret = fpga_readv(&op, 1);
+
+	*data = op.value;
+	return ret;
+}
+
+//=============================================
+/* Maps UIO map 0 of map->dev once, later calls reuse it. Like fpga_regs(), the lock is only
+   taken while the map does not exist yet. */
+static fpgaErr_t fpga_axiMap(fpgaAxiMap_t *map)
+{
+	fpgaErr_t ret = FPGA_OK;
+	void *base = NULL;
+
+	if (__atomic_load_n(&map->base, __ATOMIC_ACQUIRE) != NULL)
+	{
+		return FPGA_OK;
+	}
+
+	pthread_mutex_lock(&_mapLock);
+	if (map->base == NULL)
 	{
-		if (fpga_init() != FPGA_OK)
+		map->fd = open(map->dev, O_RDWR | O_SYNC);
+		if (map->fd < 0)
 		{
-			return FPGA_FAILED;
+			printf("ERROR: could not open \"%s\" : %s\n", map->dev, strerror(errno));
+			map->fd = 0;
+			ret = FPGA_FAILED;
 		}
+		else
+		{
+			base = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+			if (base == MAP_FAILED)
+			{
+				printf("ERROR: mmap() of \"%s\" failed : %s\n", map->dev, strerror(errno));
+				close(map->fd);
+				map->fd = 0;
+				ret = FPGA_FAILED;
+			}
+			else
+			{
+				/* other threads read map->base without the lock */
+				__atomic_store_n(&map->base, base, __ATOMIC_RELEASE);
+			}
+		}
+	}
+	pthread_mutex_unlock(&_mapLock);
+
+	return ret;
+}
+
+/* Word copies between a buffer and the uncached DDR window. The device side is touched
+   only with aligned accesses, 4 vectors (64 bytes) per loop once it is 16 byte aligned. */
+static void fpga_axiCopyFrom(unsigned int *dst, const volatile unsigned int *src, unsigned int len)
+{
+	fpgaVec_t v0, v1, v2, v3;
+
+	for (; (len > 0) && ((uintptr_t)src & 15); len--)
+	{
+		*dst++ = *src++;
+	}
+
+	for (; len >= 16; len -= 16)
+	{
+		v0 = ((const volatile fpgaVec_t *)src)[0];
+		v1 = ((const volatile fpgaVec_t *)src)[1];
+		v2 = ((const volatile fpgaVec_t *)src)[2];
+		v3 = ((const volatile fpgaVec_t *)src)[3];
+		memcpy(dst, &v0, 16);
+		memcpy(dst + 4, &v1, 16);
+		memcpy(dst + 8, &v2, 16);
+		memcpy(dst + 12, &v3, 16);
+		src += 16;
+		dst += 16;
+	}
+
+	for (; len >= 4; len -= 4)
+	{
+		v0 = *(const volatile fpgaVec_t *)src;
+		memcpy(dst, &v0, 16);
+		src += 4;
+		dst += 4;
+	}
+
+	for (; len > 0; len--)
+	{
+		*dst++ = *src++;
+	}
+}
+
+static void fpga_axiCopyTo(volatile unsigned int *dst, const unsigned int *src, unsigned int len)
+{
+	fpgaVec_t v0, v1, v2, v3;
+
+	for (; (len > 0) && ((uintptr_t)dst & 15); len--)
+	{
+		*dst++ = *src++;
+	}
+
+	for (; len >= 16; len -= 16)
+	{
+		memcpy(&v0, src, 16);
+		memcpy(&v1, src + 4, 16);
+		memcpy(&v2, src + 8, 16);
+		memcpy(&v3, src + 12, 16);
+		((volatile fpgaVec_t *)dst)[0] = v0;
+		((volatile fpgaVec_t *)dst)[1] = v1;
+		((volatile fpgaVec_t *)dst)[2] = v2;
+		((volatile fpgaVec_t *)dst)[3] = v3;
+		src += 16;
+		dst += 16;
+	}
+
+	for (; len >= 4; len -= 4)
+	{
+		memcpy(&v0, src, 16);
+		*(volatile fpgaVec_t *)dst = v0;
+		src += 4;
+		dst += 4;
+	}
+
+	for (; len > 0; len--)
+	{
+		*dst++ = *src++;
+	}
+}
+
+fpgaErr_t fpga_axiRegRead(unsigned int offset, unsigned int *data)
+{
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		return fpga_simRead(offset, data);
 	}
-	*data = *(unsigned int*)(_virtual_base + offset);
+
+	if ((offset >= FPGA_AXI_REG_SIZE) || (offset & 3) || (fpga_axiMap(&_axiReg) != FPGA_OK))
+	{
+		return FPGA_FAILED;
+	}
+
+	*data = *(volatile unsigned int *)((char *)_axiReg.base + offset);
+	return FPGA_OK;
+}
+
+fpgaErr_t fpga_axiRegWrite(unsigned int offset, unsigned int data)
+{
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		return fpga_simWrite(offset, data);
+	}
+
+	if ((offset >= FPGA_AXI_REG_SIZE) || (offset & 3) || (fpga_axiMap(&_axiReg) != FPGA_OK))
+	{
+		return FPGA_FAILED;
+	}
+
+	*(volatile unsigned int *)((char *)_axiReg.base + offset) = data;
 	return FPGA_OK;
 }
+
+/* len 32-bit words from byte offset of the DDR window */
+fpgaErr_t fpga_axiMemRead(unsigned int offset, unsigned int *data, unsigned int len)
+{
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		return fpga_simMemRead(offset, data, len);
+	}
+
+	if ((offset & 3) || (len > (FPGA_AXI_MEM_SIZE - offset) / 4) || (offset >= FPGA_AXI_MEM_SIZE) ||
+		(fpga_axiMap(&_axiMem) != FPGA_OK))
+	{
+		return FPGA_FAILED;
+	}
+
+	fpga_axiCopyFrom(data, (const volatile unsigned int *)((char *)_axiMem.base + offset), len);
+	return FPGA_OK;
+}
+
+fpgaErr_t fpga_axiMemWrite(unsigned int offset, const unsigned int *data, unsigned int len)
+{
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		return fpga_simMemWrite(offset, data, len);
+	}
+
+	if ((offset & 3) || (offset >= FPGA_AXI_MEM_SIZE) || (len > (FPGA_AXI_MEM_SIZE - offset) / 4) ||
+		(fpga_axiMap(&_axiMem) != FPGA_OK))
+	{
+		return FPGA_FAILED;
+	}
+
+	fpga_axiCopyTo((volatile unsigned int *)((char *)_axiMem.base + offset), data, len);
+	return FPGA_OK;
+}
+
+/* Address of len 32-bit words at byte offset of the DDR window for direct (zero copy) access,
+   NULL when the range is outside the window or the window can not be mapped */
+void *fpga_axiMemPtr(unsigned int offset, unsigned int len)
+{
+	if (fpga_getBackend() == FPGA_BACKEND_SIM)
+	{
+		return fpga_simMemPtr(offset, len);
+	}
+
+	if ((offset & 3) || (offset >= FPGA_AXI_MEM_SIZE) || (len > (FPGA_AXI_MEM_SIZE - offset) / 4) ||
+		(fpga_axiMap(&_axiMem) != FPGA_OK))
+	{
+		return NULL;
+	}
+
+	return (char *)_axiMem.base + offset;
+}
@@ -13,18 +13,91 @@
 #define SPI_STATUS	0x48
 #define SPI_CHIP_SELECT	0x54
 
+/* AXI register window and FPGA DDR window, UIO map 0 of each device */
+#define FPGA_AXI_REG_DEV	"/dev/uio0"
+#define FPGA_AXI_REG_SIZE	0x1000
+#define FPGA_AXI_MEM_DEV	"/dev/uio1"
+#define FPGA_AXI_MEM_SIZE	0x40000000
+
+/* Rx/ORx capture engine of a device, in the AXI register window after the device's regBase.
+   Writing FPGA_CAPTURE_START to FPGA_CAPTURE_CTRL clears FPGA_CAPTURE_STATUS and stores the
+   next FPGA_CAPTURE_LEN sample words of the selected source at FPGA_CAPTURE_ADDR of the DDR window.
+   This is a new FPGA block: the registers 0x80 - 0x8C have to be added to the bitstream, the
+   existing designs do not have them. fpga_sim.c models it. */
+#define FPGA_CAPTURE_ADDR	0x80
+#define FPGA_CAPTURE_LEN	0x84
+#define FPGA_CAPTURE_CTRL	0x88
+#define FPGA_CAPTURE_STATUS	0x8C
+
+#define FPGA_CAPTURE_START		0x01		/* FPGA_CAPTURE_CTRL, source in bits 7:4 */
+#define FPGA_CAPTURE_SRC_SHIFT	4
+#define FPGA_CAPTURE_DONE		0x01		/* FPGA_CAPTURE_STATUS */
+#define FPGA_CAPTURE_ERROR		0x02		/* FPGA_CAPTURE_STATUS, buffer outside the DDR window or overflow */
+
+/* Tx playback engine of a device, next to the capture engine. Writing FPGA_PLAYBACK_START to
+   FPGA_PLAYBACK_CTRL clears FPGA_PLAYBACK_STATUS and sends the FPGA_PLAYBACK_LEN sample words
+   at FPGA_PLAYBACK_ADDR of the DDR window to the deframer once. The registers are not double
+   buffered, a new buffer can only be started after FPGA_PLAYBACK_DONE. Like the capture engine
+   this is a new FPGA block: 0xA0 - 0xAC have to be added to the bitstream, fpga_sim.c models it. */
+#define FPGA_PLAYBACK_ADDR		0xA0
+#define FPGA_PLAYBACK_LEN		0xA4
+#define FPGA_PLAYBACK_CTRL		0xA8
+#define FPGA_PLAYBACK_STATUS	0xAC
+
+#define FPGA_PLAYBACK_START		0x01		/* FPGA_PLAYBACK_CTRL */
+#define FPGA_PLAYBACK_DONE		0x01		/* FPGA_PLAYBACK_STATUS, the buffer may be written again */
+#define FPGA_PLAYBACK_ERROR		0x02		/* FPGA_PLAYBACK_STATUS, buffer outside the DDR window or underflow */
+
 #define RX_READY 0x80
 #define TX_READY 0x40
 
+/* SPI_TX_DATA flag: keep chip select asserted after this word, the next word continues
+   the same SPI transaction (used for AD9371 streaming mode).
+   This is an extension of the SPI core that the stock bitstream does not have: a core that
+   ignores the flag ends the transaction after each word, and the streamed data bytes are
+   then taken by the transceiver as instruction words. Build with FPGA_SPI_TX_CONTINUE=1 only
+   for a bitstream that implements it; the simulated backend always does, see fpga_hasTxContinue(). */
+#define SPI_TX_CONTINUE 0x01000000
+
+#ifndef FPGA_SPI_TX_CONTINUE
+#define FPGA_SPI_TX_CONTINUE 0
+#endif
+
 typedef enum
 {
 	FPGA_OK = 0,
 	FPGA_FAILED
 } fpgaErr_t;
 
+/* One register access of fpga_writev()/fpga_readv() */
+typedef struct
+{
+	unsigned int offset;
+	unsigned int value;		/* written, or filled in by fpga_readv() */
+} fpgaRegAccess_t;
+
+/* Where fpga_read()/fpga_write() go. FPGA_BACKEND_AUTO picks FPGA_BACKEND_SIM when the
+   FPGA_BACKEND environment variable is "sim", the board otherwise. */
+typedef enum
+{
+	FPGA_BACKEND_AUTO = 0,
+	FPGA_BACKEND_HW,		/* FPGA registers mapped from /dev/mem */
+	FPGA_BACKEND_SIM		/* software model of the SPI core and the transceiver, see fpga_sim.c */
+} fpgaBackend_t;
+
+fpgaErr_t fpga_setBackend(fpgaBackend_t backend);
+fpgaBackend_t fpga_getBackend();
+int fpga_hasTxContinue();
 fpgaErr_t fpga_init ();
 void fpga_close(); 
 fpgaErr_t fpga_write(int offset, unsigned int data);
 fpgaErr_t fpga_read(int offset, unsigned int *data);
+fpgaErr_t fpga_writev(const fpgaRegAccess_t *ops, unsigned int count);
+fpgaErr_t fpga_readv(fpgaRegAccess_t *ops, unsigned int count);
+fpgaErr_t fpga_axiRegRead(unsigned int offset, unsigned int *data);
+fpgaErr_t fpga_axiRegWrite(unsigned int offset, unsigned int data);
+fpgaErr_t fpga_axiMemRead(unsigned int offset, unsigned int *data, unsigned int len);
+fpgaErr_t fpga_axiMemWrite(unsigned int offset, const unsigned int *data, unsigned int len);
+void *fpga_axiMemPtr(unsigned int offset, unsigned int len);
 
 #endif /* FPGA_H_ */
@@ -0,0 +1,649 @@
+/*
+ * fpga_sim.c
+ *
+ * Simulated FPGA backend: models the SPI core registers (SPI_RX_DATA, SPI_TX_DATA,
+ * SPI_STATUS, SPI_CHIP_SELECT) and an AD9371 behind chip select 1, so the API can run
+ * without the board. FPGA_SIM_SPI_CORES cores are modelled, each with its own transceiver,
+ * so several devices can be brought up in parallel (see halContext_t.spiBase). The Mykonos register file starts from the mykonosMmap[] reset
+ * defaults, ARM memory is reachable through 0xD00 - 0xD07, and every calibration, PLL
+ * lock and ARM command completes as soon as it is polled. SPI words go through a
+ * FPGA_SIM_TX_FIFO_DEPTH deep TX FIFO that shifts out one word every FPGA_SIM_SPI_WORD_NS.
+ */
+#include "fpga_sim.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "mykonos_macros.h"
+
+/* register defaults, defined in mykonosMmap.c */
+extern uint8_t mykonosMmap[];
+
+#define SIM_REG_COUNT		0x1000
+#define SIM_FPGA_REG_COUNT	(0x1000 / 4)
+#define SIM_ARM_PROG_SIZE	(MYKONOS_ADDR_ARM_END_PROG_ADDR - MYKONOS_ADDR_ARM_START_PROG_ADDR + 1)
+#define SIM_ARM_DATA_SIZE	(MYKONOS_ADDR_ARM_END_DATA_ADDR - MYKONOS_ADDR_ARM_START_DATA_ADDR + 1)
+
+/* Status bits forced on every read of a register: set bits report a PLL as locked or a
+   charge pump cal as done, cleared bits report a self clearing calibration as finished */
+typedef struct
+{
+	unsigned short addr;
+	unsigned char set;
+	unsigned char clear;
+} simStatusReg_t;
+
+static const simStatusReg_t _statusRegs[] =
+{
+	{MYKONOS_ADDR_CALPLL_SDM_CONTROL,				0x80, 0x00},
+	{MYKONOS_ADDR_CLK_SYNTH_CAL_STAT,				0x20, 0x00},
+	{MYKONOS_ADDR_CLK_SYNTH_VCO_BAND_BYTE1,			0x01, 0x00},
+	{MYKONOS_ADDR_RXSYNTH_CP_CAL_STAT,				0x20, 0x00},
+	{MYKONOS_ADDR_RXSYNTH_VCO_BAND_BYTE1,			0x01, 0x00},
+	{MYKONOS_ADDR_TXSYNTH_CP_CAL_STAT,				0x20, 0x00},
+	{MYKONOS_ADDR_TXSYNTH_VCO_BAND_BYTE1,			0x01, 0x00},
+	{MYKONOS_ADDR_SNIFF_RXSYNTH_CP_CAL_STAT,			0x20, 0x00},
+	{MYKONOS_ADDR_SNIFF_RXSYNTH_VCO_BAND_BYTE1,		0x01, 0x00},
+	{MYKONOS_ADDR_CALIBRATION_CONTROL,				0x00, 0xA3},
+	{MYKONOS_ADDR_RX_ADC1_PRFL,						0x00, 0x20},
+	{MYKONOS_ADDR_RX_ADC2_PRFL,						0x00, 0x20},
+	{MYKONOS_ADDR_ORX_ADC_PRFL,						0x00, 0x20},
+	{MYKONOS_ADDR_ARM_CMD,							0x00, 0x80}, /* ARM never busy */
+	{MYKONOS_ADDR_MCS_STATUS,						0x0B, 0x00}, /* multichip sync done on the first SYSREF */
+};
+
+/* one SPI core and the transceiver behind it */
+typedef struct
+{
+	unsigned char  regs[SIM_REG_COUNT];
+	unsigned char  armProg[SIM_ARM_PROG_SIZE];
+	unsigned char  armData[SIM_ARM_DATA_SIZE];
+
+	unsigned int   rxFifo[FPGA_SIM_RX_FIFO_DEPTH];
+	unsigned int   rxHead;
+	unsigned int   rxCount;
+
+	/* words waiting to be shifted out, the first one since txStart_ns */
+	unsigned int   txFifo[FPGA_SIM_TX_FIFO_DEPTH];
+	unsigned int   txHead;
+	unsigned int   txCount;
+	unsigned long long txStart_ns;
+
+	/* streamed transaction state, see SPI_TX_CONTINUE */
+	int            streaming;
+	unsigned short streamAddr;
+
+	/* GP interrupt pin, signalled like a UIO device on irqFd[1], see fpga_simIrqFd() */
+	int            irqFd[2];
+	unsigned int   irqCount;
+	unsigned char  gpPin;
+
+	/* capture engine, samples delivered so far */
+	unsigned int   captureSample;
+} simCore_t;
+
+static unsigned int   _fpgaRegs[SIM_FPGA_REG_COUNT];
+static simCore_t      _cores[FPGA_SIM_SPI_CORES];
+static int            _initialized = 0;
+static unsigned int   _txOverflows = 0;	/* words written to a full SPI_TX_DATA FIFO */
+static unsigned int   *_ddr = NULL;		/* FPGA_SIM_DDR_SIZE bytes, allocated on first DDR access */
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;	/* one bus, accesses from all threads are serialized */
+
+static void fpga_simResetMykonos(simCore_t *core)
+{
+	memset(core->regs, 0, sizeof(core->regs));
+	memcpy(core->regs, mykonosMmap, MYKONOS_MMAP_SIZE);
+	core->regs[MYKONOS_ADDR_ARM_OPCODE_STATE_0] = MYKONOS_ARM_SYSTEMSTATE_READY;
+	core->regs[MYKONOS_ADDR_GP_INTERRUPT_READ_1] = 0x1F; /* all PLLs locked */
+	core->regs[MYKONOS_ADDR_GP_INTERRUPT_READ_0] = 0x00;
+	core->streaming = 0;
+	core->gpPin = 0;
+}
+
+static void fpga_simResetLocked()
+{
+	int i = 0;
+
+	memset(_fpgaRegs, 0, sizeof(_fpgaRegs));
+	_txOverflows = 0;
+	for (i = 0; i < FPGA_SIM_SPI_CORES; i++)
+	{
+		memset(_cores[i].armProg, 0, sizeof(_cores[i].armProg));
+		memset(_cores[i].armData, 0, sizeof(_cores[i].armData));
+		_fpgaRegs[(i * FPGA_SIM_SPI_CORE_STRIDE + SPI_CHIP_SELECT) / 4] = FPGA_SIM_MYKONOS_CS;
+		_cores[i].rxHead = 0;
+		_cores[i].rxCount = 0;
+		_cores[i].txHead = 0;
+		_cores[i].txCount = 0;
+		_cores[i].captureSample = 0;
+		fpga_simResetMykonos(&_cores[i]);
+	}
+	_initialized = 1;
+}
+
+void fpga_simReset()
+{
+	pthread_mutex_lock(&_lock);
+	fpga_simResetLocked();
+	pthread_mutex_unlock(&_lock);
+}
+
+/* byte of ARM memory selected by the ARM address registers and data register reg */
+static unsigned char *fpga_simArmByte(simCore_t *core, unsigned short reg)
+{
+	uint32_t offset = ((uint32_t)(core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_1] & 0x7F) << 10) |
+					  ((uint32_t)core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_0] << 2) |
+					  (reg - MYKONOS_ADDR_ARM_DATA_BYTE_0);
+
+	if (core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_1] & 0x80)
+	{
+		return (offset < SIM_ARM_DATA_SIZE) ? &core->armData[offset] : NULL;
+	}
+
+	/* the ARM checks its image as soon as it is asked, the calculated checksum is the build one */
+	if ((offset >= (MYKONOS_ADDR_ARM_CALC_CHKSUM_ADDR - MYKONOS_ADDR_ARM_START_PROG_ADDR)) &&
+		(offset < (MYKONOS_ADDR_ARM_CALC_CHKSUM_ADDR - MYKONOS_ADDR_ARM_START_PROG_ADDR + 4)))
+	{
+		offset -= (MYKONOS_ADDR_ARM_CALC_CHKSUM_ADDR - MYKONOS_ADDR_ARM_BUILD_CHKSUM_ADDR);
+	}
+
+	return (offset < SIM_ARM_PROG_SIZE) ? &core->armProg[offset] : NULL;
+}
+
+/* with ARM_CTL_1[2] set the ARM address moves to the next word after 0xD07 is accessed */
+static void fpga_simArmAutoIncrement(simCore_t *core, unsigned short reg)
+{
+	uint32_t word = 0;
+
+	if ((reg != MYKONOS_ADDR_ARM_DATA_BYTE_3) || !(core->regs[MYKONOS_ADDR_ARM_CTL_1] & 0x04))
+	{
+		return;
+	}
+
+	word = (((uint32_t)(core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_1] & 0x7F) << 8) | core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_0]) + 1;
+	core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_0] = (unsigned char)(word & 0xFF);
+	core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_1] = (core->regs[MYKONOS_ADDR_ARM_ADDR_BYTE_1] & 0x80) | (unsigned char)((word >> 8) & 0x7F);
+}
+
+/* GP interrupt pin: OR of the unmasked sources (PLL unlock, JESD, PA protection, ARM
+   watchdog) and the ARM error, which can not be masked. A rising edge is counted and sent
+   to the interrupt fd. */
+static void fpga_simUpdateGpInterrupt(simCore_t *core)
+{
+	unsigned int status = ((core->regs[MYKONOS_ADDR_GP_INTERRUPT_READ_1] & 0xE0) | (~core->regs[MYKONOS_ADDR_GP_INTERRUPT_READ_1] & 0x1F)) |
+						  ((unsigned int)(core->regs[MYKONOS_ADDR_GP_INTERRUPT_READ_0] & 0x03) << 8);
+	unsigned int mask = core->regs[MYKONOS_ADDR_GP_INTERRUPT_MASK_1] | ((unsigned int)(core->regs[MYKONOS_ADDR_GP_INTERRUPT_MASK_0] & 0x01) << 8);
+	unsigned char pin = ((status & ~mask) != 0) ? 1 : 0;
+	unsigned int enable = 0;
+
+	if (pin && !core->gpPin && (core->irqFd[0] > 0))
+	{
+		/* the reader unmasks with a write of 1, drop those */
+		while (read(core->irqFd[0], &enable, sizeof(enable)) > 0)
+		{
+		}
+
+		core->irqCount++;
+		if (write(core->irqFd[0], &core->irqCount, sizeof(core->irqCount)) != sizeof(core->irqCount))
+		{
+			core->irqCount--;
+		}
+	}
+
+	core->gpPin = pin;
+}
+
+static void fpga_simRegWrite(simCore_t *core, unsigned short addr, unsigned char data)
+{
+	unsigned char *p = NULL;
+
+	addr &= (SIM_REG_COUNT - 1);
+
+	if ((addr == MYKONOS_ADDR_CONFIGURATION_CONTROL_0) && (data & 0x81))
+	{
+		/* soft reset, self clearing */
+		fpga_simResetMykonos(core);
+		return;
+	}
+
+	if ((addr >= MYKONOS_ADDR_ARM_DATA_BYTE_0) && (addr <= MYKONOS_ADDR_ARM_DATA_BYTE_3))
+	{
+		p = fpga_simArmByte(core, addr);
+		if (p != NULL)
+		{
+			*p = data;
+		}
+		fpga_simArmAutoIncrement(core, addr);
+		return;
+	}
+
+	if (addr == MYKONOS_ADDR_ARM_CMD)
+	{
+		/* ARM system state: READY after boot, IDLE once init cals ran, RADIO_ON until aborted */
+		if (data == MYKONOS_ARM_RUNINIT_OPCODE)
+		{
+			core->regs[MYKONOS_ADDR_ARM_OPCODE_STATE_0] = MYKONOS_ARM_SYSTEMSTATE_IDLE;
+		}
+		else if (data == MYKONOS_ARM_RADIOON_OPCODE)
+		{
+			core->regs[MYKONOS_ADDR_ARM_OPCODE_STATE_0] = MYKONOS_ARM_SYSTEMSTATE_RADIO_ON;
+		}
+		else if ((data == MYKONOS_ARM_ABORT_OPCODE) && (core->regs[MYKONOS_ADDR_ARM_OPCODE_STATE_0] == MYKONOS_ARM_SYSTEMSTATE_RADIO_ON))
+		{
+			core->regs[MYKONOS_ADDR_ARM_OPCODE_STATE_0] = MYKONOS_ARM_SYSTEMSTATE_IDLE;
+		}
+	}
+
+	if ((addr >= MYKONOS_ADDR_ARM_CMD_STATUS_0) && (addr <= MYKONOS_ADDR_ARM_CMD_STATUS_7))
+	{
+		/* read only, ARM commands always complete without error */
+		return;
+	}
+
+	core->regs[addr] = data;
+
+	if ((addr >= MYKONOS_ADDR_GP_INTERRUPT_MASK_1) && (addr <= MYKONOS_ADDR_GP_INTERRUPT_READ_0))
+	{
+		fpga_simUpdateGpInterrupt(core);
+	}
+}
+
+static unsigned char fpga_simRegRead(simCore_t *core, unsigned short addr)
+{
+	unsigned char *p = NULL;
+	unsigned char data = 0;
+	unsigned int i = 0;
+
+	addr &= (SIM_REG_COUNT - 1);
+
+	if ((addr >= MYKONOS_ADDR_ARM_DATA_BYTE_0) && (addr <= MYKONOS_ADDR_ARM_DATA_BYTE_3))
+	{
+		p = fpga_simArmByte(core, addr);
+		data = (p != NULL) ? *p : 0;
+		fpga_simArmAutoIncrement(core, addr);
+		return data;
+	}
+
+	data = core->regs[addr];
+	for (i = 0; i < (sizeof(_statusRegs) / sizeof(_statusRegs[0])); i++)
+	{
+		if (_statusRegs[i].addr == addr)
+		{
+			data = (data | _statusRegs[i].set) & ~_statusRegs[i].clear;
+			core->regs[addr] = data;
+			break;
+		}
+	}
+
+	return data;
+}
+
+static void fpga_simRxPush(simCore_t *core, unsigned int word)
+{
+	if (core->rxCount < FPGA_SIM_RX_FIFO_DEPTH)
+	{
+		core->rxFifo[(core->rxHead + core->rxCount) % FPGA_SIM_RX_FIFO_DEPTH] = word;
+		core->rxCount++;
+	}
+}
+
+/* one 24-bit word written to SPI_TX_DATA: {R/W, addr[14:0], data[7:0]}, or three data
+   bytes when it continues a streamed transaction */
+static void fpga_simSpiWord(simCore_t *core, int base, unsigned int word)
+{
+	unsigned short addr = (unsigned short)((word >> 8) & 0x7FFF);
+	int step = (core->regs[MYKONOS_ADDR_CONFIGURATION_CONTROL_0] & 0x20) ? 1 : -1;
+	int i = 0;
+
+	if (_fpgaRegs[(base + SPI_CHIP_SELECT) / 4] != FPGA_SIM_MYKONOS_CS)
+	{
+		/* nothing else is modelled, reads return 0 */
+		if (word & 0x800000)
+		{
+			fpga_simRxPush(core, 0);
+		}
+		return;
+	}
+
+	if (core->streaming)
+	{
+		for (i = 2; i >= 0; i--)
+		{
+			fpga_simRegWrite(core, core->streamAddr, (unsigned char)(word >> (8 * i)));
+			core->streamAddr = (unsigned short)(core->streamAddr + step);
+		}
+	}
+	else if (word & 0x800000)
+	{
+		fpga_simRxPush(core, fpga_simRegRead(core, addr));
+	}
+	else
+	{
+		fpga_simRegWrite(core, addr, (unsigned char)(word & 0xFF));
+		core->streamAddr = (unsigned short)(addr + step);
+	}
+
+	core->streaming = (word & SPI_TX_CONTINUE) ? 1 : 0;
+}
+
+static fpgaErr_t fpga_simMemCheck(unsigned int offset, unsigned int len);
+
+/* Capture engine: the buffer is complete as soon as it is started. Samples are a ramp,
+   I = n in bits 15:0 and Q = -n in bits 31:16, continuing across captures so a consumer
+   can check for gaps. */
+static void fpga_simCapture(simCore_t *core, int base)
+{
+	unsigned int addr = _fpgaRegs[(base + FPGA_CAPTURE_ADDR) / 4];
+	unsigned int len = _fpgaRegs[(base + FPGA_CAPTURE_LEN) / 4];
+	unsigned int i = 0;
+	unsigned int n = 0;
+
+	if (fpga_simMemCheck(addr, len) != FPGA_OK)
+	{
+		_fpgaRegs[(base + FPGA_CAPTURE_STATUS) / 4] = FPGA_CAPTURE_ERROR;
+		return;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		n = core->captureSample++;
+		_ddr[addr / 4 + i] = (n & 0xFFFF) | ((0 - n) << 16);
+	}
+	_fpgaRegs[(base + FPGA_CAPTURE_STATUS) / 4] = FPGA_CAPTURE_DONE;
+}
+
+static unsigned long long fpga_simTime_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* shifts out the words of the TX FIFO whose time has come, their effect (register write,
+   RX data) shows only then */
+static void fpga_simTxDrain(simCore_t *core, int base)
+{
+	unsigned long long now = fpga_simTime_ns();
+
+	while (core->txCount && ((now - core->txStart_ns) >= FPGA_SIM_SPI_WORD_NS))
+	{
+		fpga_simSpiWord(core, base, core->txFifo[core->txHead]);
+		core->txHead = (core->txHead + 1) % FPGA_SIM_TX_FIFO_DEPTH;
+		core->txCount--;
+		core->txStart_ns += FPGA_SIM_SPI_WORD_NS;
+	}
+}
+
+static void fpga_simTxPush(simCore_t *core, unsigned int word)
+{
+	if (core->txCount == FPGA_SIM_TX_FIFO_DEPTH)
+	{
+		_txOverflows++;
+		return;
+	}
+
+	if (core->txCount == 0)
+	{
+		core->txStart_ns = fpga_simTime_ns();
+	}
+	core->txFifo[(core->txHead + core->txCount) % FPGA_SIM_TX_FIFO_DEPTH] = word;
+	core->txCount++;
+}
+
+/* SPI core an FPGA offset belongs to, NULL when it is not one of the modelled cores */
+static simCore_t *fpga_simCore(int offset)
+{
+	int index = offset / FPGA_SIM_SPI_CORE_STRIDE;
+
+	return (index < FPGA_SIM_SPI_CORES) ? &_cores[index] : NULL;
+}
+
+fpgaErr_t fpga_simWrite(int offset, unsigned int data)
+{
+	simCore_t *core = NULL;
+	int base = offset - (offset % FPGA_SIM_SPI_CORE_STRIDE);
+
+	if ((offset < 0) || (offset >= 0x1000) || (offset & 3))
+	{
+		return FPGA_FAILED;
+	}
+
+	pthread_mutex_lock(&_lock);
+	if (!_initialized)
+	{
+		fpga_simResetLocked();
+	}
+
+	core = fpga_simCore(offset);
+	if (core != NULL)
+	{
+		fpga_simTxDrain(core, base);
+	}
+
+	switch ((core != NULL) ? (offset - base) : -1)
+	{
+	case SPI_TX_DATA:
+		fpga_simTxPush(core, data);
+		break;
+
+	case FPGA_CAPTURE_CTRL:
+		_fpgaRegs[offset / 4] = data;
+		if (data & FPGA_CAPTURE_START)
+		{
+			fpga_simCapture(core, base);
+		}
+		break;
+
+	case FPGA_PLAYBACK_CTRL:
+		/* the buffer is sent as soon as it is started */
+		_fpgaRegs[offset / 4] = data;
+		if (data & FPGA_PLAYBACK_START)
+		{
+			_fpgaRegs[(base + FPGA_PLAYBACK_STATUS) / 4] =
+				(fpga_simMemCheck(_fpgaRegs[(base + FPGA_PLAYBACK_ADDR) / 4], _fpgaRegs[(base + FPGA_PLAYBACK_LEN) / 4]) == FPGA_OK) ?
+				FPGA_PLAYBACK_DONE : FPGA_PLAYBACK_ERROR;
+		}
+		break;
+
+	case FPGA_SIM_RESET_REG:
+		/* bit 0 drives the transceiver RESETB (active high in the register), asserting it resets the model */
+		if ((data & ~_fpgaRegs[offset / 4]) & 0x1)
+		{
+			fpga_simResetMykonos(core);
+		}
+		_fpgaRegs[offset / 4] = data;
+		break;
+
+	default:
+		_fpgaRegs[offset / 4] = data;
+		break;
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return FPGA_OK;
+}
+
+fpgaErr_t fpga_simRead(int offset, unsigned int *data)
+{
+	simCore_t *core = NULL;
+	int base = offset - (offset % FPGA_SIM_SPI_CORE_STRIDE);
+
+	if ((offset < 0) || (offset >= 0x1000) || (offset & 3))
+	{
+		return FPGA_FAILED;
+	}
+
+	pthread_mutex_lock(&_lock);
+	if (!_initialized)
+	{
+		fpga_simResetLocked();
+	}
+
+	core = fpga_simCore(offset);
+	if (core != NULL)
+	{
+		fpga_simTxDrain(core, base);
+	}
+
+	switch ((core != NULL) ? (offset - base) : -1)
+	{
+	case SPI_STATUS:
+		*data = (core->txCount ? 0 : TX_READY) | (core->rxCount ? RX_READY : 0);
+		break;
+
+	case SPI_RX_DATA:
+		*data = 0;
+		if (core->rxCount)
+		{
+			*data = core->rxFifo[core->rxHead];
+			core->rxHead = (core->rxHead + 1) % FPGA_SIM_RX_FIFO_DEPTH;
+			core->rxCount--;
+		}
+		break;
+
+	default:
+		*data = _fpgaRegs[offset / 4];
+		break;
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return FPGA_OK;
+}
+
+/* DDR window, len 32-bit words at byte offset; contents survive fpga_simReset() like the real memory */
+static fpgaErr_t fpga_simMemCheck(unsigned int offset, unsigned int len)
+{
+	if ((offset & 3) || (offset >= FPGA_SIM_DDR_SIZE) || (len > (FPGA_SIM_DDR_SIZE - offset) / 4))
+	{
+		return FPGA_FAILED;
+	}
+
+	if (_ddr == NULL)
+	{
+		_ddr = calloc(FPGA_SIM_DDR_SIZE / 4, sizeof(unsigned int));
+	}
+
+	return (_ddr != NULL) ? FPGA_OK : FPGA_FAILED;
+}
+
+fpgaErr_t fpga_simMemWrite(unsigned int offset, const unsigned int *data, unsigned int len)
+{
+	fpgaErr_t ret = FPGA_OK;
+
+	pthread_mutex_lock(&_lock);
+	ret = fpga_simMemCheck(offset, len);
+	if (ret == FPGA_OK)
+	{
+		memcpy(&_ddr[offset / 4], data, (size_t)len * 4);
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return ret;
+}
+
+fpgaErr_t fpga_simMemRead(unsigned int offset, unsigned int *data, unsigned int len)
+{
+	fpgaErr_t ret = FPGA_OK;
+
+	pthread_mutex_lock(&_lock);
+	ret = fpga_simMemCheck(offset, len);
+	if (ret == FPGA_OK)
+	{
+		memcpy(data, &_ddr[offset / 4], (size_t)len * 4);
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return ret;
+}
+
+void *fpga_simMemPtr(unsigned int offset, unsigned int len)
+{
+	void *ptr = NULL;
+
+	pthread_mutex_lock(&_lock);
+	if (fpga_simMemCheck(offset, len) == FPGA_OK)
+	{
+		ptr = &_ddr[offset / 4];
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return ptr;
+}
+
+/* direct access to the simulated register file of the transceiver on SPI core 0, e.g. to
+   inject a status or error bit */
+unsigned char fpga_simPeekReg(unsigned short addr)
+{
+	unsigned char data = 0;
+
+	pthread_mutex_lock(&_lock);
+	if (!_initialized)
+	{
+		fpga_simResetLocked();
+	}
+	fpga_simTxDrain(&_cores[0], 0);
+	data = _cores[0].regs[addr & (SIM_REG_COUNT - 1)];
+	pthread_mutex_unlock(&_lock);
+
+	return data;
+}
+
+void fpga_simPokeReg(unsigned short addr, unsigned char data)
+{
+	pthread_mutex_lock(&_lock);
+	if (!_initialized)
+	{
+		fpga_simResetLocked();
+	}
+	fpga_simTxDrain(&_cores[0], 0);
+	_cores[0].regs[addr & (SIM_REG_COUNT - 1)] = data;
+	fpga_simUpdateGpInterrupt(&_cores[0]);
+	pthread_mutex_unlock(&_lock);
+}
+
+/* Stand-in for the UIO device of the GP interrupt of SPI core's transceiver, for
+   HAL_setIrqFd(). Returns -1 when it can not be created. */
+int fpga_simIrqFd(int core)
+{
+	int fd = -1;
+
+	if ((core < 0) || (core >= FPGA_SIM_SPI_CORES))
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&_lock);
+	if (!_initialized)
+	{
+		fpga_simResetLocked();
+	}
+
+	if ((_cores[core].irqFd[0] > 0) ||
+		(socketpair(AF_UNIX, SOCK_STREAM, 0, _cores[core].irqFd) == 0))
+	{
+		fcntl(_cores[core].irqFd[0], F_SETFL, O_NONBLOCK);
+		fd = _cores[core].irqFd[1];
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return fd;
+}
+
+/* words the simulated SPI cores dropped because SPI_TX_DATA was written while the FIFO was full */
+unsigned int fpga_simTxOverflows()
+{
+	unsigned int count = 0;
+
+	pthread_mutex_lock(&_lock);
+	count = _txOverflows;
+	pthread_mutex_unlock(&_lock);
+
+	return count;
+}
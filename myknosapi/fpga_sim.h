@@ -0,0 +1,46 @@
+/*
+ * fpga_sim.h
+ *
+ * Software model of the FPGA SPI core with an AD9371 (Mykonos) on chip select 1,
+ * used by fpga.c when the simulated backend is selected.
+ */
+
+#ifndef FPGA_SIM_H_
+#define FPGA_SIM_H_
+
+#include "fpga.h"
+
+/* chip select (SPI_CHIP_SELECT value) the simulated Mykonos answers on */
+#define FPGA_SIM_MYKONOS_CS	1
+
+/* depth of the simulated SPI_RX_DATA FIFO */
+#define FPGA_SIM_RX_FIFO_DEPTH	64
+
+/* depth of the simulated SPI_TX_DATA FIFO (HAL_SPI_TX_FIFO_DEPTH of the board) and the time
+   one 24-bit word takes to shift out (25 MHz SPI clock). TX_READY is set once it is empty,
+   a word written to a full FIFO is dropped and counted, see fpga_simTxOverflows(). */
+#define FPGA_SIM_TX_FIFO_DEPTH	16
+#define FPGA_SIM_SPI_WORD_NS	960
+
+/* FPGA register that drives the device RESETB pins, see CMB_hardReset(); offset within an SPI core */
+#define FPGA_SIM_RESET_REG	0x10
+
+/* SPI cores modelled, core n (with its own transceiver) starts at FPGA offset n * FPGA_SIM_SPI_CORE_STRIDE */
+#define FPGA_SIM_SPI_CORES			4
+#define FPGA_SIM_SPI_CORE_STRIDE	0x100
+
+/* bytes of the FPGA DDR window modelled, from offset 0 (the board window is FPGA_AXI_MEM_SIZE) */
+#define FPGA_SIM_DDR_SIZE	0x01000000
+
+void fpga_simReset();
+fpgaErr_t fpga_simWrite(int offset, unsigned int data);
+fpgaErr_t fpga_simRead(int offset, unsigned int *data);
+fpgaErr_t fpga_simMemWrite(unsigned int offset, const unsigned int *data, unsigned int len);
+fpgaErr_t fpga_simMemRead(unsigned int offset, unsigned int *data, unsigned int len);
+void *fpga_simMemPtr(unsigned int offset, unsigned int len);
+unsigned char fpga_simPeekReg(unsigned short addr);
+void fpga_simPokeReg(unsigned short addr, unsigned char data);
+int fpga_simIrqFd(int core);
+unsigned int fpga_simTxOverflows();
+
+#endif /* FPGA_SIM_H_ */
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>  
@@ -6,13 +7,24 @@
 #include "assert.h"
 
 #include "HAL.h"
+#include "fpga.h"
 #include "common.h"
 #include "mykonos.h"
+#include "mykonos_armload.h"
+#include "common_spiqueue.h"
 
+mykonosErr_t mykBoot(mykonosDevice_t *device);
 void Test_HAL_SPI();
 void Test_HAL_Log();
 void Test_HAL_setTimeout_ms();
 void Test_HAL_setTimeout_us();
+void Test_CMB_SPIBatch();
+void Test_MYKONOS_initializeBatch();
+void Test_CMB_regShadow();
+void Test_CMB_SPIScript();
+void Test_CMB_spiQueue();
+void Test_CMB_SPIPriority();
+void Bench_MYKONOS();
 
 
 /**
@@ -529,6 +541,14 @@ static mykonosAuxIo_t mykonosAuxIo =
 	&armGpio
 };
 
+static cmbRegShadow_t mykRegShadow;
+static cmbSpiBatch_t mykSpiBatch;
+
+/* SPI init script of the last successful MYKONOS_initialize(), replayed on warm boots */
+#define MYK_INIT_SCRIPT_FILE "mykonos_init.spi"
+static uint8_t mykInitScriptBuf[0x10000];
+static cmbSpiScript_t mykInitScript = { mykInitScriptBuf, sizeof(mykInitScriptBuf), 0, 0, 0, 0 };
+
 static spiSettings_t mykSpiSettings =
 {
 	1, /* chip select index - valid 1~8 */
@@ -539,9 +559,15 @@ static spiSettings_t mykSpiSettings =
 	0, /* clock polarity 0 = clock starts low, 1 = clock starts high */
 	0, /* Not implemented in ADIs platform layer. SW feature to improve SPI throughput */
 	1, /* Not implemented in ADIs platform layer. For SPI Streaming, set address increment direction. 1= next addr = addr+1, 0:addr=addr-1 */
-	1  /* 1: Use 4-wire SPI, 0: 3-wire SPI (SDIO pin is bidirectional). NOTE: ADI's FPGA platform always uses 4-wire mode */
+	1, /* 1: Use 4-wire SPI, 0: 3-wire SPI (SDIO pin is bidirectional). NOTE: ADI's FPGA platform always uses 4-wire mode */
+	25000000, /* SPI clock frequency in Hz */
+	&mykRegShadow, /* register shadow, seeded by MYKONOS_resetDevice. NULL = always read registers from the device */
+	&mykSpiBatch, /* register write batch buffer. NULL = every register write is sent on its own */
+	NULL /* HAL context (SPI core, timeout, log file). NULL = shared default, give each device its own to init them from separate threads */
 };
 
+static mykonosPollPolicy_t mykPollPolicy;
+
 mykonosDevice_t mykDevice =
 {
 	&mykSpiSettings,    /* SPI settings data structure pointer */
@@ -550,7 +576,8 @@ mykonosDevice_t mykDevice =
 	&obsRxSettings,     /* ObsRx settings data structure pointer */
 	&mykonosAuxIo,      /* Auxiliary IO settings data structure pointer */
 	&mykonosClocks,     /* Holds settings for CLKPLL and reference clock */
-	0                   /* Mykonos initialize function uses this as an output to remember which profile data structure pointers are valid */
+	0,                  /* Mykonos initialize function uses this as an output to remember which profile data structure pointers are valid */
+	&mykPollPolicy      /* status poll pacing, learns the wait times of this device. NULL = poll back to back */
 };
 
 
@@ -586,28 +613,86 @@ int main(int argc, char *argv[])
 #ifdef TEST
 	HAL_openLogFile("test.log");
 
+	/* like the benchmarks, the tests run on the simulated backend unless FPGA_BACKEND is set */
+	if (getenv("FPGA_BACKEND") == NULL)
+	{
+		fpga_setBackend(FPGA_BACKEND_SIM);
+	}
+
 	Test_HAL_SPI();
 	//Test_HAL_Log();
 	Test_HAL_setTimeout_ms();
 	Test_HAL_setTimeout_us();
+	Test_CMB_SPIBatch();
+	Test_MYKONOS_initializeBatch();
+	Test_CMB_regShadow();
+	Test_CMB_SPIScript();
+	Test_CMB_spiQueue();
+	Test_CMB_SPIPriority();
+	HAL_closeLogFile();
+#elif defined(BENCH)
+	HAL_openLogFile("bench.log");
+	Bench_MYKONOS();
+	HAL_closeLogFile();
 #else
 	char *logfile = "first_run.log";
 	printf("Start normal run. Logfile name %s\n", logfile);
 	HAL_openLogFile(logfile);
+	HAL_setLogAsync(1);
 	
-	MYKONOS_initialize(&mykDevice);
+	mykBoot(&mykDevice);
 	HAL_closeLogFile();
 	printf("End normal run. Logfile name %s\n", logfile);
 #endif
 }
 
+/* 
+ * Brings up the transceiver by replaying the SPI script saved by an earlier boot.
+ * When there is no script or a checkpoint in it fails (PLL lock, ARM checksum)
+ * the device is reset and MYKONOS_initialize() runs in full while a new script
+ * is recorded. Delete MYK_INIT_SCRIPT_FILE whenever the device settings change.
+ */
+mykonosErr_t mykBoot(mykonosDevice_t *device)
+{
+	mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+	if (CMB_SPIScriptLoad(&mykInitScript, MYK_INIT_SCRIPT_FILE) == COMMONERR_OK)
+	{
+		MYKONOS_resetDevice(device);
+		if (CMB_SPIScriptReplay(device->spiSettings, &mykInitScript) == COMMONERR_OK)
+		{
+			/* profile verification did not run, restore its result */
+			device->profilesValid = (uint8_t)mykInitScript.userData;
+			printf("Warm boot from %s\n", MYK_INIT_SCRIPT_FILE);
+			return MYKONOS_ERR_OK;
+		}
+		printf("%s is stale, running full init\n", MYK_INIT_SCRIPT_FILE);
+		MYKONOS_resetDevice(device);
+	}
+
+	CMB_SPIScriptRecord(device->spiSettings, &mykInitScript);
+	retVal = MYKONOS_initialize(device);
+	CMB_SPIScriptRecord(device->spiSettings, NULL);
+
+	if (retVal == MYKONOS_ERR_OK)
+	{
+		mykInitScript.userData = device->profilesValid;
+		if (CMB_SPIScriptSave(&mykInitScript, MYK_INIT_SCRIPT_FILE) != COMMONERR_OK)
+		{
+			printf("Could not save %s\n", MYK_INIT_SCRIPT_FILE);
+		}
+	}
+
+	return retVal;
+}
+
 void Test_HAL_SPI()
 {
 	printf("Test_HAL_SPI - ");
 	HAL_initSpi(SPI_TRAMSIVER, 0, 0);
 
 	spi_write(0xAA, 0xAB);
-	char s = spi_read(0xAA);
+	unsigned char s = spi_read(0xAA);
 	assert(0xAB == s && " Failed\n");
 	printf("Pass\n");
 }
@@ -648,3 +733,306 @@ void Test_HAL_setTimeout_us()
 	printf("Pass\n");
 }
 
+/* Test_CMB_* and Test_MYKONOS_* use scratch registers 0xA0 - 0xA7 of the transceiver */
+
+void Test_CMB_SPIBatch()
+{
+	static cmbSpiBatch_t batch;
+	spiSettings_t spi = mykSpiSettings;
+	uint8_t data = 0;
+
+	printf("Test_CMB_SPIBatch - ");
+	memset(&batch, 0, sizeof(batch));
+	spi.regShadow = NULL;
+	spi.spiBatch = &batch;
+
+	CMB_SPIBatchBegin(&spi);
+	CMB_SPIWriteByte(&spi, 0xA0, 0x11);
+	CMB_SPIBatchBegin(&spi);
+	CMB_SPIWriteByte(&spi, 0xA1, 0x22);
+	CMB_SPIBatchCommit(&spi);
+
+	/* the inner commit leaves the writes to the outer one */
+	assert((batch.count == 2) && (batch.flushes == 0) && "Failed\n");
+	CMB_SPIBatchCommit(&spi);
+	assert((batch.count == 0) && (batch.flushes == 1) && (batch.writes == 2) && "Failed\n");
+
+	CMB_SPIReadByte(&spi, 0xA0, &data);
+	assert((data == 0x11) && "Failed\n");
+	CMB_SPIReadByte(&spi, 0xA1, &data);
+	assert((data == 0x22) && "Failed\n");
+	printf("Pass\n");
+}
+
+/* MYKONOS_setupRxAgc and the other batched setups run inside the batch of MYKONOS_initialize,
+   only the writes of MYKONOS_setSpiSettings go out before it is opened */
+void Test_MYKONOS_initializeBatch()
+{
+	static cmbDevStats_t stats;
+	mykonosErr_t retVal = MYKONOS_ERR_OK;
+	uint64_t settingsWrites = 0;
+	uint64_t unbatchedWrites = 0;
+	uint32_t batchWrites = 0;
+
+	printf("Test_MYKONOS_initializeBatch - ");
+#if (CMB_ENABLE_DEVSTATS == 1)
+	mykSpiSettings.devStats = &stats;
+	retVal = MYKONOS_resetDevice(&mykDevice);
+	assert((retVal == MYKONOS_ERR_OK) && "Failed\n");
+
+	CMB_resetDeviceStats(&mykSpiSettings);
+	retVal = MYKONOS_setSpiSettings(&mykDevice);
+	assert((retVal == MYKONOS_ERR_OK) && "Failed\n");
+	settingsWrites = stats.op[CMB_STATOP_WRITEBYTE].calls;
+
+	CMB_resetDeviceStats(&mykSpiSettings);
+	batchWrites = mykSpiBatch.writes;
+	retVal = MYKONOS_initialize(&mykDevice);
+	assert((retVal == MYKONOS_ERR_OK) && "Failed\n");
+
+	unbatchedWrites = stats.op[CMB_STATOP_WRITEBYTE].calls - (mykSpiBatch.writes - batchWrites);
+	mykSpiSettings.devStats = NULL;
+	assert((unbatchedWrites == settingsWrites) && "Failed\n");
+	printf("Pass\n");
+#else
+	(void)stats;
+	(void)retVal;
+	(void)settingsWrites;
+	(void)unbatchedWrites;
+	(void)batchWrites;
+	printf("Skipped, needs CMB_ENABLE_DEVSTATS\n");
+#endif
+}
+
+/* a second spiSettings_t without shadow changes the register behind the shadow's back */
+void Test_CMB_regShadow()
+{
+	static cmbRegShadow_t shadow;
+	spiSettings_t spi = mykSpiSettings;
+	spiSettings_t direct = mykSpiSettings;
+	uint8_t data = 0;
+
+	printf("Test_CMB_regShadow - ");
+	memset(&shadow, 0, sizeof(shadow));
+	spi.regShadow = &shadow;
+	spi.spiBatch = NULL;
+	direct.regShadow = NULL;
+	direct.spiBatch = NULL;
+
+	/* a written register is served from the shadow */
+	CMB_SPIWriteByte(&spi, 0xA2, 0x50);
+	CMB_SPIWriteByte(&direct, 0xA2, 0x00);
+	CMB_SPIWriteField(&spi, 0xA2, 0x1, 0x01, 0);
+	CMB_SPIReadByte(&direct, 0xA2, &data);
+	assert((data == 0x51) && (shadow.hits == 1) && (shadow.misses == 0) && "Failed\n");
+
+	/* a volatile one is read from the device */
+	CMB_regShadowSetVolatile(&spi, 0xA2, 0xA2);
+	CMB_SPIWriteByte(&direct, 0xA2, 0x00);
+	CMB_SPIWriteField(&spi, 0xA2, 0x1, 0x02, 1);
+	CMB_SPIReadByte(&direct, 0xA2, &data);
+	assert((data == 0x02) && (shadow.hits == 1) && (shadow.misses == 1) && "Failed\n");
+	printf("Pass\n");
+}
+
+void Test_CMB_SPIScript()
+{
+	static uint8_t buf[256];
+	cmbSpiScript_t script = { buf, sizeof(buf), 0, 0, 0, 0 };
+	spiSettings_t spi = mykSpiSettings;
+	uint8_t data = 0;
+
+	printf("Test_CMB_SPIScript - ");
+	spi.regShadow = NULL;
+	spi.spiBatch = NULL;
+
+	CMB_SPIWriteByte(&spi, 0xA4, 0x44);
+	CMB_SPIScriptRecord(&spi, &script);
+	CMB_SPIWriteByte(&spi, 0xA3, 0x33);
+	CMB_SPIReadByte(&spi, 0xA4, &data);
+	CMB_SPIScriptCheckpoint(&spi, 0xA4, 0xFF, data);
+	CMB_SPIScriptRecord(&spi, NULL);
+	assert((script.len > 0) && !script.overflow && "Failed\n");
+
+	CMB_SPIWriteByte(&spi, 0xA3, 0x00);
+	assert((CMB_SPIScriptReplay(&spi, &script) == COMMONERR_OK) && "Failed\n");
+	CMB_SPIReadByte(&spi, 0xA3, &data);
+	assert((data == 0x33) && "Failed\n");
+
+	/* the checkpoint no longer holds, replay polls it until CMB_SPISCRIPT_POLL_TIMEOUT_MS */
+	CMB_SPIWriteByte(&spi, 0xA4, 0x45);
+	assert((CMB_SPIScriptReplay(&spi, &script) == COMMONERR_FAILED) && "Failed\n");
+	printf("Pass\n");
+}
+
+void Test_CMB_spiQueue()
+{
+	cmbSpiQueue_t *queue = NULL;
+	cmbSpiRequest_t req[3];
+	cmbSpiQueueStats_t stats;
+	spiSettings_t spi = mykSpiSettings;
+	uint16_t addr[2] = { 0xA5, 0xA6 };
+	uint8_t data[2] = { 0x55, 0x66 };
+	uint8_t readData = 0;
+	int i = 0;
+
+	printf("Test_CMB_spiQueue - ");
+	spi.regShadow = NULL;
+	spi.spiBatch = NULL;
+	memset(req, 0, sizeof(req));
+	assert((CMB_spiQueueCreate(&queue, 16) == COMMONERR_OK) && "Failed\n");
+
+	/* the device belongs to the queue until it is destroyed */
+	CMB_spiQueueWriteBytes(queue, &req[0], &spi, addr, data, 2);
+	CMB_spiQueueWriteByte(queue, &req[1], &spi, 0xA5, 0x57);
+	CMB_spiQueueReadByte(queue, &req[2], &spi, 0xA5, &readData);
+	for (i = 0; i < 3; i++)
+	{
+		assert((CMB_spiRequestWait(queue, &req[i], 1000000) == COMMONERR_OK) && "Failed\n");
+	}
+	CMB_spiQueueGetStats(queue, &stats);
+	CMB_spiQueueDestroy(queue);
+
+	assert((readData == 0x57) && (stats.requests == 3) && "Failed\n");
+	CMB_SPIReadByte(&spi, 0xA6, &readData);
+	assert((readData == 0x66) && "Failed\n");
+	printf("Pass\n");
+}
+
+void Test_CMB_SPIPriority()
+{
+	spiSettings_t spi = mykSpiSettings;
+	halSpiStats_t stats;
+	uint8_t data = 0;
+
+	printf("Test_CMB_SPIPriority - ");
+	spi.regShadow = NULL;
+	spi.spiBatch = NULL;
+
+	CMB_SPIWriteByte(&spi, 0xA7, 0x00);
+	HAL_resetSpiStats();
+	CMB_setSPIPriority(1);
+	CMB_SPIWriteByte(&spi, 0xA7, 0x77);
+	CMB_setSPIPriority(0);
+	HAL_getSpiStats(&stats);
+	CMB_SPIReadByte(&spi, 0xA7, &data);
+	assert((data == 0x77) && (stats.prioWrites == 1) && "Failed\n");
+	printf("Pass\n");
+}
+
+/************************************************ Benchmarks ***************************************************/
+/* 
+ * Each Bench_* run resets the CMB, HAL and register shadow counters, calls one API
+ * and appends one CSV line to BENCH_RESULTS_FILE (also echoed to stdout). Without
+ * FPGA_BACKEND set the simulated backend is used, so the counts are repeatable on
+ * any Linux box; FPGA_BACKEND=hw measures the board.
+ */
+#define BENCH_RESULTS_FILE "bench.csv"
+#define BENCH_ARM_BINARY_SIZE 98304
+#define BENCH_RX_GAIN_INDEXES 128
+
+static FILE *pBenchFile = NULL;
+static struct timespec _benchStart;
+static uint8_t benchArmBinary[BENCH_ARM_BINARY_SIZE];
+static mykonosArmImage_t benchArmImage;
+static uint8_t benchRxGainTable[BENCH_RX_GAIN_INDEXES * 4];
+
+static void Bench_begin()
+{
+	CMB_resetStats();
+	HAL_resetSpiStats();
+	mykRegShadow.hits = 0;
+	mykRegShadow.misses = 0;
+	clock_gettime(CLOCK_MONOTONIC, &_benchStart);
+}
+
+static void Bench_end(const char *name, mykonosErr_t retVal)
+{
+	struct timespec t;
+	cmbStats_t cmb;
+	halSpiStats_t hal;
+	unsigned long long elapsed_us;
+	char line[256];
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	CMB_SPIBatchFlush();
+	CMB_getStats(&cmb);
+	HAL_getSpiStats(&hal);
+	elapsed_us = ((unsigned long long)(t.tv_sec - _benchStart.tv_sec) * 1000000000ULL + t.tv_nsec - _benchStart.tv_nsec) / 1000;
+
+	snprintf(line, sizeof(line), "%s,%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+		name, retVal, elapsed_us,
+		(unsigned long long)cmb.spiWrites, (unsigned long long)cmb.spiReads,
+		(unsigned long long)cmb.fieldWrites, (unsigned long long)mykRegShadow.misses,
+		(unsigned long long)cmb.timeoutChecks, (unsigned long long)cmb.waits, (unsigned long long)cmb.waitTime_us,
+		hal.words, hal.statusPolls);
+
+	printf("%s", line);
+	if (pBenchFile != NULL)
+	{
+		fputs(line, pBenchFile);
+	}
+}
+
+void Bench_MYKONOS()
+{
+	const char *header = "api,status,elapsed_us,writes,reads,field_rmw,field_readbacks,polls,sleeps,sleep_us,spi_words,fifo_polls\n";
+	mykonosErr_t retVal = MYKONOS_ERR_OK;
+	int i;
+
+	if (getenv("FPGA_BACKEND") == NULL)
+	{
+		fpga_setBackend(FPGA_BACKEND_SIM);
+	}
+
+	for (i = 0; i < BENCH_RX_GAIN_INDEXES; i++)
+	{
+		benchRxGainTable[i * 4] = (uint8_t)(i & 0x1F);
+	}
+
+	pBenchFile = fopen(BENCH_RESULTS_FILE, "wt");
+	printf("%s", header);
+	if (pBenchFile != NULL)
+	{
+		fputs(header, pBenchFile);
+	}
+
+	Bench_begin();
+	retVal = MYKONOS_resetDevice(&mykDevice);
+	Bench_end("MYKONOS_resetDevice", retVal);
+
+	Bench_begin();
+	retVal = MYKONOS_initialize(&mykDevice);
+	Bench_end("MYKONOS_initialize", retVal);
+
+	Bench_begin();
+	retVal = MYKONOS_programFir(&mykDevice, TX1TX2_FIR, &txFir);
+	Bench_end("MYKONOS_programFir", retVal);
+
+	Bench_begin();
+	retVal = MYKONOS_programRxGainTable(&mykDevice, benchRxGainTable, BENCH_RX_GAIN_INDEXES, RX1_RX2_GT);
+	Bench_end("MYKONOS_programRxGainTable", retVal);
+
+	Bench_begin();
+	retVal = MYKONOS_setRfPllFrequency(&mykDevice, RX_PLL, 2500000000ULL);
+	Bench_end("MYKONOS_setRfPllFrequency", retVal);
+
+	Bench_begin();
+	retVal = MYKONOS_loadArmConcurrent(&mykDevice, benchArmBinary, BENCH_ARM_BINARY_SIZE);
+	Bench_end("MYKONOS_loadArmConcurrent", retVal);
+
+	/* the same load from a stream encoded once, outside the measured time */
+	if (MYKONOS_armImageFromBinary(&mykDevice, &benchArmImage, benchArmBinary, BENCH_ARM_BINARY_SIZE) == MYKONOS_ERR_OK)
+	{
+		Bench_begin();
+		retVal = MYKONOS_loadArmImage(&mykDevice, &benchArmImage);
+		Bench_end("MYKONOS_loadArmImage", retVal);
+		MYKONOS_armImageClose(&benchArmImage);
+	}
+
+	if (pBenchFile != NULL)
+	{
+		fclose(pBenchFile);
+		pBenchFile = NULL;
+	}
+}
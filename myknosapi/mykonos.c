@@ -45,6 +45,99 @@ static mykonosErr_t MYKONOS_calculateScaledDeviceClk_kHz(mykonosDevice_t *device
 static mykonosErr_t MYKONOS_calculateDigitalClocks(mykonosDevice_t *device, uint32_t *hsDigClk_kHz, uint32_t *hsDigClkDiv4or5_kHz);
 static mykonosErr_t enableDpdTracking(mykonosDevice_t *device, uint8_t tx1Enable, uint8_t tx2Enable);
 static mykonosErr_t enableClgcTracking(mykonosDevice_t *device, uint8_t tx1Enable, uint8_t tx2Enable);
+static void mykInitRegShadow(mykonosDevice_t *device, uint8_t seedDefaults);
+
+/* register reset defaults, defined in mykonosMmap.c */
+extern uint8_t mykonosMmap[];
+
+/* Register ranges never served from the register shadow: status, strobes, counters and
+ * readbacks the device updates itself, self clearing controls, and the ARM mailbox block */
+static const uint16_t mykonosVolatileRegs[][2] =
+{
+    {MYKONOS_ADDR_CONFIGURATION_CONTROL_0, MYKONOS_ADDR_CONFIGURATION_CONTROL_0},
+    {MYKONOS_ADDR_FRAMER_RESET, MYKONOS_ADDR_FRAMER_RESET},
+    {MYKONOS_ADDR_FRAMER_TEST_CNTR_CTL, MYKONOS_ADDR_FRAMER_LANE3_FIFO_RDWR_ADDR},
+    {MYKONOS_ADDR_DEFRAMER_RESET, MYKONOS_ADDR_DEFRAMER_RESET},
+    {MYKONOS_ADDR_DEFRAMER_STAT_STRB, MYKONOS_ADDR_DEFRAMER_SYSREF_TO_LMFC_ERR_MARGIN},
+    {MYKONOS_ADDR_DEFRAMER_PRBS20_STRB_CHKSUM_TYPE, MYKONOS_ADDR_DEFRAMER_STATUS_2},
+    {MYKONOS_ADDR_DESERIALIZER_CDR_CAL_CTL, MYKONOS_ADDR_DESERIALIZER_CDR_CAL_CTL},
+    {MYKONOS_ADDR_MCS_STATUS, MYKONOS_ADDR_MCS_STATUS},
+    {MYKONOS_ADDR_CLK_SYNTH_CAL_STAT, MYKONOS_ADDR_CLK_SYNTH_CAL_CONTROL},
+    {MYKONOS_ADDR_CALPLL_SDM_CONTROL, MYKONOS_ADDR_CALPLL_SDM_CONTROL},
+    {MYKONOS_ADDR_ENSM_CONFIG_7_0, MYKONOS_ADDR_CALIBRATION_CONTROL},
+    {MYKONOS_ADDR_RCAL_CONTROL, MYKONOS_ADDR_RCAL_CONTROL},
+    {MYKONOS_ADDR_RXSYNTH_CP_CAL_STAT, MYKONOS_ADDR_RXSYNTH_VCO_BAND_BYTE1},
+    {MYKONOS_ADDR_TXSYNTH_CP_CAL_STAT, MYKONOS_ADDR_TXSYNTH_VCO_BAND_BYTE1},
+    {MYKONOS_ADDR_SNIFF_RXSYNTH_CP_CAL_STAT, MYKONOS_ADDR_SNIFF_RXSYNTH_VCO_BAND_BYTE1},
+    {MYKONOS_ADDR_GAIN_CTL_CHANNEL_1, MYKONOS_ADDR_RX_OVRG_ORX_SNRX_DATAPATH_OVRFLW},
+    {MYKONOS_ADDR_RFDC_MEASURE_COUNT_1, MYKONOS_ADDR_RFDC_ORX_MEASURE_COUNT_2},
+    {MYKONOS_ADDR_TX1_ATTENUATION_0_READBACK, MYKONOS_ADDR_TX2_ATTENUATION_1_READBACK},
+    {MYKONOS_ADDR_PA_PROTECTION_POWER_READBACK_LSB, MYKONOS_ADDR_PA_PROTECTION_POWER_READBACK_MSB},
+    {MYKONOS_ADDR_TX_ABBF_FREQ_CAL_NCO_I_MSB, MYKONOS_ADDR_TX_ABBF_FREQ_CAL_NCO_Q_LSB},
+    {MYKONOS_ADDR_GPIO_3V3_SPI_READ_7_0, MYKONOS_ADDR_GPIO_3V3_SPI_READ_15_8},
+    {MYKONOS_ADDR_GPIO_SPI_READ_7_0, MYKONOS_ADDR_GPIO_SPI_READ_18_16},
+    {MYKONOS_ADDR_GP_INTERRUPT_READ_1, MYKONOS_ADDR_GP_INTERRUPT_READ_0},
+    {MYKONOS_ADDR_AUX_ADC_READ_MSB, MYKONOS_ADDR_AUX_ADC_READ_LSB},
+    {MYKONOS_ADDR_TEMP_SENSOR_READ, MYKONOS_ADDR_TEMP_SENSOR_READ},
+    {MYKONOS_ADDR_ARM_CTL_1, MYKONOS_ADDR_PFIR_COEFF_ADDR}
+};
+
+/**
+ * \brief Restarts the optional register shadow in device->spiSettings->regShadow
+ *
+ * Clears all cached values and flags the registers in mykonosVolatileRegs[] volatile.
+ * With seedDefaults set (right after a hard reset) the remaining registers are loaded
+ * with the mykonosMmap[] reset defaults, otherwise they are learned as they are written or read.
+ *
+ * \pre This function is private and is not called directly by the user.
+ *
+ * \param device Structure pointer to Mykonos device data structure
+ * \param seedDefaults 1 = device registers are at their reset defaults
+ */
+static void mykInitRegShadow(mykonosDevice_t *device, uint8_t seedDefaults)
+{
+    uint32_t i = 0;
+
+    if (device->spiSettings->regShadow == NULL)
+    {
+        return;
+    }
+
+    CMB_regShadowSuspend(device->spiSettings, 0);
+    CMB_regShadowInvalidate(device->spiSettings);
+    for (i = 0; i < (sizeof(mykonosVolatileRegs) / sizeof(mykonosVolatileRegs[0])); i++)
+    {
+        CMB_regShadowSetVolatile(device->spiSettings, mykonosVolatileRegs[i][0], mykonosVolatileRegs[i][1]);
+    }
+
+    if (seedDefaults)
+    {
+        CMB_regShadowSeed(device->spiSettings, &mykonosMmap[0], MYKONOS_MMAP_SIZE);
+    }
+}
+
+/**
+ * \brief Ends the SPI write batch opened around a setup function
+ *
+ * \pre This function is private and is not called directly by the user.
+ *
+ * \param device Structure pointer to Mykonos device data structure
+ * \param retVal Result of the batched setup function
+ *
+ * \retval MYKONOS_ERR_SPIBATCH_COMMIT_FAILED the setup passed but its queued writes did not reach the device
+ * \retval retVal otherwise
+ */
+static mykonosErr_t mykCommitBatch(mykonosDevice_t *device, mykonosErr_t retVal)
+{
+    if ((CMB_SPIBatchCommit(device->spiSettings) != COMMONERR_OK) && (retVal == MYKONOS_ERR_OK))
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_SPIBATCH_COMMIT_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_SPIBATCH_COMMIT_FAILED));
+        return MYKONOS_ERR_SPIBATCH_COMMIT_FAILED;
+    }
+
+    return retVal;
+}
 
 /**
  * \brief Verifies the Tx profile members are valid (in range) in the init structure
@@ -252,8 +345,13 @@ mykonosErr_t MYKONOS_resetDevice(mykonosDevice_t *device)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_resetDevice()\n");
 #endif
 
-    /* toggle RESETB on device with matching spi chip select index */
+    /* toggle RESETB on device with matching spi chip select index, through this device's FPGA registers */
+    CMB_bindContext(device->spiSettings);
     CMB_hardReset(device->spiSettings->chipSelectIndex);
+
+    /* the device is back at its reset defaults, restart the register shadow from them */
+    mykInitRegShadow(device, 1);
+
     return MYKONOS_ERR_OK;
 }
 
@@ -581,23 +679,15 @@ mykonosErr_t MYKONOS_verifyDeviceDataStructure(mykonosDevice_t *device)
 }
 
 /**
- * \brief Initializes the Mykonos device based on the desired device settings.
- *
- * This function initializes the mykonos device, setting up the CLKPLL, digital clocks,
- * JESD204b settings, FIR Filters, digital filtering.  It does not load the ARM
- * or perform any of the ARM init calibrations. It also sets the Rx Manual gain indexes and
- * TxAttenuation settings to the initial values found in the device data structure.  It leaves the
- * Mykonos in a state ready for multichip sync (which can bring up the JESD204 links), the
- * ARM to be loaded, and the init calibartions run.
+ * \brief Register setup of MYKONOS_initialize(), run while the SPI write batch is open
  *
- * <B>Dependencies</B>
- * - device (all variables)
+ * \pre This function is private and is not called directly by the user.
  *
  * \param device Pointer to Mykonos device data structure containing settings
  *
  * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
  */
-mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device)
+static mykonosErr_t mykInitializeDevice(mykonosDevice_t *device)
 {
     uint8_t txChannelSettings = 0;
     uint8_t rxChannelSettings = 0;
@@ -613,30 +703,6 @@ mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device)
     uint8_t orxSyncb = 0x00;
     mykonosErr_t retVal = MYKONOS_ERR_OK;
 
-#if (MYKONOS_VERBOSE == 1)
-   // CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_initialize()\n");
-#endif
-
-    retVal = MYKONOS_verifyDeviceDataStructure(device);
-    if (retVal != MYKONOS_ERR_OK)
-    {
-        return retVal;
-    }
-
-    /* Verify Rx/Tx and ObsRx profiles are valid combinations */
-    retVal = MYKONOS_verifyProfiles(device);
-    if (retVal != MYKONOS_ERR_OK)
-    {
-        return retVal;
-    }
-
-    /* Set 3 or 4-wire SPI mode, MSBFirst/LSBfirst in device, pushes CPOL=0, CPHA=0, longInstWord=1 into device->spiSettings */
-    retVal = MYKONOS_setSpiSettings(device);
-    if (retVal != MYKONOS_ERR_OK)
-    {
-        return retVal;
-    }
-
     /* Increase SPI_DO drive strength */
     CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_DIGITAL_IO_CONTROL, 0x10);
 
@@ -1235,7 +1301,6 @@ mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device)
         return retVal;
     }
 
-    
     if ((retVal = MYKONOS_setupObsRxAgc(device)) != MYKONOS_ERR_OK)
     {
         return retVal;
@@ -1268,6 +1333,65 @@ mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device)
     return MYKONOS_ERR_OK;
 }
 
+/**
+ * \brief Initializes the Mykonos device based on the desired device settings.
+ *
+ * This function initializes the mykonos device, setting up the CLKPLL, digital clocks,
+ * JESD204b settings, FIR Filters, digital filtering.  It does not load the ARM
+ * or perform any of the ARM init calibrations. It also sets the Rx Manual gain indexes and
+ * TxAttenuation settings to the initial values found in the device data structure.  It leaves the
+ * Mykonos in a state ready for multichip sync (which can bring up the JESD204 links), the
+ * ARM to be loaded, and the init calibartions run.
+ *
+ * <B>Dependencies</B>
+ * - device (all variables)
+ *
+ * \param device Pointer to Mykonos device data structure containing settings
+ *
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
+ */
+mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+#if (MYKONOS_VERBOSE == 1)
+   // CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_initialize()\n");
+#endif
+
+    retVal = MYKONOS_verifyDeviceDataStructure(device);
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    /* Verify Rx/Tx and ObsRx profiles are valid combinations */
+    retVal = MYKONOS_verifyProfiles(device);
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    /* make sure the register shadow knows its volatile registers, keep what MYKONOS_resetDevice seeded */
+    if ((device->spiSettings->regShadow != NULL) && !(device->spiSettings->regShadow->flags[MYKONOS_ADDR_ARM_CTL_1] & CMB_REGSHADOW_VOLATILE))
+    {
+        mykInitRegShadow(device, 0);
+    }
+
+    /* Set 3 or 4-wire SPI mode, MSBFirst/LSBfirst in device, pushes CPOL=0, CPHA=0, longInstWord=1 into device->spiSettings */
+    retVal = MYKONOS_setSpiSettings(device);
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    /* queue the register writes of mykInitializeDevice and send them in as few SPI transfers
+       as possible, reads and waits inside send what is queued first */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykInitializeDevice(device));
+
+    return retVal;
+}
+
 /**
  * \brief Verifies the init structure profiles are valid combinations
  *
@@ -1560,6 +1684,244 @@ mykonosErr_t MYKONOS_initSubRegisterTables(mykonosDevice_t *device)
     return MYKONOS_ERR_OK;
 }
 
+/* state of one paced wait, see mykonosPollPolicy_t */
+typedef struct
+{
+    mykonosDevice_t *device;
+    mykonosPollClass_t *pollClass;  /* NULL = no pacing */
+    cmbDeadline_t *deadline;
+    uint32_t timeout_us;
+    uint32_t interval_us;
+    uint32_t polls;
+    uint8_t useIrq;                 /* 0 once the GP interrupt woke this wait without an ARM error */
+} mykonosPoll_t;
+
+static void MYKONOS_pollStart(mykonosDevice_t *device, uint32_t waitClass, mykonosPoll_t *poll, cmbDeadline_t *deadline, uint32_t timeout_us)
+{
+    poll->device = device;
+    poll->pollClass = (device->pollPolicy != NULL) ? &device->pollPolicy->waitClass[waitClass] : NULL;
+    poll->deadline = deadline;
+    poll->useIrq = 1;
+    poll->timeout_us = timeout_us;
+    poll->interval_us = 0;
+    poll->polls = 0;
+
+    if ((poll->pollClass != NULL) && (poll->pollClass->maxInterval_us == 0))
+    {
+        /* class never configured */
+        MYKONOS_setPollPolicy(device, waitClass, 0, 0, 0);
+    }
+}
+
+/* Called before every status read, waits the pacing delay of this poll. A GP interrupt
+   (see MYKONOS_enableWaitInterrupt) ends the delay early; an ARM error or watchdog ends the
+   wait, anything else (level still high, PLL unlock) turns the interrupt off for this wait. */
+static mykonosErr_t MYKONOS_pollWait(mykonosPoll_t *poll)
+{
+    mykonosPollClass_t *pollClass = poll->pollClass;
+    uint32_t delay_us = 0;
+    uint32_t remaining_us = 0;
+    uint8_t interrupted = 0;
+    uint16_t gpStatus = 0;
+
+    poll->polls++;
+    if (pollClass == NULL)
+    {
+        return MYKONOS_ERR_OK;
+    }
+
+    if (poll->polls == 1)
+    {
+        /* skip most of the time this event usually takes */
+        delay_us = (uint32_t)(((uint64_t)pollClass->expected_us * pollClass->initialDelay_pct) / 100);
+        poll->interval_us = pollClass->minInterval_us;
+    }
+    else
+    {
+        delay_us = poll->interval_us;
+        poll->interval_us = (poll->interval_us >= (pollClass->maxInterval_us / 2)) ? pollClass->maxInterval_us : (poll->interval_us * 2);
+    }
+
+    /* the last poll is at the timeout */
+    remaining_us = CMB_deadlineRemaining_us(poll->deadline);
+    if (delay_us > remaining_us)
+    {
+        delay_us = remaining_us;
+    }
+
+    if (delay_us == 0)
+    {
+        return MYKONOS_ERR_OK;
+    }
+
+    if (!poll->useIrq)
+    {
+        CMB_pollWait_us(poll->device->spiSettings, delay_us, NULL);
+        return MYKONOS_ERR_OK;
+    }
+
+    if (CMB_pollWait_us(poll->device->spiSettings, delay_us, &interrupted) != COMMONERR_OK)
+    {
+        /* interrupt fd broken, keep polling on time */
+        poll->useIrq = 0;
+        return MYKONOS_ERR_OK;
+    }
+
+    if (interrupted)
+    {
+        MYKONOS_readGpInterruptStatus(poll->device, &gpStatus);
+        if (gpStatus & 0x0300)
+        {
+            CMB_writeToLog(ADIHAL_LOG_ERROR, poll->device->spiSettings->chipSelectIndex, MYKONOS_ERR_WAIT_ARM_INTERRUPT,
+                    getMykonosErrorMessage(MYKONOS_ERR_WAIT_ARM_INTERRUPT));
+            return MYKONOS_ERR_WAIT_ARM_INTERRUPT;
+        }
+        poll->useIrq = 0;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/* the wait completed, fold its duration into the learned completion time */
+static void MYKONOS_pollDone(mykonosPoll_t *poll)
+{
+    mykonosPollClass_t *pollClass = poll->pollClass;
+    uint32_t elapsed_us = 0;
+
+    if (pollClass == NULL)
+    {
+        return;
+    }
+
+    elapsed_us = poll->timeout_us - CMB_deadlineRemaining_us(poll->deadline);
+
+    /* moving average over about 8 waits, the first one is taken as is */
+    if (pollClass->completions == 0)
+    {
+        pollClass->expected_us = elapsed_us;
+    }
+    else
+    {
+        pollClass->expected_us = (uint32_t)(((uint64_t)pollClass->expected_us * 7 + elapsed_us) / 8);
+    }
+
+    pollClass->completions++;
+    pollClass->polls += poll->polls;
+}
+
+/**
+ * \brief Sets the pacing of the status polls of one wait class
+ *
+ * MYKONOS_waitForEvent() and MYKONOS_waitArmCmdStatus() poll a status bit over SPI. With
+ * device->pollPolicy set, the first poll of a wait is delayed by initialDelay_pct of the
+ * time the same wait took before on this device, then the gap between polls starts at
+ * minInterval_us and doubles up to maxInterval_us. The learned time of the class is kept.
+ *
+ * <B>Dependencies</B>
+ * - device->pollPolicy
+ *
+ * \param device is a pointer to the device settings structure
+ * \param waitClass waitEvent_t value, or MYK_POLL_CLASS_ARMCMD(opCode)
+ * \param initialDelay_pct first poll after this percentage of the learned time, 0 = MYK_POLL_INITIAL_DELAY_PCT
+ * \param minInterval_us first gap between polls, 0 = default of the class
+ * \param maxInterval_us largest gap between polls, 0 = default of the class
+ *
+ * \retval MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM device->pollPolicy is NULL
+ * \retval MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS waitClass out of range
+ * \retval MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL minInterval_us is larger than maxInterval_us
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_setPollPolicy(mykonosDevice_t *device, uint32_t waitClass, uint32_t initialDelay_pct, uint32_t minInterval_us, uint32_t maxInterval_us)
+{
+    mykonosPollClass_t *pollClass = NULL;
+    uint8_t isArmCmd = (waitClass >= MYK_POLL_CLASS_ARMCMD(0)) ? 1 : 0;
+
+    if (device->pollPolicy == NULL)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM,
+                getMykonosErrorMessage(MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM));
+        return MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM;
+    }
+
+    if (waitClass >= MYK_POLL_NUM_CLASSES)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS,
+                getMykonosErrorMessage(MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS));
+        return MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS;
+    }
+
+    if (minInterval_us == 0)
+    {
+        minInterval_us = isArmCmd ? MYK_POLL_ARMCMD_MIN_INTERVAL_US : MYK_POLL_EVENT_MIN_INTERVAL_US;
+    }
+
+    if (maxInterval_us == 0)
+    {
+        maxInterval_us = isArmCmd ? MYK_POLL_ARMCMD_MAX_INTERVAL_US : MYK_POLL_EVENT_MAX_INTERVAL_US;
+    }
+
+    if (minInterval_us > maxInterval_us)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL,
+                getMykonosErrorMessage(MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL));
+        return MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL;
+    }
+
+    pollClass = &device->pollPolicy->waitClass[waitClass];
+    pollClass->initialDelay_pct = (initialDelay_pct != 0) ? initialDelay_pct : MYK_POLL_INITIAL_DELAY_PCT;
+    pollClass->minInterval_us = minInterval_us;
+    pollClass->maxInterval_us = maxInterval_us;
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Lets the GP interrupt pin wake the paced waits of MYKONOS_waitForEvent() and
+ *        MYKONOS_waitArmCmdStatus()
+ *
+ * The GP interrupt has no "done" sources: PLLs raise it on unlock and the ARM on error or
+ * watchdog timeout. Waits therefore keep polling for completion, but between two polls
+ * they block on the interrupt fd instead of sleeping, and an ARM error or watchdog ends
+ * the wait at once instead of at its timeout (e.g. multi-second init cals). The PLL unlock
+ * sources stay masked, a PLL is unlocked while its lock is awaited.
+ *
+ * <B>Dependencies</B>
+ * - device->spiSettings, device->pollPolicy (without pacing waits never block)
+ *
+ * \param device is a pointer to the device settings structure
+ * \param uioDevice UIO device the GP interrupt pin is wired to, e.g. "/dev/uio2".
+ *        NULL = the fd set with CMB_setIrqFd() (e.g. an emulated interrupt)
+ *
+ * \retval MYKONOS_ERR_WAITIRQ_OPEN_FAILED uioDevice could not be opened
+ * \retval MYKONOS_ERR_WAITIRQ_GPINT_FAILED GP interrupt mask could not be set
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_enableWaitInterrupt(mykonosDevice_t *device, const char *uioDevice)
+{
+    /* ARM watchdog on, PLL unlock / JESD / PA protection off, ARM error can not be masked */
+    const uint16_t WAIT_GP_INT_MASK = 0x0FF;
+
+#if (MYKONOS_VERBOSE == 1)
+    CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_enableWaitInterrupt()\n");
+#endif
+
+    if ((uioDevice != NULL) && (CMB_openIrq(device->spiSettings, uioDevice) != COMMONERR_OK))
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_WAITIRQ_OPEN_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_WAITIRQ_OPEN_FAILED));
+        return MYKONOS_ERR_WAITIRQ_OPEN_FAILED;
+    }
+
+    if (MYKONOS_configGpInterrupt(device, WAIT_GP_INT_MASK) != MYKONOS_ERR_GPIO_OK)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_WAITIRQ_GPINT_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_WAITIRQ_GPINT_FAILED));
+        return MYKONOS_ERR_WAITIRQ_GPINT_FAILED;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
 /**
  * \brief Performs a blocking wait for a Mykonos calibration or Pll Lock
  *
@@ -1580,6 +1942,9 @@ mykonosErr_t MYKONOS_waitForEvent(mykonosDevice_t *device, waitEvent_t waitEvent
     uint8_t doneBitLevel = 0;
     uint8_t data = 0;
     mykonosErr_t errCode = MYKONOS_ERR_OK;
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    cmbDeadline_t deadline;
+    mykonosPoll_t poll;
 
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_waitForEvent()\n");
@@ -1707,10 +2072,16 @@ mykonosErr_t MYKONOS_waitForEvent(mykonosDevice_t *device, waitEvent_t waitEvent
             return MYKONOS_ERR_WAITFOREVENT_INV_PARM;
     }
 
-    CMB_setTimeout_us(timeout_us); /* timeout after desired time */
+    CMB_deadlineStart_us(&deadline, timeout_us); /* timeout after desired time */
+    MYKONOS_pollStart(device, (uint32_t)waitEvent, &poll, &deadline, timeout_us);
 
     do
     {
+        if ((retVal = MYKONOS_pollWait(&poll)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+
         CMB_SPIReadByte(device->spiSettings, spiAddr, &data);
 
         /* For SW verification tests, allow API to think all cals are complete*/
@@ -1725,13 +2096,18 @@ mykonosErr_t MYKONOS_waitForEvent(mykonosDevice_t *device, waitEvent_t waitEvent
         }
 #endif
 
-        if ((uint32_t)CMB_hasTimeoutExpired() > 0)
+        if ((uint32_t)CMB_deadlineExpired(&deadline) > 0)
         {
             CMB_writeToLog(ADIHAL_LOG_WARNING, device->spiSettings->chipSelectIndex, errCode, getMykonosErrorMessage(errCode));
             return errCode;
         }
     } while (((data >> spiBit) & 0x01) != doneBitLevel);
 
+    MYKONOS_pollDone(&poll);
+
+    /* a replayed init script must see the same event before it goes on */
+    CMB_SPIScriptCheckpoint(device->spiSettings, spiAddr, (uint8_t)(1 << spiBit), (uint8_t)(doneBitLevel << spiBit));
+
     return MYKONOS_ERR_OK;
 }
 
@@ -3099,11 +3475,21 @@ mykonosErr_t MYKONOS_readFir(mykonosDevice_t *device, mykonosfirName_t filterToR
     uint8_t numTapMultiple = 24;
     uint8_t maxNumTaps = 72;
     uint8_t filterGain = 0;
-    uint8_t msbRead = 0;
-    uint8_t lsbRead = 0;
 
     const uint8_t PROGRAM_CLK_EN = 0x80;
 
+#if (MYK_ENABLE_SPIWRITEARRAY == 0)
+    uint8_t msbRead = 0;
+    uint8_t lsbRead = 0;
+#elif (MYK_ENABLE_SPIWRITEARRAY == 1)
+    uint32_t addrIndex = 0;
+    uint32_t coefIndex = 0;
+    uint32_t j = 0;
+    uint32_t spiBufferSize = ((MYK_SPIWRITEARRAY_BUFFERSIZE / 6) * 6); /* Make buffer size a multiple of 6 */
+    uint16_t addrArray[MYK_SPIWRITEARRAY_BUFFERSIZE] = {0};
+    uint8_t dataArray[MYK_SPIWRITEARRAY_BUFFERSIZE] = {0};
+#endif
+
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_readFir()\n");
 #endif
@@ -3297,6 +3683,8 @@ mykonosErr_t MYKONOS_readFir(mykonosDevice_t *device, mykonosfirName_t filterToR
         return MYKONOS_ERR_READFIR_INV_NUMTAPS_PARM;
     }
 
+#if (MYK_ENABLE_SPIWRITEARRAY == 0)
+
     /* write filter coefficients */
     for (i = 0; i < firFilter->numFirCoefs; i++)
     {
@@ -3313,7 +3701,44 @@ mykonosErr_t MYKONOS_readFir(mykonosDevice_t *device, mykonosfirName_t filterToR
         firFilter->coefs[i] = (int16_t)((lsbRead & 0xFF) | ((msbRead << 8) & 0xFF00));
     }
 
-    return MYKONOS_ERR_OK;
+#elif (MYK_ENABLE_SPIWRITEARRAY == 1)
+
+    /* queue address/enable writes and coefficient reads back to back, read results come back in dataArray */
+    addrIndex = 0;
+    coefIndex = 0;
+    for (i = 0; i < firFilter->numFirCoefs; i++)
+    {
+        addrArray[addrIndex] = MYKONOS_ADDR_PFIR_COEFF_ADDR;
+        dataArray[addrIndex++] = (uint8_t)(i * 2);
+        addrArray[addrIndex] = MYKONOS_ADDR_PFIR_COEFF_CTL;
+        dataArray[addrIndex++] = (PROGRAM_CLK_EN | filterSelect);
+        addrArray[addrIndex++] = MYKONOS_ADDR_PFIR_COEFF_DATA | CMB_SPI_READ;
+        addrArray[addrIndex] = MYKONOS_ADDR_PFIR_COEFF_ADDR;
+        dataArray[addrIndex++] = (uint8_t)((i * 2) + 1);
+        addrArray[addrIndex] = MYKONOS_ADDR_PFIR_COEFF_CTL;
+        dataArray[addrIndex++] = (PROGRAM_CLK_EN | filterSelect);
+        addrArray[addrIndex++] = MYKONOS_ADDR_PFIR_COEFF_DATA | CMB_SPI_READ;
+
+        /* Send full buffer size when possible */
+        /* spiBufferSize set to multiple of 6 at top of function */
+        if ((addrIndex >= spiBufferSize) || (i == (uint8_t)(firFilter->numFirCoefs - 1)))
+        {
+            if (CMB_SPITransferBytes(device->spiSettings, &addrArray[0], &dataArray[0], addrIndex) != COMMONERR_OK)
+            {
+                return MYKONOS_ERR_FAILED;
+            }
+
+            for (j = 0; j < addrIndex; j += 6)
+            {
+                firFilter->coefs[coefIndex++] = (int16_t)((dataArray[j + 2] & 0xFF) | ((dataArray[j + 5] << 8) & 0xFF00));
+            }
+            addrIndex = 0;
+        }
+    }
+
+#endif
+
+    return MYKONOS_ERR_OK;
 }
 
 /*
@@ -3852,106 +4277,15 @@ mykonosErr_t MYKONOS_getRx2Gain(mykonosDevice_t *device, uint8_t *rx2GainIndex)
 }
 
 /**
- * \brief Sets up the device Rx Automatic Gain Control (AGC) registers.
+ * \brief Rx AGC setup of MYKONOS_setupRxAgc(), run while the SPI write batch is open
  *
- * Three data structures (mykonosAgcCfg_t, mykonosPeakDetAgcCfg_t, mykonosPowerMeasAgcCfg_t)
- * must be instantiated prior to calling this function. Valid ranges for data structure members
- * must also be provided.
- *
- *
- * <B>Dependencies:</B>
- * - device->spiSettings
- * - device->spiSettings->chipSelectIndex
- * - device->rx->rxAgcCtrl->agcRx1MaxGainIndex
- * - device->rx->rxAgcCtrl->agcRx1MinGainIndex
- * - device->rx->rxAgcCtrl->agcRx2MaxGainIndex
- * - device->rx->rxAgcCtrl->agcRx2MinGainIndex
- * - device->rx->rxAgcCtrl->agcObsRxMaxGainIndex
- * - device->rx->rxAgcCtrl->agcObsRxMinGainIndex
- * - device->rx->rxAgcCtrl->agcObsRxSelect
- * - device->rx->rxAgcCtrl->agcPeakThresholdMode
- * - device->rx->rxAgcCtrl->agcLowThsPreventGainIncrease
- * - device->rx->rxAgcCtrl->agcGainUpdateCounter
- * - device->rx->rxAgcCtrl->agcSlowLoopSettlingDelay
- * - device->rx->rxAgcCtrl->agcPeakWaitTime
- * - device->rx->rxAgcCtrl->agcResetOnRxEnable
- * - device->rx->rxAgcCtrl->agcEnableSyncPulseForGainCounter
- * - device->rx->rxAgcCtrl->peakAgc->apdHighThresh
- * - device->rx->rxAgcCtrl->peakAgc->apdLowThresh
- * - device->rx->rxAgcCtrl->peakAgc->hb2HighThresh
- * - device->rx->rxAgcCtrl->peakAgc->hb2LowThresh
- * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowThresh
- * - device->rx->rxAgcCtrl->peakAgc->apdHighThreshExceededCnt
- * - device->rx->rxAgcCtrl->peakAgc->apdLowThreshExceededCnt
- * - device->rx->rxAgcCtrl->peakAgc->hb2HighThreshExceededCnt
- * - device->rx->rxAgcCtrl->peakAgc->hb2LowThreshExceededCnt
- * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowThreshExceededCnt
- * - device->rx->rxAgcCtrl->peakAgc->apdHighGainStepAttack
- * - device->rx->rxAgcCtrl->peakAgc->apdLowGainStepRecovery
- * - device->rx->rxAgcCtrl->peakAgc->hb2HighGainStepAttack
- * - device->rx->rxAgcCtrl->peakAgc->hb2LowGainStepRecovery
- * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowGainStepRecovery
- * - device->rx->rxAgcCtrl->peakAgc->apdFastAttack
- * - device->rx->rxAgcCtrl->peakAgc->hb2FastAttack
- * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadDetectEnable
- * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadDurationCnt
- * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadThreshCnt
- * - device->rx->rxAgcCtrl->powerAgc->pmdUpperHighThresh
- * - device->rx->rxAgcCtrl->powerAgc->pmdUpperLowThresh
- * - device->rx->rxAgcCtrl->powerAgc->pmdLowerHighThresh
- * - device->rx->rxAgcCtrl->powerAgc->pmdLowerLowThresh
- * - device->rx->rxAgcCtrl->powerAgc->pmdUpperHighGainStepAttack
- * - device->rx->rxAgcCtrl->powerAgc->pmdUpperLowGainStepAttack
- * - device->rx->rxAgcCtrl->powerAgc->pmdLowerHighGainStepRecovery
- * - device->rx->rxAgcCtrl->powerAgc->pmdLowerLowGainStepRecovery
- * - device->rx->rxAgcCtrl->powerAgc->pmdMeasDuration
- * - device->rx->rxAgcCtrl->powerAgc->pmdMeasConfig
+ * \pre This function is private and is not called directly by the user.
  *
- * \param device is structure pointer to the Mykonos data structure containing settings
- * The pointer to the Mykonos AGC data structure containing settings is checked for a null pointer
- * to ensure it has been initialized. If not an error is thrown.
+ * \param device Pointer to Mykonos device data structure containing settings
  *
- * \retval Returns MYKONOS_ERR=pass, !MYKONOS_ERR=fail
- * \retval MYKONOS_ERR_INV_AGC_RX_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_RX_PWR_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_RX1_MAX_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_RX1_MIN_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_RX2_MAX_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_RX2_MIN_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_RX_GAIN_UPDATE_TIME_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_WAIT_TIME_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_SLOW_LOOP_SETTLING_DELAY
- * \retval MYKONOS_ERR_INV_AGC_PMD_MEAS_DURATION
- * \retval MYKONOS_ERR_INV_AGC_PMD_MEAS_CONFIG
- * \retval MYKONOS_ERR_INV_AGC_RX_LOW_THS_PREV_GAIN_INC
- * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_THRESH_MODE
- * \retval MYKONOS_ERR_INV_AGC_RX_RESET_ON_RX_ENABLE
- * \retval MYKONOS_ERR_INV_AGC_RX_ENABLE_SYNC_PULSE_GAIN_COUNTER
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_HIGH_THRESH
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_THRESH
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_LOW_THRESH
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_HIGH_THRESH
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_HIGH_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_LOW_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_RX_PKDET_FAST_ATTACK_VALUE
- * \retval MYKONOS_ERR_INV_AGC_RX_APD_HIGH_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_APD_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_HIGH_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_VERY_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_APD_HIGH_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_APD_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_HIGH_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_VERY_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_ENABLE
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_DUR_CNT
- * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_THRESH_CNT
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
  */
-mykonosErr_t MYKONOS_setupRxAgc(mykonosDevice_t *device)
+static mykonosErr_t mykSetupRxAgc(mykonosDevice_t *device)
 {
     uint8_t decPowerConfig = 0;
     uint8_t lower1ThreshGainStepRegValue = 0;
@@ -4481,6 +4815,122 @@ mykonosErr_t MYKONOS_setupRxAgc(mykonosDevice_t *device)
     /* Hard-coded value for APD decay setting. Setting allows for the quickest settling time of peak detector */
     CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_AGC_RX_BLOCK_DET_DECAY, 0x0);
 
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Sets up the device Rx Automatic Gain Control (AGC) registers.
+ *
+ * Three data structures (mykonosAgcCfg_t, mykonosPeakDetAgcCfg_t, mykonosPowerMeasAgcCfg_t)
+ * must be instantiated prior to calling this function. Valid ranges for data structure members
+ * must also be provided.
+ *
+ *
+ * <B>Dependencies:</B>
+ * - device->spiSettings
+ * - device->spiSettings->chipSelectIndex
+ * - device->rx->rxAgcCtrl->agcRx1MaxGainIndex
+ * - device->rx->rxAgcCtrl->agcRx1MinGainIndex
+ * - device->rx->rxAgcCtrl->agcRx2MaxGainIndex
+ * - device->rx->rxAgcCtrl->agcRx2MinGainIndex
+ * - device->rx->rxAgcCtrl->agcObsRxMaxGainIndex
+ * - device->rx->rxAgcCtrl->agcObsRxMinGainIndex
+ * - device->rx->rxAgcCtrl->agcObsRxSelect
+ * - device->rx->rxAgcCtrl->agcPeakThresholdMode
+ * - device->rx->rxAgcCtrl->agcLowThsPreventGainIncrease
+ * - device->rx->rxAgcCtrl->agcGainUpdateCounter
+ * - device->rx->rxAgcCtrl->agcSlowLoopSettlingDelay
+ * - device->rx->rxAgcCtrl->agcPeakWaitTime
+ * - device->rx->rxAgcCtrl->agcResetOnRxEnable
+ * - device->rx->rxAgcCtrl->agcEnableSyncPulseForGainCounter
+ * - device->rx->rxAgcCtrl->peakAgc->apdHighThresh
+ * - device->rx->rxAgcCtrl->peakAgc->apdLowThresh
+ * - device->rx->rxAgcCtrl->peakAgc->hb2HighThresh
+ * - device->rx->rxAgcCtrl->peakAgc->hb2LowThresh
+ * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowThresh
+ * - device->rx->rxAgcCtrl->peakAgc->apdHighThreshExceededCnt
+ * - device->rx->rxAgcCtrl->peakAgc->apdLowThreshExceededCnt
+ * - device->rx->rxAgcCtrl->peakAgc->hb2HighThreshExceededCnt
+ * - device->rx->rxAgcCtrl->peakAgc->hb2LowThreshExceededCnt
+ * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowThreshExceededCnt
+ * - device->rx->rxAgcCtrl->peakAgc->apdHighGainStepAttack
+ * - device->rx->rxAgcCtrl->peakAgc->apdLowGainStepRecovery
+ * - device->rx->rxAgcCtrl->peakAgc->hb2HighGainStepAttack
+ * - device->rx->rxAgcCtrl->peakAgc->hb2LowGainStepRecovery
+ * - device->rx->rxAgcCtrl->peakAgc->hb2VeryLowGainStepRecovery
+ * - device->rx->rxAgcCtrl->peakAgc->apdFastAttack
+ * - device->rx->rxAgcCtrl->peakAgc->hb2FastAttack
+ * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadDetectEnable
+ * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadDurationCnt
+ * - device->rx->rxAgcCtrl->peakAgc->hb2OverloadThreshCnt
+ * - device->rx->rxAgcCtrl->powerAgc->pmdUpperHighThresh
+ * - device->rx->rxAgcCtrl->powerAgc->pmdUpperLowThresh
+ * - device->rx->rxAgcCtrl->powerAgc->pmdLowerHighThresh
+ * - device->rx->rxAgcCtrl->powerAgc->pmdLowerLowThresh
+ * - device->rx->rxAgcCtrl->powerAgc->pmdUpperHighGainStepAttack
+ * - device->rx->rxAgcCtrl->powerAgc->pmdUpperLowGainStepAttack
+ * - device->rx->rxAgcCtrl->powerAgc->pmdLowerHighGainStepRecovery
+ * - device->rx->rxAgcCtrl->powerAgc->pmdLowerLowGainStepRecovery
+ * - device->rx->rxAgcCtrl->powerAgc->pmdMeasDuration
+ * - device->rx->rxAgcCtrl->powerAgc->pmdMeasConfig
+ *
+ * \param device is structure pointer to the Mykonos data structure containing settings
+ * The pointer to the Mykonos AGC data structure containing settings is checked for a null pointer
+ * to ensure it has been initialized. If not an error is thrown.
+ *
+ * \retval Returns MYKONOS_ERR=pass, !MYKONOS_ERR=fail
+ * \retval MYKONOS_ERR_INV_AGC_RX_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_RX_PWR_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_RX1_MAX_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_RX1_MIN_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_RX2_MAX_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_RX2_MIN_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_RX_GAIN_UPDATE_TIME_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_WAIT_TIME_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_SLOW_LOOP_SETTLING_DELAY
+ * \retval MYKONOS_ERR_INV_AGC_PMD_MEAS_DURATION
+ * \retval MYKONOS_ERR_INV_AGC_PMD_MEAS_CONFIG
+ * \retval MYKONOS_ERR_INV_AGC_RX_LOW_THS_PREV_GAIN_INC
+ * \retval MYKONOS_ERR_INV_AGC_RX_PEAK_THRESH_MODE
+ * \retval MYKONOS_ERR_INV_AGC_RX_RESET_ON_RX_ENABLE
+ * \retval MYKONOS_ERR_INV_AGC_RX_ENABLE_SYNC_PULSE_GAIN_COUNTER
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_HIGH_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_LOW_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_HIGH_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_HIGH_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_LOWER_LOW_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_RX_PMD_UPPER_LOW_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_RX_PKDET_FAST_ATTACK_VALUE
+ * \retval MYKONOS_ERR_INV_AGC_RX_APD_HIGH_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_APD_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_HIGH_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_VERY_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_APD_HIGH_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_APD_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_HIGH_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_VERY_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_ENABLE
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_DUR_CNT
+ * \retval MYKONOS_ERR_INV_AGC_RX_HB2_OVLD_THRESH_CNT
+ */
+mykonosErr_t MYKONOS_setupRxAgc(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    /* queue the register writes of mykSetupRxAgc and send them in as few SPI transfers as possible */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykSetupRxAgc(device));
+
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
     /* performing a soft reset */
     return MYKONOS_resetRxAgc(device);
 }
@@ -5613,105 +6063,15 @@ mykonosErr_t MYKONOS_getObsRxGain(mykonosDevice_t *device, uint8_t *gainIndex)
 }
 
 /**
- * \brief Sets up the device ObsRx Automatic Gain Control (AGC) registers.
- *
- * Three data structures (of types mykonosAgcCfg_t, mykonosPeakDetAgcCfg_t, mykonosPowerMeasAgcCfg_t)
- * must be instantiated prior to calling this function. Valid ranges for data structure members
- * must also be provided.
- *
+ * \brief ObsRx AGC setup of MYKONOS_setupObsRxAgc(), run while the SPI write batch is open
  *
- * <B>Dependencies:</B>
- * - device->spiSettings
- * - device->spiSettings->chipSelectIndex
- * - device->obsRx->orxAgcCtrl->agcRx1MaxGainIndex
- * - device->obsRx->orxAgcCtrl->agcRx1MinGainIndex
- * - device->obsRx->orxAgcCtrl->agcRx2MaxGainIndex
- * - device->obsRx->orxAgcCtrl->agcRx2MinGainIndex
- * - device->obsRx->orxAgcCtrl->agcObsRxMaxGainIndex
- * - device->obsRx->orxAgcCtrl->agcObsRxMinGainIndex
- * - device->obsRx->orxAgcCtrl->agcObsRxSelect
- * - device->obsRx->orxAgcCtrl->agcPeakThresholdMode
- * - device->obsRx->orxAgcCtrl->agcLowThsPreventGainIncrease
- * - device->obsRx->orxAgcCtrl->agcGainUpdateCounter
- * - device->obsRx->orxAgcCtrl->agcSlowLoopSettlingDelay
- * - device->obsRx->orxAgcCtrl->agcPeakWaitTime
- * - device->obsRx->orxAgcCtrl->agcResetOnRxEnable
- * - device->obsRx->orxAgcCtrl->agcEnableSyncPulseForGainCounter
- * - device->obsRx->orxAgcCtrl->peakAgc->apdHighThresh
- * - device->obsRx->orxAgcCtrl->peakAgc->apdLowThresh
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighThresh
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowThresh
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowThresh
- * - device->obsRx->orxAgcCtrl->peakAgc->apdHighThreshExceededCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->apdLowThreshExceededCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighThreshExceededCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowThreshExceededCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowThreshExceededCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->apdHighGainStepAttack
- * - device->obsRx->orxAgcCtrl->peakAgc->apdLowGainStepRecovery
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighGainStepAttack
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowGainStepRecovery
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowGainStepRecovery
- * - device->obsRx->orxAgcCtrl->peakAgc->apdFastAttack
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2FastAttack
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDetectEnable
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt
- * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperHighThresh
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperLowThresh
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerHighThresh
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerLowThresh
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperHighGainStepAttack
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperLowGainStepAttack
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerHighGainStepRecovery
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerLowGainStepRecovery
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdMeasDuration
- * - device->obsRx->orxAgcCtrl->powerAgc->pmdMeasConfig
+ * \pre This function is private and is not called directly by the user.
  *
- * \param device is structure pointer to the Mykonos data structure containing settings
- * The pointer to the Mykonos AGC data structure containing settings is checked for a null pointer
- * to ensure it has been initialized. If not an error is thrown.
+ * \param device Pointer to Mykonos device data structure containing settings
  *
- * \retval Returns MYKONOS_ERR=pass, !MYKONOS_ERR=fail
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PWR_STRUCT_INIT
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_MAX_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_MIN_GAIN_INDEX
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_SELECT
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_GAIN_UPDATE_TIME_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_WAIT_TIME_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_SLOW_LOOP_SETTLING_DELAY
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_MEAS_DURATION
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_MEAS_CONFIG
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_LOW_THS_PREV_GAIN_INC
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_THRESH_MODE
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_RESET_ON_RX_ENABLE
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_ENABLE_SYNC_PULSE_GAIN_COUNTER
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_HIGH_THRESH
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_LOW_THRESH
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_LOW_THRESH
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_HIGH_THRESH
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_HIGH_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_LOW_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_LOW_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_HIGH_GAIN_STEP
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_PKDET_FAST_ATTACK_VALUE
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_HIGH_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_HIGH_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_VERY_LOW_THRESH_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_HIGH_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_HIGH_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_VERY_LOW_GAIN_STEP_PARM
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_ENABLE
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT
- * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
  */
-mykonosErr_t MYKONOS_setupObsRxAgc(mykonosDevice_t *device)
+static mykonosErr_t mykSetupObsRxAgc(mykonosDevice_t *device)
 {
     /* Current configuration does not support AGC on ORx channel */
     uint8_t decPowerConfig = 0;
@@ -6203,35 +6563,150 @@ mykonosErr_t MYKONOS_setupObsRxAgc(mykonosDevice_t *device)
         return MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_ENABLE;
     }
 
-    /* Range Check on hb2OverloadDetectEnable */
-    if (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt > 0x7)
-    {
-        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT,
-                getMykonosErrorMessage(MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT));
-        return MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT;
-    }
+    /* Range Check on hb2OverloadDetectEnable */
+    if (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt > 0x7)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT,
+                getMykonosErrorMessage(MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT));
+        return MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT;
+    }
+
+    /* Range Check on hb2OverloadDetectEnable */
+    if (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt > 0xF)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT,
+                getMykonosErrorMessage(MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT));
+        return MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT;
+    }
+    else
+    {
+        /* Write the hb2OvldCfgRegValue, the combination of hb2OverloadThreshCnt, hb2OverloadDurationCnt, and hb2OverloadDetectEnable */
+        hb2OvldCfgRegValue = (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt) |
+                             (uint8_t)(device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt << 4) |
+                             (uint8_t)(device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDetectEnable << 7);
+        CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_ORX_SNRX_OVRLD_PD_DEC_OVRLD_CFG, hb2OvldCfgRegValue);
+    }
+
+    /* Hard-coded value for the ADC overload configuration. Sets the HB2 offset to -6dB.*/
+    CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_ORX_SNRX_OVRLD_ADC_OVRLD_CFG, 0x18);
+    /* Hard-coded value for APD decay setting. Setting allows for the quickest settling time of peak detector */
+    CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_AGC_ORX_SNRX_BLOCK_DET_DECAY, 0x0);
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Sets up the device ObsRx Automatic Gain Control (AGC) registers.
+ *
+ * Three data structures (of types mykonosAgcCfg_t, mykonosPeakDetAgcCfg_t, mykonosPowerMeasAgcCfg_t)
+ * must be instantiated prior to calling this function. Valid ranges for data structure members
+ * must also be provided.
+ *
+ *
+ * <B>Dependencies:</B>
+ * - device->spiSettings
+ * - device->spiSettings->chipSelectIndex
+ * - device->obsRx->orxAgcCtrl->agcRx1MaxGainIndex
+ * - device->obsRx->orxAgcCtrl->agcRx1MinGainIndex
+ * - device->obsRx->orxAgcCtrl->agcRx2MaxGainIndex
+ * - device->obsRx->orxAgcCtrl->agcRx2MinGainIndex
+ * - device->obsRx->orxAgcCtrl->agcObsRxMaxGainIndex
+ * - device->obsRx->orxAgcCtrl->agcObsRxMinGainIndex
+ * - device->obsRx->orxAgcCtrl->agcObsRxSelect
+ * - device->obsRx->orxAgcCtrl->agcPeakThresholdMode
+ * - device->obsRx->orxAgcCtrl->agcLowThsPreventGainIncrease
+ * - device->obsRx->orxAgcCtrl->agcGainUpdateCounter
+ * - device->obsRx->orxAgcCtrl->agcSlowLoopSettlingDelay
+ * - device->obsRx->orxAgcCtrl->agcPeakWaitTime
+ * - device->obsRx->orxAgcCtrl->agcResetOnRxEnable
+ * - device->obsRx->orxAgcCtrl->agcEnableSyncPulseForGainCounter
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdHighThresh
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdLowThresh
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighThresh
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowThresh
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowThresh
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdHighThreshExceededCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdLowThreshExceededCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighThreshExceededCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowThreshExceededCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowThreshExceededCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdHighGainStepAttack
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdLowGainStepRecovery
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2HighGainStepAttack
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2LowGainStepRecovery
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2VeryLowGainStepRecovery
+ * - device->obsRx->orxAgcCtrl->peakAgc->apdFastAttack
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2FastAttack
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDetectEnable
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt
+ * - device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperHighThresh
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperLowThresh
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerHighThresh
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerLowThresh
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperHighGainStepAttack
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdUpperLowGainStepAttack
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerHighGainStepRecovery
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdLowerLowGainStepRecovery
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdMeasDuration
+ * - device->obsRx->orxAgcCtrl->powerAgc->pmdMeasConfig
+ *
+ * \param device is structure pointer to the Mykonos data structure containing settings
+ * The pointer to the Mykonos AGC data structure containing settings is checked for a null pointer
+ * to ensure it has been initialized. If not an error is thrown.
+ *
+ * \retval Returns MYKONOS_ERR=pass, !MYKONOS_ERR=fail
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PWR_STRUCT_INIT
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_MAX_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_MIN_GAIN_INDEX
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_SELECT
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_GAIN_UPDATE_TIME_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_WAIT_TIME_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_SLOW_LOOP_SETTLING_DELAY
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_MEAS_DURATION
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_MEAS_CONFIG
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_LOW_THS_PREV_GAIN_INC
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PEAK_THRESH_MODE
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_RESET_ON_RX_ENABLE
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_ENABLE_SYNC_PULSE_GAIN_COUNTER
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_HIGH_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_LOW_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_LOW_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_HIGH_THRESH
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_HIGH_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_LOW_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_UPPER_LOW_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PMD_LOWER_HIGH_GAIN_STEP
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_PKDET_FAST_ATTACK_VALUE
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_HIGH_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_HIGH_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_VERY_LOW_THRESH_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_HIGH_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_APD_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_HIGH_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_VERY_LOW_GAIN_STEP_PARM
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_ENABLE
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_DUR_CNT
+ * \retval MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT
+ */
+mykonosErr_t MYKONOS_setupObsRxAgc(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    /* queue the register writes of mykSetupObsRxAgc and send them in as few SPI transfers as possible */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykSetupObsRxAgc(device));
 
-    /* Range Check on hb2OverloadDetectEnable */
-    if (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt > 0xF)
-    {
-        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT,
-                getMykonosErrorMessage(MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT));
-        return MYKONOS_ERR_INV_AGC_OBSRX_HB2_OVLD_THRESH_CNT;
-    }
-    else
+    if (retVal != MYKONOS_ERR_OK)
     {
-        /* Write the hb2OvldCfgRegValue, the combination of hb2OverloadThreshCnt, hb2OverloadDurationCnt, and hb2OverloadDetectEnable */
-        hb2OvldCfgRegValue = (device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadThreshCnt) |
-                             (uint8_t)(device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDurationCnt << 4) |
-                             (uint8_t)(device->obsRx->orxAgcCtrl->peakAgc->hb2OverloadDetectEnable << 7);
-        CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_ORX_SNRX_OVRLD_PD_DEC_OVRLD_CFG, hb2OvldCfgRegValue);
+        return retVal;
     }
 
-    /* Hard-coded value for the ADC overload configuration. Sets the HB2 offset to -6dB.*/
-    CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_ORX_SNRX_OVRLD_ADC_OVRLD_CFG, 0x18);
-    /* Hard-coded value for APD decay setting. Setting allows for the quickest settling time of peak detector */
-    CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_AGC_ORX_SNRX_BLOCK_DET_DECAY, 0x0);
-
     /* performing a soft reset */
     return MYKONOS_resetRxAgc(device);
 }
@@ -8007,6 +8482,57 @@ const char* getMykonosErrorMessage(mykonosErr_t errorCode)
         case MYKONOS_ERR_CLGCATTENTUNCFGGET_NULL_ATTRANGECFGSTRUCT:
             return "Passed structure is null in MYKONOS_getClgcAttenTuningConfig().\n";
 
+        case MYKONOS_ERR_FLEET_INV_PARAM:
+            return "Fleet is NULL, empty, too large or has a device without SPI settings in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_DEVICE_FAILED:
+            return "At least one device of the fleet failed to come up in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_CLKPLL_LOCK:
+            return "CLKPLL did not lock after MYKONOS_initialize() in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_RFPLL_LOCK:
+            return "An RF PLL did not lock in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_MCS_FAILED:
+            return "Multichip sync did not complete after SYSREF in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_INITCALS_FAILED:
+            return "Init calibrations reported an error in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_FLEET_SYSREF_FAILED:
+            return "SYSREF request failed in MYKONOS_fleetBringUp().\n";
+        case MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM:
+            return "device->pollPolicy is NULL in MYKONOS_setPollPolicy().\n";
+        case MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS:
+            return "Wait class out of range in MYKONOS_setPollPolicy().\n";
+        case MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL:
+            return "minInterval_us larger than maxInterval_us in MYKONOS_setPollPolicy().\n";
+        case MYKONOS_ERR_WAITIRQ_OPEN_FAILED:
+            return "Could not open the UIO device in MYKONOS_enableWaitInterrupt().\n";
+        case MYKONOS_ERR_WAITIRQ_GPINT_FAILED:
+            return "Could not set the GP interrupt mask in MYKONOS_enableWaitInterrupt().\n";
+        case MYKONOS_ERR_WAIT_ARM_INTERRUPT:
+            return "ARM error or watchdog GP interrupt while waiting for an event or ARM command.\n";
+        case MYKONOS_ERR_INITCALASYNC_NULL_PARAM:
+            return "Job or job->device is NULL in an init cal async function.\n";
+        case MYKONOS_ERR_INITCALASYNC_BUSY:
+            return "Job is still running or was not waited for in MYKONOS_runInitCalsAsync().\n";
+        case MYKONOS_ERR_INITCALASYNC_THREAD_FAILED:
+            return "Could not start the worker thread in MYKONOS_runInitCalsAsync(), the job has to be stepped.\n";
+        case MYKONOS_ERR_ARMPIPE_NULL_PARAM:
+            return "Pipe, device or command is NULL, or numBytes is set without data, in an ARM pipe function.\n";
+        case MYKONOS_ERR_ARMPIPE_FULL:
+            return "Too many ARM commands waiting to be sent in MYKONOS_armPipeSubmit().\n";
+        case MYKONOS_ERR_ARMIMAGE_NULL_PARAM:
+            return "Device, image or file name is NULL, or the image is not open, in an ARM image function.\n";
+        case MYKONOS_ERR_ARMIMAGE_OPEN_FAILED:
+            return "Could not open or map the ARM .bin file in MYKONOS_armImageOpen().\n";
+        case MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT:
+            return "ARM image must be 98304 bytes.\n";
+        case MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS:
+            return "ARM image needs the 16 bit instruction word and the write bit polarity it was encoded with.\n";
+        case MYKONOS_ERR_ARMIMAGE_NO_MEMORY:
+            return "Could not allocate the ARM image SPI stream.\n";
+        case MYKONOS_ERR_ARMIMAGE_WRITE_FAILED:
+            return "SPI write of the ARM image failed in MYKONOS_loadArmImage().\n";
+        case MYKONOS_ERR_SPIBATCH_COMMIT_FAILED:
+            return "SPI transfer of the batched register writes failed.\n";
+
         default:
             return "Unknown error was encountered.\n";
     }
@@ -8954,36 +9480,15 @@ mykonosErr_t MYKONOS_setupDeserializers(mykonosDevice_t *device)
 }
 
 /**
- * \brief Sets up the JESD204B Framer
+ * \brief Rx framer setup of MYKONOS_setupJesd204bFramer(), run while the SPI write batch is open
  *
- * <B>Dependencies</B>
- * - device->spiSettings
- * - device->spiSettings->chipSelectIndex
- * - device->rx->framer->M
- * - device->rx->realIfData
- * - device->rx->framer->bankId
- * - device->rx->framer->lane0Id
- * - device->rx->framer->serializerLanesEnabled
- * - device->rx->framer->obsRxSyncbSelect
- * - device->rx->framer->K
- * - device->rx->framer->externalSysref
- * - device->rx->rxChannels
- * - device->rx->framer->newSysrefOnRelink
- * - device->rx->framer->enableAutoChanXbar
- * - device->rx->framer->lmfcOffset
- * - device->rx->framer->scramble
+ * \pre This function is private and is not called directly by the user.
  *
- * \param device Pointer to the device settings structure
+ * \param device Pointer to Mykonos device data structure containing settings
  *
- * \retval MYKONOS_ERR_OK Function completed successfully
- * \retval MYKONOS_ERR_FRAMER_INV_REAL_IF_DATA_PARM Invalid framer M, M can only = 1 in real IF mode
- * \retval MYKONOS_ERR_FRAMER_INV_M_PARM Invalid framer M (valid 1,2,4)
- * \retval MYKONOS_ERR_FRAMER_INV_BANKID_PARM Invalid BankId (valid 0-15)
- * \retval MYKONOS_ERR_FRAMER_INV_LANEID_PARM Invalid Lane0Id (valid 0-31)
- * \retval MYKONOS_ERR_RXFRAMER_INV_FK_PARAM
- * \retval MYKONOS_ERR_FRAMER_INV_K_OFFSET_PARAM
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
  */
-mykonosErr_t MYKONOS_setupJesd204bFramer(mykonosDevice_t *device)
+static mykonosErr_t mykSetupJesd204bFramer(mykonosDevice_t *device)
 {
     uint8_t i = 0;
     uint8_t fifoLaneEnable = 0;
@@ -9442,34 +9947,56 @@ mykonosErr_t MYKONOS_setupJesd204bFramer(mykonosDevice_t *device)
 }
 
 /**
- * \brief Sets up the JESD204B OBSRX Framer
+ * \brief Sets up the JESD204B Framer
  *
  * <B>Dependencies</B>
- * - device->rxChannels
- * - device->spiSettings->chipSelectIndex
- * - device->obsRx->framer->bankId
- * - device->obsRx->framer->M
- * - device->obsRx->framer->serializerLanesEnabled
- * - device->obsRx->framer->externalSysref
  * - device->spiSettings
- * - device->obsRx->framer->deviceId
- * - device->obsRx->framer->lane0Id
- * - device->obsRx->framer->K
- * - device->obsRx->framer->lmfcOffset
- * - device->obsRx->framer->scramble
- * - device->obsRx->framer->obsRxSyncbSelect
+ * - device->spiSettings->chipSelectIndex
+ * - device->rx->framer->M
+ * - device->rx->realIfData
+ * - device->rx->framer->bankId
+ * - device->rx->framer->lane0Id
+ * - device->rx->framer->serializerLanesEnabled
+ * - device->rx->framer->obsRxSyncbSelect
+ * - device->rx->framer->K
+ * - device->rx->framer->externalSysref
+ * - device->rx->rxChannels
+ * - device->rx->framer->newSysrefOnRelink
+ * - device->rx->framer->enableAutoChanXbar
+ * - device->rx->framer->lmfcOffset
+ * - device->rx->framer->scramble
  *
  * \param device Pointer to the device settings structure
  *
  * \retval MYKONOS_ERR_OK Function completed successfully
- * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_REAL_IF_DATA_PARM M parameter can only be 1 when real IF data mode is enabled
- * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_M_PARM ObsRx Framer M parameter can only be 1 or 2
- * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_BANKID_PARM Invalid BankId (0-15)
- * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_LANEID_PARM Invalid lane0Id (0-31)
- * \retval MYKONOS_ERR_OBSRXFRAMER_INV_FK_PARAM Invalid F*K value (F * K must be > 20 and divisible by 4)
- * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_K_OFFSET_PARAM Invalid K offset, must be less than K
+ * \retval MYKONOS_ERR_FRAMER_INV_REAL_IF_DATA_PARM Invalid framer M, M can only = 1 in real IF mode
+ * \retval MYKONOS_ERR_FRAMER_INV_M_PARM Invalid framer M (valid 1,2,4)
+ * \retval MYKONOS_ERR_FRAMER_INV_BANKID_PARM Invalid BankId (valid 0-15)
+ * \retval MYKONOS_ERR_FRAMER_INV_LANEID_PARM Invalid Lane0Id (valid 0-31)
+ * \retval MYKONOS_ERR_RXFRAMER_INV_FK_PARAM
+ * \retval MYKONOS_ERR_FRAMER_INV_K_OFFSET_PARAM
  */
-mykonosErr_t MYKONOS_setupJesd204bObsRxFramer(mykonosDevice_t *device)
+mykonosErr_t MYKONOS_setupJesd204bFramer(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    /* queue the register writes of mykSetupJesd204bFramer and send them in as few SPI transfers as possible */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykSetupJesd204bFramer(device));
+
+    return retVal;
+}
+
+/**
+ * \brief ObsRx framer setup of MYKONOS_setupJesd204bObsRxFramer(), run while the SPI write batch is open
+ *
+ * \pre This function is private and is not called directly by the user.
+ *
+ * \param device Pointer to Mykonos device data structure containing settings
+ *
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
+ */
+static mykonosErr_t mykSetupJesd204bObsRxFramer(mykonosDevice_t *device)
 {
     uint8_t i = 0;
     uint8_t laneFifoEnable = 0;
@@ -9869,6 +10396,45 @@ mykonosErr_t MYKONOS_setupJesd204bObsRxFramer(mykonosDevice_t *device)
     return MYKONOS_ERR_OK;
 }
 
+/**
+ * \brief Sets up the JESD204B OBSRX Framer
+ *
+ * <B>Dependencies</B>
+ * - device->rxChannels
+ * - device->spiSettings->chipSelectIndex
+ * - device->obsRx->framer->bankId
+ * - device->obsRx->framer->M
+ * - device->obsRx->framer->serializerLanesEnabled
+ * - device->obsRx->framer->externalSysref
+ * - device->spiSettings
+ * - device->obsRx->framer->deviceId
+ * - device->obsRx->framer->lane0Id
+ * - device->obsRx->framer->K
+ * - device->obsRx->framer->lmfcOffset
+ * - device->obsRx->framer->scramble
+ * - device->obsRx->framer->obsRxSyncbSelect
+ *
+ * \param device Pointer to the device settings structure
+ *
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_REAL_IF_DATA_PARM M parameter can only be 1 when real IF data mode is enabled
+ * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_M_PARM ObsRx Framer M parameter can only be 1 or 2
+ * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_BANKID_PARM Invalid BankId (0-15)
+ * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_LANEID_PARM Invalid lane0Id (0-31)
+ * \retval MYKONOS_ERR_OBSRXFRAMER_INV_FK_PARAM Invalid F*K value (F * K must be > 20 and divisible by 4)
+ * \retval MYKONOS_ERR_OBSRX_FRAMER_INV_K_OFFSET_PARAM Invalid K offset, must be less than K
+ */
+mykonosErr_t MYKONOS_setupJesd204bObsRxFramer(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    /* queue the register writes of mykSetupJesd204bObsRxFramer and send them in as few SPI transfers as possible */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykSetupJesd204bObsRxFramer(device));
+
+    return retVal;
+}
+
 /**
  * \brief Enables/Disables the JESD204B Rx Framer
  *
@@ -10007,32 +10573,15 @@ mykonosErr_t MYKONOS_enableObsRxFramerLink(mykonosDevice_t *device, uint8_t enab
 }
 
 /**
- * \brief Sets up the JESD204B Deframer
+ * \brief Deframer setup of MYKONOS_setupJesd204bDeframer(), run while the SPI write batch is open
  *
- * <B>Dependencies</B>
- * - device->spiSettings->chipSelectIndex
- * - device->tx->deframer->M
- * - device->tx->deframer->bankId
- * - device->tx->deframer->lane0Id
- * - device->tx->deframer->K
- * - device->tx->deframer->deserializerLanesEnabled
- * - device->tx->deframer->externalSysref
- * - device->tx->deframer->newSysrefOnRelink
- * - device->tx->deframer->enableAutoChanXbar
- * - device->tx->deframer->lmfcOffset
- * - device->tx->deframer->scramble
+ * \pre This function is private and is not called directly by the user.
  *
- * \param device Pointer to device settings structure
+ * \param device Pointer to Mykonos device data structure containing settings
  *
- * \retval MYKONOS_ERR_OK Function completed successfully
- * \retval MYKONOS_ERR_DEFRAMER_INV_M_PARM Invalid M parameter in deframer structure
- * \retval MYKONOS_ERR_DEFRAMER_INV_BANKID_PARM Invalid BankId parameter in deframer structure (Valid 0-15)
- * \retval MYKONOS_ERR_ERR_DEFRAMER_INV_LANEID_PARM Invalid Lane0Id parameter in deframer structure (Valid 0-31)
- * \retval MYKONOS_ERR_DEFRAMER_INV_K_PARAM Invalid K parameter in deframer structure (valid 1-32 with other constraints)
- * \retval MYKONOS_ERR_DEFRAMER_INV_FK_PARAM Invalid F*K parameter (Valid F*K > 20, F*K must be divisible by 4), K must be <= 32
- * \retval MYKONOS_ERR_DEFRAMER_INV_K_OFFSET_PARAM Invalid K offset parameter in deframer structure (must be less than K)
+ * \return Returns enum mykonosErr_t, MYKONOS_ERR_OK=pass, !MYKONOS_ERR_OK=fail
  */
-mykonosErr_t MYKONOS_setupJesd204bDeframer(mykonosDevice_t *device)
+static mykonosErr_t mykSetupJesd204bDeframer(mykonosDevice_t *device)
 {
     uint8_t i = 0;
     uint8_t temp = 0;
@@ -10358,6 +10907,43 @@ mykonosErr_t MYKONOS_setupJesd204bDeframer(mykonosDevice_t *device)
     return MYKONOS_ERR_OK;
 }
 
+/**
+ * \brief Sets up the JESD204B Deframer
+ *
+ * <B>Dependencies</B>
+ * - device->spiSettings->chipSelectIndex
+ * - device->tx->deframer->M
+ * - device->tx->deframer->bankId
+ * - device->tx->deframer->lane0Id
+ * - device->tx->deframer->K
+ * - device->tx->deframer->deserializerLanesEnabled
+ * - device->tx->deframer->externalSysref
+ * - device->tx->deframer->newSysrefOnRelink
+ * - device->tx->deframer->enableAutoChanXbar
+ * - device->tx->deframer->lmfcOffset
+ * - device->tx->deframer->scramble
+ *
+ * \param device Pointer to device settings structure
+ *
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ * \retval MYKONOS_ERR_DEFRAMER_INV_M_PARM Invalid M parameter in deframer structure
+ * \retval MYKONOS_ERR_DEFRAMER_INV_BANKID_PARM Invalid BankId parameter in deframer structure (Valid 0-15)
+ * \retval MYKONOS_ERR_ERR_DEFRAMER_INV_LANEID_PARM Invalid Lane0Id parameter in deframer structure (Valid 0-31)
+ * \retval MYKONOS_ERR_DEFRAMER_INV_K_PARAM Invalid K parameter in deframer structure (valid 1-32 with other constraints)
+ * \retval MYKONOS_ERR_DEFRAMER_INV_FK_PARAM Invalid F*K parameter (Valid F*K > 20, F*K must be divisible by 4), K must be <= 32
+ * \retval MYKONOS_ERR_DEFRAMER_INV_K_OFFSET_PARAM Invalid K offset parameter in deframer structure (must be less than K)
+ */
+mykonosErr_t MYKONOS_setupJesd204bDeframer(mykonosDevice_t *device)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    /* queue the register writes of mykSetupJesd204bDeframer and send them in as few SPI transfers as possible */
+    CMB_SPIBatchBegin(device->spiSettings);
+    retVal = mykCommitBatch(device, mykSetupJesd204bDeframer(device));
+
+    return retVal;
+}
+
 /**
  * \brief Sets up the chip for multichip sync, and cleans up after MCS.
  *
@@ -11396,6 +11982,9 @@ mykonosErr_t MYKONOS_waitInitCals(mykonosDevice_t *device, uint32_t timeoutMs, u
         return MYKONOS_ERR_WAIT_INITCALS_ARMERROR;
     }
 
+    /* init cals are done, the ARM leaves the configuration registers alone again */
+    CMB_regShadowSuspend(device->spiSettings, 0);
+
     return MYKONOS_ERR_OK;
 }
 
@@ -11655,6 +12244,9 @@ mykonosErr_t MYKONOS_radioOff(mykonosDevice_t *device)
         return MYKONOS_ERR_ARM_RADIOOFF_FAILED;
     }
 
+    /* tracking cals are stopped, the register shadow can be used again */
+    CMB_regShadowSuspend(device->spiSettings, 0);
+
     return MYKONOS_ERR_OK;
 }
 
@@ -13437,6 +14029,7 @@ mykonosErr_t MYKONOS_verifyArmChecksum(mykonosDevice_t *device)
     uint8_t buildData[4] = {0};
     uint8_t calcData[4] = {0};
     mykonosErr_t retVal = MYKONOS_ERR_OK;
+    cmbDeadline_t deadline;
 
     const uint8_t CHECKSUM_BYTES = 0x4;
 
@@ -13454,7 +14047,7 @@ mykonosErr_t MYKONOS_verifyArmChecksum(mykonosDevice_t *device)
     buildTimeChecksum = (((uint32_t)buildData[3] << 24) | ((uint32_t)buildData[2] << 16) | ((uint32_t)buildData[1] << 8) | (uint32_t)buildData[0]);
 
     /* using 200 msec timeout for exit out of while loop [maximum checksum calculation time = 5 ms] */
-    CMB_setTimeout_ms(200);
+    CMB_deadlineStart_ms(&deadline, 200);
 
     /* determining calculated checksum */
     do
@@ -13464,11 +14057,16 @@ mykonosErr_t MYKONOS_verifyArmChecksum(mykonosDevice_t *device)
             return retVal;
         }
         calculatedChecksum = (((uint32_t)calcData[3] << 24) | ((uint32_t)calcData[2] << 16) | ((uint32_t)calcData[1] << 8) | (uint32_t)calcData[0]);
-    } while ((!calculatedChecksum) && (!CMB_hasTimeoutExpired()));
+    } while ((!calculatedChecksum) && (!CMB_deadlineExpired(&deadline)));
 
     /* performing consistency check */
     if (buildTimeChecksum == calculatedChecksum)
     {
+        /* a replayed init script must load the same ARM image */
+        CMB_SPIScriptCheckpoint(device->spiSettings, MYKONOS_ADDR_ARM_DATA_BYTE_0, 0xFF, calcData[0]);
+        CMB_SPIScriptCheckpoint(device->spiSettings, MYKONOS_ADDR_ARM_DATA_BYTE_1, 0xFF, calcData[1]);
+        CMB_SPIScriptCheckpoint(device->spiSettings, MYKONOS_ADDR_ARM_DATA_BYTE_2, 0xFF, calcData[2]);
+        CMB_SPIScriptCheckpoint(device->spiSettings, MYKONOS_ADDR_ARM_DATA_BYTE_3, 0xFF, calcData[3]);
         return MYKONOS_ERR_OK;
     }
     else
@@ -13502,12 +14100,13 @@ mykonosErr_t MYKONOS_checkArmState(mykonosDevice_t *device, mykonosArmState_t ar
     uint32_t armStatusMapped = 0x00;
     uint32_t timeoutMs = 500; /* 500ms timeOut */
     uint8_t endCheck = 0x00;
+    cmbDeadline_t deadline;
 
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_checkArmState()\n");
 #endif
 
-    CMB_setTimeout_ms(timeoutMs);
+    CMB_deadlineStart_ms(&deadline, timeoutMs);
 
     do
     {
@@ -13545,7 +14144,7 @@ mykonosErr_t MYKONOS_checkArmState(mykonosDevice_t *device, mykonosArmState_t ar
             break;
         }
 
-        if (CMB_hasTimeoutExpired())
+        if (CMB_deadlineExpired(&deadline))
         {
             CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_WAITARMCSTATE_TIMEOUT,
                     getMykonosErrorMessage(MYKONOS_ERR_WAITARMCSTATE_TIMEOUT));
@@ -15590,6 +16189,14 @@ mykonosErr_t MYKONOS_readArmMem(mykonosDevice_t *device, uint32_t address, uint8
     uint8_t dataMem;
     uint32_t i;
 
+#if MYK_ENABLE_SPIWRITEARRAY == 1
+    uint32_t addrIndex = 0;
+    uint32_t dataIndex = 0;
+    uint32_t j = 0;
+    uint16_t addrArray[MYK_SPIWRITEARRAY_BUFFERSIZE] = {0};
+    uint8_t dataArray[MYK_SPIWRITEARRAY_BUFFERSIZE] = {0};
+#endif
+
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_readArmMem()\n");
 #endif
@@ -15640,6 +16247,8 @@ mykonosErr_t MYKONOS_readArmMem(mykonosDevice_t *device, uint32_t address, uint8
     /* read data is located at SPI address 0xD04=data[7:0], 0xD05=data[15:8], 0xD06=data[23:16], 0xD07=data[31:24]. */
     /* with address auto increment set, after xD07 is read, the address will automatically increment */
     /* without address auto increment set, 0x4 must be added to the address for correct indexing */
+#if (MYK_ENABLE_SPIWRITEARRAY == 0)
+
     if (autoIncrement)
     {
         for (i = 0; i < bytesToRead; i++)
@@ -15661,6 +16270,44 @@ mykonosErr_t MYKONOS_readArmMem(mykonosDevice_t *device, uint32_t address, uint8
         }
     }
 
+#elif (MYK_ENABLE_SPIWRITEARRAY == 1)
+
+    /* queue the reads (and address updates) back to back, results are collected as they come back */
+    addrIndex = 0;
+    dataIndex = 0;
+    for (i = 0; i < bytesToRead; i++)
+    {
+        addrArray[addrIndex++] = (MYKONOS_ADDR_ARM_DATA_BYTE_0 | (((address & 0x3) + i) % 4)) | CMB_SPI_READ;
+
+        if ((!autoIncrement) && ((MYKONOS_ADDR_ARM_DATA_BYTE_0 | (((address & 0x3) + i) % 4)) == MYKONOS_ADDR_ARM_DATA_BYTE_3))
+        {
+            dataArray[addrIndex] = (uint8_t)(((address + 0x4) & 0x3FF) >> 2);
+            addrArray[addrIndex++] = MYKONOS_ADDR_ARM_ADDR_BYTE_0;
+            dataArray[addrIndex] = ((address + 0x4) & 0x1FC00U) >> 10 | (uint8_t)(dataMem << 7);
+            addrArray[addrIndex++] = MYKONOS_ADDR_ARM_ADDR_BYTE_1;
+        }
+
+        /* leave room for a read plus two address writes */
+        if ((addrIndex >= (MYK_SPIWRITEARRAY_BUFFERSIZE - 3)) || (i == (bytesToRead - 1)))
+        {
+            if (CMB_SPITransferBytes(device->spiSettings, &addrArray[0], &dataArray[0], addrIndex) != COMMONERR_OK)
+            {
+                return MYKONOS_ERR_FAILED;
+            }
+
+            for (j = 0; j < addrIndex; j++)
+            {
+                if (addrArray[j] & CMB_SPI_READ)
+                {
+                    returnData[dataIndex++] = dataArray[j];
+                }
+            }
+            addrIndex = 0;
+        }
+    }
+
+#endif
+
     return MYKONOS_ERR_OK;
 }
 
@@ -15927,6 +16574,7 @@ mykonosErr_t MYKONOS_sendArmCommand(mykonosDevice_t *device, uint8_t opCode, uin
     uint8_t armCommandBusy = 0;
     uint8_t i = 0;
     uint16_t extCmdByteStartAddr = MYKONOS_ADDR_ARM_EXT_CMD_BYTE_1;
+    cmbDeadline_t deadline;
 
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_sendArmCommand()\n");
@@ -15955,13 +16603,13 @@ mykonosErr_t MYKONOS_sendArmCommand(mykonosDevice_t *device, uint8_t opCode, uin
     }
 
     /* setting a 2 sec timeout for mailbox busy bit to be clear (can't send an arm mailbox command until mailbox is ready) */
-    CMB_setTimeout_ms(2000);
+    CMB_deadlineStart_ms(&deadline, 2000);
 
     do
     {
         CMB_SPIReadField(device->spiSettings, MYKONOS_ADDR_ARM_CMD, &armCommandBusy, 0x80, 7);
 
-        if (CMB_hasTimeoutExpired())
+        if (CMB_deadlineExpired(&deadline))
         {
             CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_TIMEDOUT_ARMMAILBOXBUSY,
                     getMykonosErrorMessage(MYKONOS_ERR_TIMEDOUT_ARMMAILBOXBUSY));
@@ -15979,6 +16627,14 @@ mykonosErr_t MYKONOS_sendArmCommand(mykonosDevice_t *device, uint8_t opCode, uin
 
     CMB_SPIWriteByte(device->spiSettings, MYKONOS_ADDR_ARM_CMD, opCode);
 
+    /* the ARM may change configuration registers while it runs the command, init cals and
+     * tracking cals keep doing so until they finish, so stop using the shadow until then */
+    CMB_regShadowInvalidate(device->spiSettings);
+    if ((opCode == MYKONOS_ARM_RUNINIT_OPCODE) || (opCode == MYKONOS_ARM_RADIOON_OPCODE))
+    {
+        CMB_regShadowSuspend(device->spiSettings, 1);
+    }
+
     return MYKONOS_ERR_OK;
 }
 
@@ -16128,6 +16784,8 @@ mykonosErr_t MYKONOS_readArmCmdStatusByte(mykonosDevice_t *device, uint8_t opCod
 mykonosErr_t MYKONOS_waitArmCmdStatus(mykonosDevice_t *device, uint8_t opCode, uint32_t timeoutMs, uint8_t *cmdStatByte)
 {
     mykonosErr_t retVal = MYKONOS_ERR_OK;
+    cmbDeadline_t deadline;
+    mykonosPoll_t poll;
 
 #if (MYKONOS_VERBOSE == 1)
     CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_waitArmCmdStatus()\n");
@@ -16149,10 +16807,16 @@ mykonosErr_t MYKONOS_waitArmCmdStatus(mykonosDevice_t *device, uint8_t opCode, u
     }
 
     /* start wait */
-    CMB_setTimeout_ms(timeoutMs);
+    CMB_deadlineStart_ms(&deadline, timeoutMs);
+    MYKONOS_pollStart(device, MYK_POLL_CLASS_ARMCMD(opCode), &poll, &deadline, timeoutMs * 1000);
 
     do
     {
+        if ((retVal = MYKONOS_pollWait(&poll)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+
         retVal = MYKONOS_readArmCmdStatusByte(device, opCode, cmdStatByte);
         if (retVal != MYKONOS_ERR_OK)
         {
@@ -16167,12 +16831,14 @@ mykonosErr_t MYKONOS_waitArmCmdStatus(mykonosDevice_t *device, uint8_t opCode, u
             return MYKONOS_ERR_ARMCMDSTATUS_ARMERROR;
         }
 
-        if (CMB_hasTimeoutExpired())
+        if (CMB_deadlineExpired(&deadline))
         {
             return MYKONOS_ERR_WAITARMCMDSTATUS_TIMEOUT;
         }
     } while (*cmdStatByte & 0x01);
 
+    MYKONOS_pollDone(&poll);
+
     return MYKONOS_ERR_OK;
 }
 
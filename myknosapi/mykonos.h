@@ -41,6 +41,8 @@ mykonosErr_t MYKONOS_verifyProfiles(mykonosDevice_t *device);
 mykonosErr_t MYKONOS_initialize(mykonosDevice_t *device); 
 mykonosErr_t MYKONOS_waitForEvent(mykonosDevice_t *device, waitEvent_t waitEvent, uint32_t timeout_us);
 mykonosErr_t MYKONOS_readEventStatus(mykonosDevice_t *device, waitEvent_t waitEvent, uint8_t *eventDone);
+mykonosErr_t MYKONOS_setPollPolicy(mykonosDevice_t *device, uint32_t waitClass, uint32_t initialDelay_pct, uint32_t minInterval_us, uint32_t maxInterval_us);
+mykonosErr_t MYKONOS_enableWaitInterrupt(mykonosDevice_t *device, const char *uioDevice);
 mykonosErr_t MYKONOS_getApiVersion (mykonosDevice_t *device, uint32_t *siVer, uint32_t *majorVer, uint32_t *minorVer, uint32_t *buildVer);
 
 /*
@@ -0,0 +1,362 @@
+/**
+ *\file mykonos_armcmd.c
+ *
+ *\brief ARM mailbox commands kept in flight together. MYKONOS_sendArmCommand() and
+ *       MYKONOS_waitArmCmdStatus() run one command at a time; the command status register
+ *       has a pending bit per opcode, so commands with different opcodes of which at most one
+ *       exchanges data through ARM memory can run in the ARM at the same time and be completed
+ *       as their bits clear.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "common.h"
+#include "mykonos.h"
+#include "mykonos_armcmd.h"
+#include "mykonos_macros.h"
+
+/* 1 = a and b may not be in the ARM at the same time */
+static int MYKONOS_armCmdConflict(const mykonosArmCmd_t *a, const mykonosArmCmd_t *b)
+{
+    if (a->opCode == b->opCode)
+    {
+        return 1;
+    }
+
+    /* the ARM data buffer holds the arguments or result of one command at a time, the ARM
+       may write a result anywhere in it whatever range the other command uses */
+    return ((a->numBytes > 0) && (b->numBytes > 0));
+}
+
+static void MYKONOS_armCmdDone(mykonosArmCmd_t *cmd, mykonosErr_t status)
+{
+    cmd->status = status;
+    cmd->state = MYK_ARMCMD_DONE;
+}
+
+/* sends every queued command that conflicts with nothing in flight or queued before it */
+static void MYKONOS_armPipeIssue(mykonosArmPipe_t *pipe, mykonosArmCmd_t **done, uint32_t *numDone)
+{
+    mykonosArmCmd_t *cmd = NULL;
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    uint32_t inFlight = 0;
+    uint32_t kept = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    int blocked = 0;
+
+    for (i = 0; i < pipe->numQueued; i++)
+    {
+        cmd = pipe->queued[i];
+        blocked = 0;
+
+        for (j = 0; (j < MYK_ARMPIPE_NUM_OPCODES) && !blocked; j++)
+        {
+            blocked = (pipe->sentMask & (1 << j)) && MYKONOS_armCmdConflict(cmd, pipe->sent[j]);
+        }
+
+        for (j = 0; (j < kept) && !blocked; j++)
+        {
+            blocked = MYKONOS_armCmdConflict(cmd, pipe->queued[j]);
+        }
+
+        if (blocked)
+        {
+            pipe->queued[kept++] = cmd;
+            continue;
+        }
+
+        retVal = MYKONOS_ERR_OK;
+        if ((cmd->writeData != NULL) && (cmd->numBytes > 0))
+        {
+            retVal = MYKONOS_writeArmMem(pipe->device, cmd->armAddr, (uint8_t *)cmd->writeData, cmd->numBytes);
+        }
+
+        if (retVal == MYKONOS_ERR_OK)
+        {
+            retVal = MYKONOS_sendArmCommand(pipe->device, cmd->opCode, &cmd->extData[0], cmd->extDataNumBytes);
+        }
+
+        if (retVal != MYKONOS_ERR_OK)
+        {
+            MYKONOS_armCmdDone(cmd, retVal);
+            done[(*numDone)++] = cmd;
+            continue;
+        }
+
+        CMB_deadlineStart_ms(&cmd->deadline, cmd->timeout_ms);
+        cmd->state = MYK_ARMCMD_SENT;
+        pipe->sent[cmd->opCode >> 1] = cmd;
+        pipe->sentMask |= (uint16_t)(1 << (cmd->opCode >> 1));
+    }
+    pipe->numQueued = kept;
+
+    for (j = 0; j < MYK_ARMPIPE_NUM_OPCODES; j++)
+    {
+        inFlight += (pipe->sentMask >> j) & 1;
+    }
+    if (inFlight > pipe->maxInFlight)
+    {
+        pipe->maxInFlight = inFlight;
+    }
+}
+
+/* callbacks run last, they may submit into the pipe */
+static void MYKONOS_armPipeNotify(mykonosArmPipe_t *pipe, mykonosArmCmd_t **done, uint32_t numDone)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < numDone; i++)
+    {
+        pipe->commands++;
+        if (done[i]->status != MYKONOS_ERR_OK)
+        {
+            CMB_writeToLog(ADIHAL_LOG_ERROR, pipe->device->spiSettings->chipSelectIndex, done[i]->status,
+                    getMykonosErrorMessage(done[i]->status));
+        }
+
+        if (done[i]->callback != NULL)
+        {
+            done[i]->callback(done[i], done[i]->userData);
+        }
+    }
+}
+
+/**
+ * \brief Sets up an empty ARM command pipeline for a device
+ *
+ * \param pipe Pipeline to set up, pollInterval_us is kept
+ * \param device Device whose ARM runs the commands
+ *
+ * \retval MYKONOS_ERR_ARMPIPE_NULL_PARAM pipe or device is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_armPipeInit(mykonosArmPipe_t *pipe, mykonosDevice_t *device)
+{
+    uint32_t i = 0;
+
+    if ((pipe == NULL) || (device == NULL))
+    {
+        return MYKONOS_ERR_ARMPIPE_NULL_PARAM;
+    }
+
+    pipe->device = device;
+    pipe->numQueued = 0;
+    pipe->sentMask = 0;
+    pipe->commands = 0;
+    pipe->statusReads = 0;
+    pipe->maxInFlight = 0;
+    for (i = 0; i < MYK_ARMPIPE_NUM_OPCODES; i++)
+    {
+        pipe->sent[i] = NULL;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Adds a command to the pipeline, sending it right away when nothing blocks it
+ *
+ * Returns without waiting for the ARM. The command finishes in a later MYKONOS_armPipeStep()
+ * or MYKONOS_armPipeWait(); a command that could not be sent finishes here, its callback
+ * is called before this function returns.
+ *
+ * <B>Dependencies</B>
+ * - pipe->device->spiSettings->chipSelectIndex
+ *
+ * \param pipe Pipeline of the device
+ * \param cmd Command, opCode / extData / memory / timeout / callback filled in
+ *
+ * \retval MYKONOS_ERR_ARMPIPE_NULL_PARAM pipe or cmd is NULL, or numBytes is set without data
+ * \retval MYKONOS_ERR_ARMCMD_INV_OPCODE_PARM ARM opcode is out of range (valid 0-30, even only)
+ * \retval MYKONOS_ERR_ARMCMD_INV_NUMBYTES_PARM Number of extended bytes parameter is out of range (valid 0-4)
+ * \retval MYKONOS_ERR_ARMPIPE_FULL MYK_ARMPIPE_DEPTH commands are already waiting to be sent
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_armPipeSubmit(mykonosArmPipe_t *pipe, mykonosArmCmd_t *cmd)
+{
+    mykonosArmCmd_t *done[MYK_ARMPIPE_DEPTH];
+    uint32_t numDone = 0;
+
+    if ((pipe == NULL) || (cmd == NULL) || ((cmd->numBytes > 0) && (cmd->writeData == NULL) && (cmd->readData == NULL)))
+    {
+        return MYKONOS_ERR_ARMPIPE_NULL_PARAM;
+    }
+
+    if ((cmd->opCode % 2) || (cmd->opCode > 30))
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, pipe->device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMCMD_INV_OPCODE_PARM,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMCMD_INV_OPCODE_PARM));
+        return MYKONOS_ERR_ARMCMD_INV_OPCODE_PARM;
+    }
+
+    if (cmd->extDataNumBytes > 4)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, pipe->device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMCMD_INV_NUMBYTES_PARM,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMCMD_INV_NUMBYTES_PARM));
+        return MYKONOS_ERR_ARMCMD_INV_NUMBYTES_PARM;
+    }
+
+    if (pipe->numQueued >= MYK_ARMPIPE_DEPTH)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, pipe->device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMPIPE_FULL,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMPIPE_FULL));
+        return MYKONOS_ERR_ARMPIPE_FULL;
+    }
+
+    cmd->status = MYKONOS_ERR_OK;
+    cmd->cmdStatusByte = 0;
+    cmd->state = MYK_ARMCMD_QUEUED;
+    pipe->queued[pipe->numQueued++] = cmd;
+
+    MYKONOS_armPipeIssue(pipe, done, &numDone);
+    MYKONOS_armPipeNotify(pipe, done, numDone);
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Completes the commands the ARM has finished and sends the ones that are now free
+ *
+ * Does not wait: reads the command status bytes of every command in flight in one burst.
+ * A command whose pending bit cleared has its readData read back, one with an ARM error
+ * flag or past its timeout ends with that error. Callbacks run on the calling thread.
+ *
+ * \param pipe Pipeline of the device
+ * \param nextStep_us Returns when to call again, 0 = the pipeline is empty. NULL = not needed
+ *
+ * \retval MYKONOS_ERR_ARMPIPE_NULL_PARAM pipe is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully, see the status of each command
+ */
+mykonosErr_t MYKONOS_armPipeStep(mykonosArmPipe_t *pipe, uint32_t *nextStep_us)
+{
+    mykonosArmCmd_t *done[MYK_ARMPIPE_NUM_OPCODES + MYK_ARMPIPE_DEPTH];
+    mykonosArmCmd_t *cmd = NULL;
+    uint16_t addr[MYK_ARMPIPE_NUM_OPCODES / 2];
+    uint8_t status[MYK_ARMPIPE_NUM_OPCODES / 2] = {0};
+    uint8_t byteIndex[MYK_ARMPIPE_NUM_OPCODES / 2];
+    uint32_t numBytes = 0;
+    uint32_t numDone = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint8_t nibble = 0;
+    uint8_t statusValid = 0;
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    if (pipe == NULL)
+    {
+        return MYKONOS_ERR_ARMPIPE_NULL_PARAM;
+    }
+
+    if (pipe->sentMask)
+    {
+        /* two opcodes share each status byte */
+        for (i = 0; i < (MYK_ARMPIPE_NUM_OPCODES / 2); i++)
+        {
+            if (pipe->sentMask & (0x3 << (i * 2)))
+            {
+                addr[numBytes] = (uint16_t)(MYKONOS_ADDR_ARM_CMD_STATUS_0 + i);
+                byteIndex[numBytes++] = (uint8_t)i;
+            }
+        }
+        /* without the status a command is still running, it is read again on the next step */
+        statusValid = (CMB_SPIReadBytes(pipe->device->spiSettings, &addr[0], &status[0], numBytes) == COMMONERR_OK);
+        pipe->statusReads++;
+
+        for (j = 0; j < numBytes; j++)
+        {
+            for (i = byteIndex[j] * 2; i < (uint32_t)(byteIndex[j] * 2 + 2); i++)
+            {
+                if (!(pipe->sentMask & (1 << i)))
+                {
+                    continue;
+                }
+
+                cmd = pipe->sent[i];
+                nibble = (i & 1) ? ((status[j] >> 4) & 0x0F) : (status[j] & 0x0F);
+                if (statusValid)
+                {
+                    cmd->cmdStatusByte = nibble;
+                }
+
+                if (!statusValid)
+                {
+                    if (!CMB_deadlineExpired(&cmd->deadline))
+                    {
+                        continue;
+                    }
+                    retVal = MYKONOS_ERR_WAITARMCMDSTATUS_TIMEOUT;
+                }
+                else if (nibble & 0x0E)
+                {
+                    retVal = MYKONOS_ERR_ARMCMDSTATUS_ARMERROR;
+                }
+                else if (!(nibble & 0x01))
+                {
+                    /* read the result before a later command reuses the ARM memory */
+                    retVal = MYKONOS_ERR_OK;
+                    if ((cmd->readData != NULL) && (cmd->numBytes > 0))
+                    {
+                        retVal = MYKONOS_readArmMem(pipe->device, cmd->armAddr, cmd->readData, cmd->numBytes, 1);
+                    }
+                }
+                else if (CMB_deadlineExpired(&cmd->deadline))
+                {
+                    retVal = MYKONOS_ERR_WAITARMCMDSTATUS_TIMEOUT;
+                }
+                else
+                {
+                    continue;
+                }
+
+                MYKONOS_armCmdDone(cmd, retVal);
+                done[numDone++] = cmd;
+                pipe->sent[i] = NULL;
+                pipe->sentMask &= (uint16_t)~(1 << i);
+            }
+        }
+    }
+
+    MYKONOS_armPipeIssue(pipe, done, &numDone);
+    MYKONOS_armPipeNotify(pipe, done, numDone);
+
+    if (nextStep_us != NULL)
+    {
+        *nextStep_us = 0;
+        if (pipe->sentMask || pipe->numQueued)
+        {
+            *nextStep_us = (pipe->pollInterval_us > 0) ? pipe->pollInterval_us : MYK_ARMPIPE_POLL_US;
+        }
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Steps the pipeline until every command submitted has finished
+ *
+ * \param pipe Pipeline of the device
+ *
+ * \retval MYKONOS_ERR_ARMPIPE_NULL_PARAM pipe is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully, see the status of each command
+ */
+mykonosErr_t MYKONOS_armPipeWait(mykonosArmPipe_t *pipe)
+{
+    uint32_t next_us = 0;
+
+    if (pipe == NULL)
+    {
+        return MYKONOS_ERR_ARMPIPE_NULL_PARAM;
+    }
+
+    do
+    {
+        MYKONOS_armPipeStep(pipe, &next_us);
+        if (next_us > 0)
+        {
+            CMB_pollWait_us(pipe->device->spiSettings, next_us, NULL);
+        }
+    } while (next_us > 0);
+
+    return MYKONOS_ERR_OK;
+}
@@ -0,0 +1,105 @@
+/*!
+ * \file mykonos_armcmd.h
+ * \brief Contains type definitions and function prototypes for mykonos_armcmd.c,
+ *        ARM mailbox commands kept in flight together, one per opcode
+ */
+
+#ifndef MYKONOSARMCMD_H_
+#define MYKONOSARMCMD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "t_mykonos.h"
+#include "common.h"
+
+/* commands a pipe holds that are not sent yet */
+#define MYK_ARMPIPE_DEPTH           16
+
+/* ARM opcodes 0, 2, .. 30, each with its own pending bit in the command status register */
+#define MYK_ARMPIPE_NUM_OPCODES     16
+
+/* gap between two reads of the command status register while commands are in flight */
+#define MYK_ARMPIPE_POLL_US         100
+
+/**
+ * \brief Where a pipelined ARM command is
+ */
+typedef enum
+{
+    MYK_ARMCMD_IDLE = 0,            /*!< not submitted */
+    MYK_ARMCMD_QUEUED,              /*!< waits for its opcode or its ARM memory to be free */
+    MYK_ARMCMD_SENT,                /*!< in the ARM, pending bit set */
+    MYK_ARMCMD_DONE                 /*!< finished, see status */
+} mykonosArmCmdState_t;
+
+struct mykonosArmCmd;
+
+/* called by the thread stepping the pipe once the command is done, may submit more commands */
+typedef void (*mykonosArmCmdCallback_t)(struct mykonosArmCmd *cmd, void *userData);
+
+/**
+ * \brief One ARM mailbox command, owned by the caller until it is done
+ *
+ * armAddr / numBytes is the ARM memory the command exchanges data through (for SET, GET,
+ * READCFG and WRITECFG that is MYKONOS_ADDR_ARM_START_DATA_ADDR). writeData is written there
+ * before the command is sent, readData is read back from there once it completed. The ARM has
+ * one data buffer, so only one command with numBytes > 0 is in the ARM at a time.
+ */
+typedef struct mykonosArmCmd
+{
+    uint8_t opCode;                 /*!< 0 - 30, even only */
+    uint8_t extData[4];             /*!< extended command bytes */
+    uint8_t extDataNumBytes;        /*!< 0 - 4 */
+    const uint8_t *writeData;       /*!< NULL = nothing to write */
+    uint8_t *readData;              /*!< NULL = nothing to read back */
+    uint32_t armAddr;
+    uint32_t numBytes;              /*!< size of the ARM memory used, 0 = none */
+    uint32_t timeout_ms;            /*!< from the time the command is sent */
+    mykonosArmCmdCallback_t callback; /*!< NULL = none */
+    void *userData;                 /*!< passed to callback */
+
+    /* filled in */
+    volatile mykonosArmCmdState_t state;
+    mykonosErr_t status;            /*!< MYKONOS_ERR_OK, MYKONOS_ERR_ARMCMDSTATUS_ARMERROR, MYKONOS_ERR_WAITARMCMDSTATUS_TIMEOUT or the send error */
+    uint8_t cmdStatusByte;          /*!< [3:1] = ARM error type, [0] = pending, as from MYKONOS_waitArmCmdStatus() */
+    cmbDeadline_t deadline;         /*!< private */
+} mykonosArmCmd_t;
+
+/**
+ * \brief ARM command pipeline of one device
+ *
+ * Commands are sent in submit order as long as none in flight has the same opcode or shares
+ * ARM memory with them; a command that has to wait also holds back later commands it conflicts
+ * with. All commands in flight are tracked by one burst read of their command status bytes.
+ * Only one thread at a time may use a pipe, and the device's ARM commands must all go
+ * through it while it has commands in flight.
+ */
+typedef struct
+{
+    mykonosDevice_t *device;
+    uint32_t pollInterval_us;       /*!< status read period in MYKONOS_armPipeWait(), 0 = MYK_ARMPIPE_POLL_US */
+
+    /* state, set up by MYKONOS_armPipeInit() */
+    mykonosArmCmd_t *queued[MYK_ARMPIPE_DEPTH];     /*!< not sent yet, in submit order */
+    uint32_t numQueued;
+    mykonosArmCmd_t *sent[MYK_ARMPIPE_NUM_OPCODES]; /*!< in flight, by opCode / 2 */
+    uint16_t sentMask;              /*!< bit opCode / 2 set while sent[] holds a command */
+
+    /* counters */
+    uint32_t commands;              /*!< commands finished */
+    uint32_t statusReads;           /*!< command status bursts read */
+    uint32_t maxInFlight;           /*!< most commands in flight together */
+} mykonosArmPipe_t;
+
+mykonosErr_t MYKONOS_armPipeInit(mykonosArmPipe_t *pipe, mykonosDevice_t *device);
+mykonosErr_t MYKONOS_armPipeSubmit(mykonosArmPipe_t *pipe, mykonosArmCmd_t *cmd);
+mykonosErr_t MYKONOS_armPipeStep(mykonosArmPipe_t *pipe, uint32_t *nextStep_us);
+mykonosErr_t MYKONOS_armPipeWait(mykonosArmPipe_t *pipe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYKONOSARMCMD_H_ */
@@ -0,0 +1,389 @@
+/**
+ *\file mykonos_armload.c
+ *
+ *\brief Loads the ARM firmware from an SPI write stream built once per image. The .bin file
+ *       is mapped instead of read, its writes are encoded a single time (and optionally kept
+ *       in a cache file next to it), and a load pushes the stream to the HAL in large chunks.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "mykonos.h"
+#include "mykonos_armload.h"
+#include "mykonos_macros.h"
+
+/* cache file: header, then the stream */
+#define MYK_ARMIMAGE_CACHE_MAGIC    0x314D5241  /* "ARM1" */
+#define MYK_ARMIMAGE_CACHE_VERSION  1
+#define MYK_ARMIMAGE_CACHE_HEADER   24
+
+/* the header names the .bin the stream was built from and the write bit polarity it uses */
+static void MYKONOS_armImageCacheHeader(uint8_t *header, const struct stat *binStat, uint8_t polarity)
+{
+    uint32_t magic = MYK_ARMIMAGE_CACHE_MAGIC;
+    uint32_t numWords = MYK_ARMIMAGE_NUM_WORDS;
+    uint64_t mtime_s = (uint64_t)binStat->st_mtim.tv_sec;
+    uint32_t mtime_ns = (uint32_t)binStat->st_mtim.tv_nsec;
+    uint32_t i = 0;
+
+    memset(header, 0, MYK_ARMIMAGE_CACHE_HEADER);
+    for (i = 0; i < 4; i++)
+    {
+        header[i] = (uint8_t)(magic >> (8 * i));
+        header[8 + i] = (uint8_t)(numWords >> (8 * i));
+        header[20 + i] = (uint8_t)(mtime_ns >> (8 * i));
+    }
+    for (i = 0; i < 8; i++)
+    {
+        header[12 + i] = (uint8_t)(mtime_s >> (8 * i));
+    }
+    header[4] = MYK_ARMIMAGE_CACHE_VERSION;
+    header[5] = polarity & 0x01;
+}
+
+/* maps the cache file when it was built from this .bin with these SPI settings */
+static mykonosErr_t MYKONOS_armImageMapCache(mykonosArmImage_t *image, const char *cacheFile, const struct stat *binStat, uint8_t polarity)
+{
+    uint8_t header[MYK_ARMIMAGE_CACHE_HEADER];
+    struct stat cacheStat;
+    size_t size = MYK_ARMIMAGE_CACHE_HEADER + (MYK_ARMIMAGE_NUM_WORDS * 3);
+    void *map = NULL;
+    int fd = -1;
+
+    fd = open(cacheFile, O_RDONLY);
+    if (fd < 0)
+    {
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    if ((fstat(fd, &cacheStat) != 0) || ((size_t)cacheStat.st_size != size))
+    {
+        close(fd);
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    MYKONOS_armImageCacheHeader(header, binStat, polarity);
+    if (memcmp(map, header, sizeof(header)) != 0)
+    {
+        munmap(map, size);
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    image->cacheMap = map;
+    image->cacheMapSize = size;
+    image->words = (const uint8_t *)map + MYK_ARMIMAGE_CACHE_HEADER;
+    image->numWords = MYK_ARMIMAGE_NUM_WORDS;
+    image->fromCache = 1;
+
+    return MYKONOS_ERR_OK;
+}
+
+/* writes the cache through a temporary file, so a reader never maps half a stream */
+static void MYKONOS_armImageSaveCache(const mykonosArmImage_t *image, const char *cacheFile, const struct stat *binStat, uint8_t polarity)
+{
+    uint8_t header[MYK_ARMIMAGE_CACHE_HEADER];
+    char tmpFile[512];
+    FILE *fp = NULL;
+    int ok = 0;
+
+    if (snprintf(tmpFile, sizeof(tmpFile), "%s.tmp", cacheFile) >= (int)sizeof(tmpFile))
+    {
+        return;
+    }
+
+    fp = fopen(tmpFile, "wb");
+    if (fp == NULL)
+    {
+        return;
+    }
+
+    MYKONOS_armImageCacheHeader(header, binStat, polarity);
+    ok = (fwrite(header, sizeof(header), 1, fp) == 1) && (fwrite(image->words, image->numWords * 3, 1, fp) == 1);
+    ok = (fclose(fp) == 0) && ok;
+
+    /* a missing cache only costs the next open an encode */
+    if (!ok || (rename(tmpFile, cacheFile) != 0))
+    {
+        remove(tmpFile);
+    }
+}
+
+/**
+ * \brief Encodes an ARM program memory image into the SPI writes that load it
+ *
+ * Builds the same writes as MYKONOS_loadArmConcurrent(): auto increment ARM address at
+ * MYKONOS_ADDR_ARM_START_PROG_ADDR, the program memory through the ARM data registers, the
+ * stack pointer and boot address taken from the top of the image and the ARM run bit. Use it
+ * for images already in memory; MYKONOS_armImageOpen() encodes a .bin file.
+ *
+ * <B>Dependencies</B>
+ * - device->spiSettings (16 bit instruction word, write bit polarity)
+ *
+ * \param device Structure pointer to the Mykonos data structure the image is built for
+ * \param image Image to fill in, released with MYKONOS_armImageClose()
+ * \param binary Byte array containing ARM program memory data bytes (directly from .bin file)
+ * \param count Number of bytes in binary
+ *
+ * \retval MYKONOS_ERR_ARMIMAGE_NULL_PARAM device, image or binary is NULL
+ * \retval MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT count is not MYK_ARMIMAGE_BINARY_SIZE
+ * \retval MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS the device does not use the 16 bit instruction word
+ * \retval MYKONOS_ERR_ARMIMAGE_NO_MEMORY the stream could not be allocated
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_armImageFromBinary(mykonosDevice_t *device, mykonosArmImage_t *image, const uint8_t *binary, uint32_t count)
+{
+    uint32_t address = MYKONOS_ADDR_ARM_START_PROG_ADDR;
+    uint8_t dataHeader[4][3];
+    uint8_t *w = NULL;
+    uint32_t i = 0;
+
+    if ((device == NULL) || (image == NULL) || (binary == NULL))
+    {
+        return MYKONOS_ERR_ARMIMAGE_NULL_PARAM;
+    }
+
+    memset(image, 0, sizeof(*image));
+
+    if (count != MYK_ARMIMAGE_BINARY_SIZE)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT));
+        return MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT;
+    }
+
+    /* program memory byte i goes to ARM data register i % 4, only its data byte changes */
+    for (i = 0; i < 4; i++)
+    {
+        if (CMB_SPIEncodeWrite(device->spiSettings, (MYKONOS_ADDR_ARM_DATA_BYTE_0 | (((address & 0x3) + i) % 4)), 0, dataHeader[i]))
+        {
+            CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS,
+                    getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS));
+            return MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS;
+        }
+    }
+
+    image->wordsBuf = (uint8_t *)malloc(MYK_ARMIMAGE_NUM_WORDS * 3);
+    if (image->wordsBuf == NULL)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_NO_MEMORY,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_NO_MEMORY));
+        return MYKONOS_ERR_ARMIMAGE_NO_MEMORY;
+    }
+
+    w = image->wordsBuf;
+
+    /* set auto increment address bit and the start address */
+    CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_CTL_1, 0x8C, w);
+    CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_ADDR_BYTE_0, (uint8_t)(address >> 2), w + 3);
+    CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_ADDR_BYTE_1, (uint8_t)(address >> 10), w + 6);
+    w += 9;
+
+    for (i = 0; i < count; i++)
+    {
+        w[0] = dataHeader[i & 0x3][0];
+        w[1] = dataHeader[i & 0x3][1];
+        w[2] = binary[i];
+        w += 3;
+    }
+
+    /* stack pointer and boot address from the top of the image, then the ARM run bit */
+    for (i = 0; i < 4; i++)
+    {
+        CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_STACK_PTR_BYTE_0 + i, binary[i], w);
+        w += 3;
+    }
+    for (i = 0; i < 4; i++)
+    {
+        CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_BOOT_ADDR_BYTE_0 + i, binary[4 + i], w);
+        w += 3;
+    }
+    CMB_SPIEncodeWrite(device->spiSettings, MYKONOS_ADDR_ARM_CTL_1, 0x8D, w);
+
+    image->words = image->wordsBuf;
+    image->numWords = MYK_ARMIMAGE_NUM_WORDS;
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Maps an ARM .bin file and encodes it, or maps the stream cached for it
+ *
+ * With cacheFile set, a cache written for the same .bin (size and modification time) and the
+ * same write bit polarity is mapped and the .bin is not read at all. Otherwise the .bin is
+ * mapped, encoded as by MYKONOS_armImageFromBinary() and the stream is saved to cacheFile for
+ * the next open; failing to save it is not an error.
+ *
+ * <B>Dependencies</B>
+ * - device->spiSettings (16 bit instruction word, write bit polarity)
+ *
+ * \param device Structure pointer to the Mykonos data structure the image is built for
+ * \param image Image to fill in, released with MYKONOS_armImageClose()
+ * \param binFile Path of the ARM .bin file
+ * \param cacheFile Path of the stream cache, NULL = no cache
+ *
+ * \retval MYKONOS_ERR_ARMIMAGE_NULL_PARAM device, image or binFile is NULL
+ * \retval MYKONOS_ERR_ARMIMAGE_OPEN_FAILED binFile could not be opened or mapped
+ * \retval MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT binFile is not MYK_ARMIMAGE_BINARY_SIZE bytes
+ * \retval MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS the device does not use the 16 bit instruction word
+ * \retval MYKONOS_ERR_ARMIMAGE_NO_MEMORY the stream could not be allocated
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_armImageOpen(mykonosDevice_t *device, mykonosArmImage_t *image, const char *binFile, const char *cacheFile)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    struct stat binStat;
+    uint8_t polarity = 0;
+    void *binMap = NULL;
+    int fd = -1;
+
+    if ((device == NULL) || (image == NULL) || (binFile == NULL))
+    {
+        return MYKONOS_ERR_ARMIMAGE_NULL_PARAM;
+    }
+
+#if (MYKONOS_VERBOSE == 1)
+    CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_armImageOpen()\n");
+#endif
+
+    memset(image, 0, sizeof(*image));
+    polarity = device->spiSettings->writeBitPolarity & 0x01;
+
+    fd = open(binFile, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &binStat) != 0))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_OPEN_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_OPEN_FAILED));
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    if (binStat.st_size != MYK_ARMIMAGE_BINARY_SIZE)
+    {
+        close(fd);
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT));
+        return MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT;
+    }
+
+    if (device->spiSettings->longInstructionWord && (cacheFile != NULL) &&
+        (MYKONOS_armImageMapCache(image, cacheFile, &binStat, polarity) == MYKONOS_ERR_OK))
+    {
+        close(fd);
+        return MYKONOS_ERR_OK;
+    }
+
+    binMap = mmap(NULL, MYK_ARMIMAGE_BINARY_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (binMap == MAP_FAILED)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_OPEN_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_OPEN_FAILED));
+        return MYKONOS_ERR_ARMIMAGE_OPEN_FAILED;
+    }
+
+    madvise(binMap, MYK_ARMIMAGE_BINARY_SIZE, MADV_SEQUENTIAL);
+    retVal = MYKONOS_armImageFromBinary(device, image, (const uint8_t *)binMap, MYK_ARMIMAGE_BINARY_SIZE);
+    munmap(binMap, MYK_ARMIMAGE_BINARY_SIZE);
+
+    if ((retVal == MYKONOS_ERR_OK) && (cacheFile != NULL))
+    {
+        MYKONOS_armImageSaveCache(image, cacheFile, &binStat, polarity);
+    }
+
+    return retVal;
+}
+
+/**
+ * \brief Releases the stream of an image
+ *
+ * \param image Image filled in by MYKONOS_armImageOpen() or MYKONOS_armImageFromBinary()
+ *
+ * \retval MYKONOS_ERR_ARMIMAGE_NULL_PARAM image is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_armImageClose(mykonosArmImage_t *image)
+{
+    if (image == NULL)
+    {
+        return MYKONOS_ERR_ARMIMAGE_NULL_PARAM;
+    }
+
+    if (image->cacheMap != NULL)
+    {
+        munmap(image->cacheMap, image->cacheMapSize);
+    }
+    free(image->wordsBuf);
+    memset(image, 0, sizeof(*image));
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Loads an encoded ARM image into the ARM program memory and starts the ARM
+ *
+ * Sends the image's stream through CMB_SPIWriteEncoded(), the same writes as
+ * MYKONOS_loadArmConcurrent() without building them again.
+ *
+ * \pre MYKONOS_initArm() function must be called before calling this API.
+ *
+ * \post after calling this function the user must verify:
+ * Arm Checksum using MYKONOS_verifyArmChecksum(mykonosDevice_t *device)
+ * verify ARM state is in MYKONOS_ARM_READY state using MYKONOS_checkArmState(device, MYK_ARM_READY);
+ *
+ * <B>Dependencies</B>
+ * - device->spiSettings->chipSelectIndex
+ * - device->spiSettings
+ *
+ * \param device Structure pointer to the Mykonos data structure containing settings
+ * \param image Image built for these SPI settings
+ *
+ * \retval MYKONOS_ERR_ARMIMAGE_NULL_PARAM device or image is NULL, or image was not opened
+ * \retval MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS the image was encoded with another write bit polarity
+ * \retval MYKONOS_ERR_ARMIMAGE_WRITE_FAILED the SPI writes failed
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_loadArmImage(mykonosDevice_t *device, const mykonosArmImage_t *image)
+{
+    if ((device == NULL) || (image == NULL) || (image->words == NULL))
+    {
+        return MYKONOS_ERR_ARMIMAGE_NULL_PARAM;
+    }
+
+#if (MYKONOS_VERBOSE == 1)
+    CMB_writeToLog(ADIHAL_LOG_MESSAGE, device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_loadArmImage()\n");
+#endif
+
+    if (!device->spiSettings->longInstructionWord || ((image->words[0] >> 7) != (device->spiSettings->writeBitPolarity & 0x01)))
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS));
+        return MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS;
+    }
+
+    if (CMB_SPIWriteEncoded(device->spiSettings, image->words, image->numWords) != COMMONERR_OK)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, device->spiSettings->chipSelectIndex, MYKONOS_ERR_ARMIMAGE_WRITE_FAILED,
+                getMykonosErrorMessage(MYKONOS_ERR_ARMIMAGE_WRITE_FAILED));
+        return MYKONOS_ERR_ARMIMAGE_WRITE_FAILED;
+    }
+
+    return MYKONOS_ERR_OK;
+}
@@ -0,0 +1,52 @@
+/*!
+ * \file mykonos_armload.h
+ * \brief Contains type definitions and function prototypes for mykonos_armload.c,
+ *        ARM firmware loads sent from a precomputed SPI write stream
+ */
+
+#ifndef MYKONOSARMLOAD_H_
+#define MYKONOSARMLOAD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "t_mykonos.h"
+
+/* size of the ARM program memory image (.bin file) */
+#define MYK_ARMIMAGE_BINARY_SIZE    98304
+
+/* writes of a load: ARM address setup, program memory, stack pointer, boot address, run bit */
+#define MYK_ARMIMAGE_NUM_WORDS      (3 + MYK_ARMIMAGE_BINARY_SIZE + 4 + 4 + 1)
+
+/**
+ * \brief ARM firmware encoded once as the SPI writes that load it
+ *
+ * The stream holds every write MYKONOS_loadArmConcurrent() would send, encoded for the device
+ * the image was opened for (write bit polarity), so a load hands it to the HAL as it is. An
+ * image may be loaded into any number of devices with the same SPI settings, from several
+ * threads at once.
+ */
+typedef struct mykonosArmImage
+{
+    const uint8_t *words;           /*!< numWords x 3 byte SPI words */
+    uint32_t numWords;
+    uint8_t fromCache;              /*!< 1 = words mapped from the cache file, the .bin was not read */
+
+    /* private */
+    void *cacheMap;                 /*!< mmap of the cache file, NULL when words is allocated */
+    size_t cacheMapSize;
+    uint8_t *wordsBuf;              /*!< allocated stream, NULL when mapped */
+} mykonosArmImage_t;
+
+mykonosErr_t MYKONOS_armImageOpen(mykonosDevice_t *device, mykonosArmImage_t *image, const char *binFile, const char *cacheFile);
+mykonosErr_t MYKONOS_armImageFromBinary(mykonosDevice_t *device, mykonosArmImage_t *image, const uint8_t *binary, uint32_t count);
+mykonosErr_t MYKONOS_armImageClose(mykonosArmImage_t *image);
+mykonosErr_t MYKONOS_loadArmImage(mykonosDevice_t *device, const mykonosArmImage_t *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYKONOSARMLOAD_H_ */
@@ -0,0 +1,408 @@
+/**
+ *\file mykonos_fleet.c
+ *
+ *\brief Brings up several Mykonos devices at once. The SPI heavy steps of each device run
+ *       in their own thread, the devices only wait for each other where SYSREF has to reach
+ *       all of them (multichip sync and JESD link-up).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "common.h"
+#include "HAL.h"
+#include "mykonos.h"
+#include "mykonos_armload.h"
+#include "mykonos_fleet.h"
+
+typedef mykonosErr_t (*mykonosFleetStep_t)(mykonosFleet_t *fleet, mykonosFleetDevice_t *dev);
+
+typedef struct
+{
+    mykonosFleet_t *fleet;
+    mykonosFleetDevice_t *dev;
+    mykonosFleetStep_t step;
+    pthread_t thread;
+} mykonosFleetWorker_t;
+
+static mykonosErr_t MYKONOS_fleetFail(mykonosFleetDevice_t *dev, mykonosErr_t errorCode)
+{
+    CMB_writeToLog(ADIHAL_LOG_ERROR, dev->device->spiSettings->chipSelectIndex, errorCode, getMykonosErrorMessage(errorCode));
+    return errorCode;
+}
+
+/* reset, initialize, wait for the CLKPLL and arm multichip sync */
+static mykonosErr_t MYKONOS_fleetInitStep(mykonosFleet_t *fleet, mykonosFleetDevice_t *dev)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    uint8_t pllLockStatus = 0;
+
+    (void)fleet;
+
+    if ((retVal = MYKONOS_resetDevice(dev->device)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if ((retVal = MYKONOS_initialize(dev->device)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if ((retVal = MYKONOS_checkPllsLockStatus(dev->device, &pllLockStatus)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if ((pllLockStatus & 0x01) == 0)
+    {
+        return MYKONOS_fleetFail(dev, MYKONOS_ERR_FLEET_CLKPLL_LOCK);
+    }
+
+    return MYKONOS_enableMultichipSync(dev->device, 1, NULL);
+}
+
+/* check MCS, load the ARM, tune the RF PLLs, run the init cals and let SYSREF through to the JESD blocks */
+static mykonosErr_t MYKONOS_fleetArmStep(mykonosFleet_t *fleet, mykonosFleetDevice_t *dev)
+{
+    mykonosDevice_t *device = dev->device;
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    uint8_t pllLockStatus = 0;
+    uint8_t pllLockMask = 0x01;
+
+    if ((retVal = MYKONOS_enableMultichipSync(device, 0, &dev->mcsStatus)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if ((dev->mcsStatus & MYK_FLEET_MCS_STATUS_DONE) != MYK_FLEET_MCS_STATUS_DONE)
+    {
+        return MYKONOS_fleetFail(dev, MYKONOS_ERR_FLEET_MCS_FAILED);
+    }
+
+    if ((retVal = MYKONOS_initArm(device)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if (dev->armImage != NULL)
+    {
+        retVal = MYKONOS_loadArmImage(device, dev->armImage);
+    }
+    else
+    {
+        retVal = MYKONOS_loadArmConcurrent(device, dev->armBinary, dev->armBinarySize);
+    }
+
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if (device->profilesValid & RX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_setRfPllFrequency(device, RX_PLL, device->rx->rxPllLoFrequency_Hz)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+        pllLockMask |= 0x02;
+    }
+
+    if (device->profilesValid & TX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_setRfPllFrequency(device, TX_PLL, device->tx->txPllLoFrequency_Hz)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+        pllLockMask |= 0x04;
+    }
+
+    if (device->profilesValid & SNIFF_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_setRfPllFrequency(device, SNIFFER_PLL, device->obsRx->snifferPllLoFrequency_Hz)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+        pllLockMask |= 0x08;
+    }
+
+    if ((retVal = MYKONOS_checkPllsLockStatus(device, &pllLockStatus)) != MYKONOS_ERR_OK)
+    {
+        return retVal;
+    }
+
+    if ((pllLockStatus & pllLockMask) != pllLockMask)
+    {
+        return MYKONOS_fleetFail(dev, MYKONOS_ERR_FLEET_RFPLL_LOCK);
+    }
+
+    if (dev->initCalMask != 0)
+    {
+        if ((retVal = MYKONOS_runInitCals(device, dev->initCalMask)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+
+        if ((retVal = MYKONOS_waitInitCals(device, fleet->initCalTimeout_ms, &dev->calErrorFlag, &dev->calErrorCode)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+
+        if ((dev->calErrorFlag != 0) || (dev->calErrorCode != 0))
+        {
+            return MYKONOS_fleetFail(dev, MYKONOS_ERR_FLEET_INITCALS_FAILED);
+        }
+    }
+
+    if (device->profilesValid & RX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_enableSysrefToRxFramer(device, 1)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    if (device->profilesValid & ORX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_enableSysrefToObsRxFramer(device, 1)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    if (device->profilesValid & TX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_enableSysrefToDeframer(device, 1)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/* read back the JESD links, start tracking and turn the radio on */
+static mykonosErr_t MYKONOS_fleetRadioStep(mykonosFleet_t *fleet, mykonosFleetDevice_t *dev)
+{
+    mykonosDevice_t *device = dev->device;
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    (void)fleet;
+
+    if (device->profilesValid & RX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_readRxFramerStatus(device, &dev->framerStatus)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    if (device->profilesValid & ORX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_readOrxFramerStatus(device, &dev->obsFramerStatus)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    if (device->profilesValid & TX_PROFILE_VALID)
+    {
+        if ((retVal = MYKONOS_readDeframerStatus(device, &dev->deframerStatus)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    if (dev->trackingCalMask != 0)
+    {
+        if ((retVal = MYKONOS_enableTrackingCals(device, dev->trackingCalMask)) != MYKONOS_ERR_OK)
+        {
+            return retVal;
+        }
+    }
+
+    return MYKONOS_radioOn(device);
+}
+
+static void *MYKONOS_fleetWorker(void *arg)
+{
+    mykonosFleetWorker_t *worker = (mykonosFleetWorker_t *)arg;
+
+    worker->dev->status = worker->step(worker->fleet, worker->dev);
+    return NULL;
+}
+
+/* Devices can run at the same time only when each one has its own HAL context on its own
+   SPI core and register block. Two contexts pointing at the same spiBase would share one SPI
+   FIFO, the same regBase one reset and GPIO register set. */
+static int MYKONOS_fleetIsParallel(mykonosFleet_t *fleet)
+{
+    halContext_t *ctx = NULL;
+    halContext_t *other = NULL;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        ctx = fleet->devices[i].device->spiSettings->halContext;
+        if (ctx == NULL)
+        {
+            return 0;
+        }
+
+        for (j = 0; j < i; j++)
+        {
+            other = fleet->devices[j].device->spiSettings->halContext;
+            if ((other->spiBase == ctx->spiBase) || (other->regBase == ctx->regBase))
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* Runs step on every device still without error and waits until all are done */
+static void MYKONOS_fleetRunStep(mykonosFleet_t *fleet, mykonosFleetStage_t stage, mykonosFleetStep_t step, int parallel)
+{
+    mykonosFleetWorker_t workers[MYK_FLEET_MAX_DEVICES];
+    uint8_t started[MYK_FLEET_MAX_DEVICES] = {0};
+    uint32_t i = 0;
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        if (fleet->devices[i].status != MYKONOS_ERR_OK)
+        {
+            continue;
+        }
+
+        workers[i].fleet = fleet;
+        workers[i].dev = &fleet->devices[i];
+        workers[i].step = step;
+        workers[i].dev->stage = stage;
+
+        if (parallel && (pthread_create(&workers[i].thread, NULL, MYKONOS_fleetWorker, &workers[i]) == 0))
+        {
+            started[i] = 1;
+        }
+        else
+        {
+            /* serial bring-up, or no thread available: run it here */
+            MYKONOS_fleetWorker(&workers[i]);
+        }
+    }
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+}
+
+/* SYSREF barrier: every device still running has finished the step before */
+static mykonosErr_t MYKONOS_fleetSysref(mykonosFleet_t *fleet, mykonosFleetStage_t stage)
+{
+    uint32_t i = 0;
+    uint32_t running = 0;
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        if (fleet->devices[i].status == MYKONOS_ERR_OK)
+        {
+            fleet->devices[i].stage = stage;
+            running++;
+        }
+    }
+
+    if ((running == 0) || (fleet->requestSysref == NULL))
+    {
+        return MYKONOS_ERR_OK;
+    }
+
+    if (fleet->requestSysref(fleet->userData, stage) != 0)
+    {
+        for (i = 0; i < fleet->numDevices; i++)
+        {
+            if (fleet->devices[i].status == MYKONOS_ERR_OK)
+            {
+                fleet->devices[i].status = MYKONOS_fleetFail(&fleet->devices[i], MYKONOS_ERR_FLEET_SYSREF_FAILED);
+            }
+        }
+        return MYKONOS_ERR_FLEET_SYSREF_FAILED;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Brings up all devices of the fleet, from reset to radio on
+ *
+ * Each device goes through MYKONOS_resetDevice, MYKONOS_initialize, multichip sync,
+ * MYKONOS_initArm, MYKONOS_loadArmConcurrent (or MYKONOS_loadArmImage), RF PLL tuning,
+ * init cals, JESD SYSREF enables, tracking cals and MYKONOS_radioOn. The steps between the two SYSREF barriers
+ * run in one thread per device when every device has its own spiSettings->halContext,
+ * one device after the other otherwise. A device that fails stops there, the others go on.
+ *
+ * <B>Dependencies</B>
+ * - devices[].device fully configured, as for MYKONOS_initialize
+ * - requestSysref able to send SYSREF to every device of the fleet
+ *
+ * \param fleet Devices and bring-up settings, devices[].status/stage/... are filled in
+ *
+ * \retval MYKONOS_ERR_FLEET_INV_PARAM fleet is NULL, empty or has more than MYK_FLEET_MAX_DEVICES devices
+ * \retval MYKONOS_ERR_FLEET_DEVICE_FAILED at least one device did not reach MYK_FLEET_STAGE_DONE, see devices[].status
+ * \retval MYKONOS_ERR_OK Function completed successfully, all devices are up
+ */
+mykonosErr_t MYKONOS_fleetBringUp(mykonosFleet_t *fleet)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    uint32_t i = 0;
+    int parallel = 0;
+
+    if ((fleet == NULL) || (fleet->devices == NULL) || (fleet->numDevices == 0) || (fleet->numDevices > MYK_FLEET_MAX_DEVICES))
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, 0, MYKONOS_ERR_FLEET_INV_PARAM, getMykonosErrorMessage(MYKONOS_ERR_FLEET_INV_PARAM));
+        return MYKONOS_ERR_FLEET_INV_PARAM;
+    }
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        if ((fleet->devices[i].device == NULL) || (fleet->devices[i].device->spiSettings == NULL))
+        {
+            CMB_writeToLog(ADIHAL_LOG_ERROR, 0, MYKONOS_ERR_FLEET_INV_PARAM, getMykonosErrorMessage(MYKONOS_ERR_FLEET_INV_PARAM));
+            return MYKONOS_ERR_FLEET_INV_PARAM;
+        }
+
+        fleet->devices[i].status = MYKONOS_ERR_OK;
+        fleet->devices[i].stage = MYK_FLEET_STAGE_NONE;
+    }
+
+#if (MYKONOS_VERBOSE == 1)
+    CMB_writeToLog(ADIHAL_LOG_MESSAGE, fleet->devices[0].device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_fleetBringUp()\n");
+#endif
+
+    parallel = MYKONOS_fleetIsParallel(fleet);
+
+    MYKONOS_fleetRunStep(fleet, MYK_FLEET_STAGE_INIT, MYKONOS_fleetInitStep, parallel);
+    MYKONOS_fleetSysref(fleet, MYK_FLEET_STAGE_MCS_SYSREF);
+    MYKONOS_fleetRunStep(fleet, MYK_FLEET_STAGE_ARM, MYKONOS_fleetArmStep, parallel);
+    MYKONOS_fleetSysref(fleet, MYK_FLEET_STAGE_JESD_SYSREF);
+    MYKONOS_fleetRunStep(fleet, MYK_FLEET_STAGE_RADIO, MYKONOS_fleetRadioStep, parallel);
+
+    for (i = 0; i < fleet->numDevices; i++)
+    {
+        if (fleet->devices[i].status == MYKONOS_ERR_OK)
+        {
+            fleet->devices[i].stage = MYK_FLEET_STAGE_DONE;
+        }
+        else
+        {
+            retVal = MYKONOS_ERR_FLEET_DEVICE_FAILED;
+        }
+    }
+
+    return retVal;
+}
@@ -0,0 +1,84 @@
+/*!
+ * \file mykonos_fleet.h
+ * \brief Contains type definitions and function prototypes for mykonos_fleet.c,
+ *        bring-up of several Mykonos devices that share SYSREF
+ */
+
+#ifndef MYKONOSFLEET_H_
+#define MYKONOSFLEET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "t_mykonos.h"
+
+/* largest fleet MYKONOS_fleetBringUp() accepts */
+#define MYK_FLEET_MAX_DEVICES       8
+
+/* MCS status bits that must be set after the MCS SYSREF pulses (JESD SYSREF, digital clocks,
+   internal digital sync), see MYKONOS_enableMultichipSync() */
+#define MYK_FLEET_MCS_STATUS_DONE   0x0B
+
+/**
+ * \brief Steps of MYKONOS_fleetBringUp(). The *_SYSREF steps are barriers: all devices
+ *        finish the step before and the board issues SYSREF once for all of them.
+ */
+typedef enum
+{
+    MYK_FLEET_STAGE_NONE = 0,
+    MYK_FLEET_STAGE_INIT,           /*!< reset, MYKONOS_initialize, CLKPLL lock, MCS armed */
+    MYK_FLEET_STAGE_MCS_SYSREF,     /*!< SYSREF pulses for multichip sync */
+    MYK_FLEET_STAGE_ARM,            /*!< MCS status, ARM load, RF PLLs, init cals, SYSREF to the JESD framers/deframer */
+    MYK_FLEET_STAGE_JESD_SYSREF,    /*!< SYSREF pulses for JESD link-up */
+    MYK_FLEET_STAGE_RADIO,          /*!< tracking cals, radio on */
+    MYK_FLEET_STAGE_DONE
+} mykonosFleetStage_t;
+
+/**
+ * \brief One device of the fleet with its bring-up settings and result
+ */
+typedef struct
+{
+    mykonosDevice_t *device;        /*!< device to bring up. Give it its own spiSettings->halContext, with its own spiBase and regBase (and pollPolicy), to init it in parallel with the others */
+    uint8_t *armBinary;             /*!< ARM firmware image */
+    uint32_t armBinarySize;         /*!< size of armBinary in bytes */
+    const struct mykonosArmImage *armImage; /*!< encoded firmware (MYKONOS_armImageOpen()) loaded instead of armBinary, NULL = armBinary */
+    uint32_t initCalMask;           /*!< MYKONOS_runInitCals() mask, 0 = no init cals */
+    uint32_t trackingCalMask;       /*!< MYKONOS_enableTrackingCals() mask, 0 = tracking cals left as they are */
+
+    mykonosErr_t status;            /*!< output: MYKONOS_ERR_OK or the first error of this device */
+    mykonosFleetStage_t stage;      /*!< output: last step reached, MYK_FLEET_STAGE_DONE on success */
+    uint8_t mcsStatus;              /*!< output: MCS status read after the MCS SYSREF */
+    uint8_t calErrorFlag;           /*!< output: MYKONOS_waitInitCals() error flag */
+    uint8_t calErrorCode;           /*!< output: MYKONOS_waitInitCals() error code */
+    uint8_t framerStatus;           /*!< output: Rx framer status after the JESD SYSREF */
+    uint8_t obsFramerStatus;        /*!< output: ORx framer status after the JESD SYSREF */
+    uint8_t deframerStatus;         /*!< output: deframer status after the JESD SYSREF */
+} mykonosFleetDevice_t;
+
+/**
+ * \brief Board hook that issues SYSREF to every device of the fleet for the given barrier
+ *        (MYK_FLEET_STAGE_MCS_SYSREF or MYK_FLEET_STAGE_JESD_SYSREF). Returns 0 on success.
+ */
+typedef int (*mykonosFleetSysrefFn_t)(void *userData, mykonosFleetStage_t stage);
+
+/**
+ * \brief Fleet bring-up settings
+ */
+typedef struct
+{
+    mykonosFleetDevice_t *devices;  /*!< devices to bring up */
+    uint32_t numDevices;            /*!< number of entries in devices[] */
+    mykonosFleetSysrefFn_t requestSysref; /*!< SYSREF hook, NULL = SYSREF runs continuously */
+    void *userData;                 /*!< passed to requestSysref */
+    uint32_t initCalTimeout_ms;     /*!< MYKONOS_waitInitCals() timeout of each device */
+} mykonosFleet_t;
+
+mykonosErr_t MYKONOS_fleetBringUp(mykonosFleet_t *fleet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYKONOSFLEET_H_ */
@@ -0,0 +1,315 @@
+/**
+ *\file mykonos_initcal.c
+ *
+ *\brief Runs the init calibrations of a device without blocking the caller. The RUNINIT
+ *       command status is read one poll at a time, by a worker thread or by the
+ *       application's event loop, and the end of the run is reported through a callback.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "common.h"
+#include "mykonos.h"
+#include "mykonos_initcal.h"
+#include "mykonos_macros.h"
+
+/* ARM error flag of a RUNINIT command whose calibration failed */
+#define MYK_INITCAL_CAL_ERROR       0x07
+
+/* moves the job to its final state and tells the application */
+static void MYKONOS_initCalFinish(mykonosInitCalJob_t *job, mykonosInitCalState_t state, mykonosErr_t status)
+{
+    job->status = status;
+    if (status != MYKONOS_ERR_OK)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, job->device->spiSettings->chipSelectIndex, status, getMykonosErrorMessage(status));
+    }
+
+    __atomic_store_n(&job->state, state, __ATOMIC_RELEASE);
+
+    if (job->onDone != NULL)
+    {
+        job->onDone(job, job->userData);
+    }
+}
+
+static void *MYKONOS_initCalWorker(void *arg)
+{
+    mykonosInitCalJob_t *job = (mykonosInitCalJob_t *)arg;
+    uint32_t next_us = 0;
+
+    while (MYKONOS_stepInitCalsAsync(job, &next_us) == MYKONOS_ERR_OK)
+    {
+        if (job->state != MYK_INITCAL_RUNNING)
+        {
+            break;
+        }
+
+        /* the GP interrupt ends the pause early, see MYKONOS_enableWaitInterrupt */
+        CMB_pollWait_us(job->device->spiSettings, next_us, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Starts the init calibrations and returns while they run
+ *
+ * Sends MYKONOS_runInitCals(job->calMask). From then on the job reads the RUNINIT command
+ * status every MYK_INITCAL_POLL_US, and MYKONOS_getInitCalStatus() every
+ * job->progressInterval_ms to call job->onProgress. When the cals complete, fail, time out
+ * or are aborted, job->state, status, errorFlag and errorCode are set and job->onDone is
+ * called. With useWorker a thread started here drives the job; otherwise the application
+ * calls MYKONOS_stepInitCalsAsync() until job->state is no longer MYK_INITCAL_RUNNING.
+ * Either way MYKONOS_waitInitCalsAsync() must be called once before the job is reused or
+ * freed, it returns at once when the job has already ended.
+ *
+ * <B>Dependencies</B>
+ * - job->device->spiSettings->chipSelectIndex
+ * - ARM loaded, as for MYKONOS_runInitCals()
+ *
+ * \param job Job settings (device, calMask, timeout_ms, callbacks), the rest is filled in
+ * \param useWorker 1 = drive the job from a worker thread, 0 = from MYKONOS_stepInitCalsAsync()
+ *
+ * \retval MYKONOS_ERR_INITCALASYNC_NULL_PARAM job or job->device is NULL
+ * \retval MYKONOS_ERR_INITCALASYNC_BUSY job is still running
+ * \retval MYKONOS_ERR_INITCALASYNC_THREAD_FAILED the cals run but the worker could not be
+ *         started, drive the job with MYKONOS_stepInitCalsAsync() or MYKONOS_waitInitCalsAsync()
+ * \retval MYKONOS_ERR_OK Function completed successfully, the cals are running
+ */
+mykonosErr_t MYKONOS_runInitCalsAsync(mykonosInitCalJob_t *job, uint8_t useWorker)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+
+    if ((job == NULL) || (job->device == NULL))
+    {
+        return MYKONOS_ERR_INITCALASYNC_NULL_PARAM;
+    }
+
+#if (MYKONOS_VERBOSE == 1)
+    CMB_writeToLog(ADIHAL_LOG_MESSAGE, job->device->spiSettings->chipSelectIndex, MYKONOS_ERR_OK, "MYKONOS_runInitCalsAsync()\n");
+#endif
+
+    if ((job->state == MYK_INITCAL_RUNNING) || job->worker)
+    {
+        CMB_writeToLog(ADIHAL_LOG_ERROR, job->device->spiSettings->chipSelectIndex, MYKONOS_ERR_INITCALASYNC_BUSY,
+                getMykonosErrorMessage(MYKONOS_ERR_INITCALASYNC_BUSY));
+        return MYKONOS_ERR_INITCALASYNC_BUSY;
+    }
+
+    job->status = MYKONOS_ERR_OK;
+    job->errorFlag = 0;
+    job->errorCode = 0;
+    job->polls = 0;
+    __atomic_store_n(&job->abort, 0, __ATOMIC_RELAXED);
+    job->worker = 0;
+
+    retVal = MYKONOS_runInitCals(job->device, job->calMask);
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        job->state = MYK_INITCAL_FAILED;
+        job->status = retVal;
+        return retVal;
+    }
+
+    CMB_deadlineStart_ms(&job->deadline, job->timeout_ms);
+    CMB_deadlineStart_ms(&job->nextProgress, job->progressInterval_ms);
+    job->state = MYK_INITCAL_RUNNING;
+
+    if (useWorker)
+    {
+        if (pthread_create(&job->thread, NULL, MYKONOS_initCalWorker, job) != 0)
+        {
+            CMB_writeToLog(ADIHAL_LOG_ERROR, job->device->spiSettings->chipSelectIndex, MYKONOS_ERR_INITCALASYNC_THREAD_FAILED,
+                    getMykonosErrorMessage(MYKONOS_ERR_INITCALASYNC_THREAD_FAILED));
+            return MYKONOS_ERR_INITCALASYNC_THREAD_FAILED;
+        }
+        job->worker = 1;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Advances a job started without a worker by one status poll
+ *
+ * Does not wait: reads the RUNINIT command status once (plus MYKONOS_getInitCalStatus()
+ * when a progress read is due, or the cals just ended) and calls the job's callbacks from
+ * the calling thread. Call it again after *nextStep_us while job->state is
+ * MYK_INITCAL_RUNNING.
+ *
+ * <B>Dependencies</B>
+ * - job started by MYKONOS_runInitCalsAsync()
+ *
+ * \param job Running job
+ * \param nextStep_us Returns when to call again, NULL = not needed
+ *
+ * \retval MYKONOS_ERR_INITCALASYNC_NULL_PARAM job is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully, see job->state and job->status
+ */
+mykonosErr_t MYKONOS_stepInitCalsAsync(mykonosInitCalJob_t *job, uint32_t *nextStep_us)
+{
+    mykonosErr_t retVal = MYKONOS_ERR_OK;
+    uint8_t cmdStatusByte = 0;
+    uint32_t calsCompleted = 0;
+    uint32_t next_us = MYK_INITCAL_POLL_US;
+    uint32_t remaining_us = 0;
+
+    if (job == NULL)
+    {
+        return MYKONOS_ERR_INITCALASYNC_NULL_PARAM;
+    }
+
+    if (nextStep_us != NULL)
+    {
+        *nextStep_us = 0;
+    }
+
+    if (job->state != MYK_INITCAL_RUNNING)
+    {
+        return MYKONOS_ERR_OK;
+    }
+
+    if (__atomic_load_n(&job->abort, __ATOMIC_ACQUIRE))
+    {
+        retVal = MYKONOS_abortInitCals(job->device, &calsCompleted);
+        job->calStatus.calsDoneLastRun = calsCompleted;
+        MYKONOS_initCalFinish(job, MYK_INITCAL_ABORTED, retVal);
+        return MYKONOS_ERR_OK;
+    }
+
+    job->polls++;
+    retVal = MYKONOS_readArmCmdStatusByte(job->device, MYKONOS_ARM_RUNINIT_OPCODE, &cmdStatusByte);
+    if (retVal != MYKONOS_ERR_OK)
+    {
+        MYKONOS_initCalFinish(job, MYK_INITCAL_FAILED, retVal);
+        return MYKONOS_ERR_OK;
+    }
+
+    /* pending bit in [0], error flag in [3:1], as in MYKONOS_waitInitCals */
+    job->errorFlag = cmdStatusByte >> 1;
+    if (job->errorFlag == MYK_INITCAL_CAL_ERROR)
+    {
+        if (MYKONOS_getInitCalStatus(job->device, &job->calStatus) == MYKONOS_ERR_OK)
+        {
+            job->errorCode = job->calStatus.initErrCal;
+        }
+        MYKONOS_initCalFinish(job, MYK_INITCAL_FAILED, MYKONOS_ERR_WAIT_INITCALS_CALFAILED);
+        return MYKONOS_ERR_OK;
+    }
+    else if (job->errorFlag > 0)
+    {
+        MYKONOS_initCalFinish(job, MYK_INITCAL_FAILED, MYKONOS_ERR_WAIT_INITCALS_ARMERROR);
+        return MYKONOS_ERR_OK;
+    }
+
+    if ((cmdStatusByte & 0x01) == 0)
+    {
+        /* init cals are done, the ARM leaves the configuration registers alone again */
+        CMB_regShadowSuspend(job->device->spiSettings, 0);
+        MYKONOS_getInitCalStatus(job->device, &job->calStatus);
+        MYKONOS_initCalFinish(job, MYK_INITCAL_DONE, MYKONOS_ERR_OK);
+        return MYKONOS_ERR_OK;
+    }
+
+    if (CMB_deadlineExpired(&job->deadline))
+    {
+        MYKONOS_initCalFinish(job, MYK_INITCAL_TIMEOUT, MYKONOS_ERR_WAITARMCMDSTATUS_TIMEOUT);
+        return MYKONOS_ERR_OK;
+    }
+
+    if (job->progressInterval_ms > 0)
+    {
+        if (CMB_deadlineExpired(&job->nextProgress))
+        {
+            if (MYKONOS_getInitCalStatus(job->device, &job->calStatus) == MYKONOS_ERR_OK)
+            {
+                if (job->onProgress != NULL)
+                {
+                    job->onProgress(job, job->userData);
+                }
+            }
+            CMB_deadlineStart_ms(&job->nextProgress, job->progressInterval_ms);
+        }
+
+        remaining_us = CMB_deadlineRemaining_us(&job->nextProgress);
+        if (remaining_us < next_us)
+        {
+            next_us = remaining_us;
+        }
+    }
+
+    /* the last poll is at the timeout */
+    remaining_us = CMB_deadlineRemaining_us(&job->deadline);
+    if (remaining_us < next_us)
+    {
+        next_us = remaining_us;
+    }
+
+    if (nextStep_us != NULL)
+    {
+        *nextStep_us = next_us;
+    }
+
+    return MYKONOS_ERR_OK;
+}
+
+/**
+ * \brief Waits for the end of a job and releases its worker thread
+ *
+ * A job without a worker is stepped here until it ends. job->onDone has run when this returns.
+ *
+ * \param job Job started by MYKONOS_runInitCalsAsync()
+ *
+ * \retval MYKONOS_ERR_INITCALASYNC_NULL_PARAM job is NULL
+ * \retval job->status otherwise: MYKONOS_ERR_OK when the cals completed
+ */
+mykonosErr_t MYKONOS_waitInitCalsAsync(mykonosInitCalJob_t *job)
+{
+    uint32_t next_us = 0;
+
+    if (job == NULL)
+    {
+        return MYKONOS_ERR_INITCALASYNC_NULL_PARAM;
+    }
+
+    if (job->worker)
+    {
+        pthread_join(job->thread, NULL);
+        job->worker = 0;
+    }
+
+    while (job->state == MYK_INITCAL_RUNNING)
+    {
+        MYKONOS_stepInitCalsAsync(job, &next_us);
+        if (job->state == MYK_INITCAL_RUNNING)
+        {
+            CMB_pollWait_us(job->device->spiSettings, next_us, NULL);
+        }
+    }
+
+    return job->status;
+}
+
+/**
+ * \brief Asks a running job to abort its init calibrations
+ *
+ * Safe from any thread and from the callbacks. The thread driving the job sends
+ * MYKONOS_abortInitCals() at its next step, then the job ends in MYK_INITCAL_ABORTED.
+ *
+ * \param job Job started by MYKONOS_runInitCalsAsync()
+ *
+ * \retval MYKONOS_ERR_INITCALASYNC_NULL_PARAM job is NULL
+ * \retval MYKONOS_ERR_OK Function completed successfully
+ */
+mykonosErr_t MYKONOS_abortInitCalsAsync(mykonosInitCalJob_t *job)
+{
+    if (job == NULL)
+    {
+        return MYKONOS_ERR_INITCALASYNC_NULL_PARAM;
+    }
+
+    __atomic_store_n(&job->abort, 1, __ATOMIC_RELEASE);
+    return MYKONOS_ERR_OK;
+}
@@ -0,0 +1,82 @@
+/*!
+ * \file mykonos_initcal.h
+ * \brief Contains type definitions and function prototypes for mykonos_initcal.c,
+ *        init calibrations that run in the background and report through callbacks
+ */
+
+#ifndef MYKONOSINITCAL_H_
+#define MYKONOSINITCAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include "t_mykonos.h"
+#include "common.h"
+
+/* gap between two reads of the RUNINIT command status */
+#define MYK_INITCAL_POLL_US         10000
+
+/**
+ * \brief Where an init cal job is
+ */
+typedef enum
+{
+    MYK_INITCAL_IDLE = 0,           /*!< not started */
+    MYK_INITCAL_RUNNING,            /*!< the ARM is running the cals */
+    MYK_INITCAL_DONE,               /*!< every cal of calMask completed */
+    MYK_INITCAL_FAILED,             /*!< status holds the error, errorFlag / errorCode as from MYKONOS_waitInitCals() */
+    MYK_INITCAL_TIMEOUT,            /*!< timeout_ms passed, the ARM may still be running; MYKONOS_abortInitCals() stops it */
+    MYK_INITCAL_ABORTED             /*!< stopped by MYKONOS_abortInitCalsAsync(), calStatus.calsDoneLastRun holds the cals completed */
+} mykonosInitCalState_t;
+
+struct mykonosInitCalJob;
+
+/* called on the thread driving the job, see mykonosInitCalJob_t */
+typedef void (*mykonosInitCalCallback_t)(struct mykonosInitCalJob *job, void *userData);
+
+/**
+ * \brief One MYKONOS_runInitCals() run, owned by the caller until MYKONOS_waitInitCalsAsync() returned
+ *
+ * The job is driven either by its own worker thread or by the application calling
+ * MYKONOS_stepInitCalsAsync() from its event loop. While a worker drives it, no other thread
+ * may use the device; other devices are only safe to use from other threads when they are
+ * on another halContext (SPI core), as in MYKONOS_fleetBringUp().
+ */
+typedef struct mykonosInitCalJob
+{
+    mykonosDevice_t *device;        /*!< device to calibrate, ARM loaded and RF PLLs locked */
+    uint32_t calMask;               /*!< MYKONOS_runInitCals() mask */
+    uint32_t timeout_ms;            /*!< longest time the cals may take */
+    uint32_t progressInterval_ms;   /*!< MYKONOS_getInitCalStatus() period while running, 0 = no progress reads */
+    mykonosInitCalCallback_t onProgress; /*!< after each progress read, NULL = none */
+    mykonosInitCalCallback_t onDone; /*!< once, when the job leaves MYK_INITCAL_RUNNING, NULL = none */
+    void *userData;                 /*!< passed to the callbacks */
+
+    /* updated while the job runs */
+    volatile mykonosInitCalState_t state;
+    mykonosErr_t status;            /*!< MYKONOS_ERR_OK or the error that ended the job */
+    uint8_t errorFlag;              /*!< ARM error flag of the RUNINIT command, 0 = none */
+    uint8_t errorCode;              /*!< object ID of the failing cal */
+    mykonosInitCalStatus_t calStatus; /*!< last progress read, and the read done on completion */
+    uint32_t polls;                 /*!< command status reads */
+
+    /* private */
+    cmbDeadline_t deadline;
+    cmbDeadline_t nextProgress;
+    volatile uint8_t abort;         /*!< set by MYKONOS_abortInitCalsAsync() from any thread, __atomic access only */
+    uint8_t worker;                 /*!< 1 = thread started, joined by MYKONOS_waitInitCalsAsync() */
+    pthread_t thread;
+} mykonosInitCalJob_t;
+
+mykonosErr_t MYKONOS_runInitCalsAsync(mykonosInitCalJob_t *job, uint8_t useWorker);
+mykonosErr_t MYKONOS_stepInitCalsAsync(mykonosInitCalJob_t *job, uint32_t *nextStep_us);
+mykonosErr_t MYKONOS_waitInitCalsAsync(mykonosInitCalJob_t *job);
+mykonosErr_t MYKONOS_abortInitCalsAsync(mykonosInitCalJob_t *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYKONOSINITCAL_H_ */
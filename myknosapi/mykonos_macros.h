@@ -639,6 +639,9 @@ extern "C" {
 #define MYKONOS_ADDR_PFIR_COEFF_DATA                        0xE00
 #define MYKONOS_ADDR_PFIR_COEFF_ADDR                        0xE01
 
+/* number of registers (0x000 - 0xEFF) covered by the mykonosMmap[] reset defaults */
+#define MYKONOS_MMAP_SIZE                                   0xF00
+
 /* ARM memory */
 #define MYKONOS_ADDR_ARM_START_PROG_ADDR					0x01000000
 #define MYKONOS_ADDR_ARM_END_PROG_ADDR						0x01017FFF
@@ -24,6 +24,13 @@ extern "C" {
 #define MYKONOS_VERBOSE 1
 #define MYK_ENABLE_SPIWRITEARRAY 1
 
+/* defaults of the status poll pacing, see mykonosPollPolicy_t */
+#define MYK_POLL_INITIAL_DELAY_PCT      75      /* first poll at 75% of the learned completion time */
+#define MYK_POLL_EVENT_MIN_INTERVAL_US  10      /* PLL lock / cal done, MYKONOS_waitForEvent() */
+#define MYK_POLL_EVENT_MAX_INTERVAL_US  1000
+#define MYK_POLL_ARMCMD_MIN_INTERVAL_US 20      /* ARM opcodes, MYKONOS_waitArmCmdStatus() */
+#define MYK_POLL_ARMCMD_MAX_INTERVAL_US 10000
+
 /* 3 Bytes per SPI transaction * 341 transactions = ~1024 byte buffer size */
 /* Minimum MYK_SPIWRITEARRAY_BUFFERSIZE = 27 */
 #define MYK_SPIWRITEARRAY_BUFFERSIZE 341
@@ -17,7 +17,7 @@ void spi_write(unsigned short addr, char data)
 char spi_read(unsigned short addr)
 {
 	char buf[3];
-	unsigned int data;
+	unsigned int data = 0;
 	addr |= 0x8000;
 	spi_build_buffer(addr, 0, buf);
 	HAL_spiRead(buf, sizeof(buf), &data);
@@ -563,6 +563,33 @@ typedef enum
 
 	MYKONOS_ERR_CLGCATTENTUNCFGGET_NULL_ATTRANGECFGSTRUCT,
 
+	MYKONOS_ERR_FLEET_INV_PARAM,
+	MYKONOS_ERR_FLEET_DEVICE_FAILED,
+	MYKONOS_ERR_FLEET_CLKPLL_LOCK,
+	MYKONOS_ERR_FLEET_RFPLL_LOCK,
+	MYKONOS_ERR_FLEET_MCS_FAILED,
+	MYKONOS_ERR_FLEET_INITCALS_FAILED,
+	MYKONOS_ERR_FLEET_SYSREF_FAILED,
+
+	MYKONOS_ERR_SETPOLLPOLICY_NULL_PARAM,
+	MYKONOS_ERR_SETPOLLPOLICY_INV_CLASS,
+	MYKONOS_ERR_SETPOLLPOLICY_INV_INTERVAL,
+	MYKONOS_ERR_WAITIRQ_OPEN_FAILED,
+	MYKONOS_ERR_WAITIRQ_GPINT_FAILED,
+	MYKONOS_ERR_WAIT_ARM_INTERRUPT,
+	MYKONOS_ERR_INITCALASYNC_NULL_PARAM,
+	MYKONOS_ERR_INITCALASYNC_BUSY,
+	MYKONOS_ERR_INITCALASYNC_THREAD_FAILED,
+	MYKONOS_ERR_ARMPIPE_NULL_PARAM,
+	MYKONOS_ERR_ARMPIPE_FULL,
+	MYKONOS_ERR_ARMIMAGE_NULL_PARAM,
+	MYKONOS_ERR_ARMIMAGE_OPEN_FAILED,
+	MYKONOS_ERR_ARMIMAGE_INVALID_BYTECOUNT,
+	MYKONOS_ERR_ARMIMAGE_SPI_SETTINGS,
+	MYKONOS_ERR_ARMIMAGE_NO_MEMORY,
+	MYKONOS_ERR_ARMIMAGE_WRITE_FAILED,
+	MYKONOS_ERR_SPIBATCH_COMMIT_FAILED,
+
     MYKONOS_ERR_END
 } mykonosErr_t;
 
@@ -764,6 +791,35 @@ typedef enum
     INITARM_DONE
 } waitEvent_t;
 
+/* Wait classes paced by mykonosPollPolicy_t: one per waitEvent_t, then one per ARM opcode
+   (0, 2, .. 30) for MYKONOS_waitArmCmdStatus() */
+#define MYK_POLL_CLASS_ARMCMD(opCode)   (INITARM_DONE + 1 + ((opCode) >> 1))
+#define MYK_POLL_NUM_CLASSES            (INITARM_DONE + 1 + 16)
+
+/**
+ * \brief Pacing of the status polls of one wait class. The first poll comes after
+ *        initialDelay_pct of the completion time learned from previous waits, then the gap
+ *        between polls starts at minInterval_us and doubles up to maxInterval_us.
+ *        Tuning fields left at 0 take the defaults of MYKONOS_setPollPolicy().
+ */
+typedef struct
+{
+    uint32_t initialDelay_pct;      /*!< first poll after this percentage of expected_us */
+    uint32_t minInterval_us;        /*!< first gap between polls */
+    uint32_t maxInterval_us;        /*!< backoff cap */
+    uint32_t expected_us;           /*!< learned completion time, moving average of the completed waits */
+    uint32_t completions;           /*!< completed waits */
+    uint32_t polls;                 /*!< status reads done by the completed waits */
+} mykonosPollClass_t;
+
+/**
+ * \brief Per device polling state of MYKONOS_waitForEvent() and MYKONOS_waitArmCmdStatus()
+ */
+typedef struct
+{
+    mykonosPollClass_t waitClass[MYK_POLL_NUM_CLASSES];
+} mykonosPollPolicy_t;
+
 /**
  *  \brief Enum to set the desired FIR filter type for related functions
  */
@@ -1701,6 +1757,7 @@ typedef struct
     mykonosAuxIo_t         *auxIo;          /*!< Auxiliary IO settings data structure pointer */
     mykonosDigClocks_t     *clocks;         /*!< Holds settings for CLKPLL and reference clock */
     uint8_t                 profilesValid;  /*!< Mykonos initialize function uses this as an output to remember which profile data structure pointers are valid */
+    mykonosPollPolicy_t    *pollPolicy;     /*!< optional pacing of status polls, NULL = poll back to back */
 } mykonosDevice_t;
 
 #ifdef __cplusplus